@@ -1,16 +1,39 @@
 #include "ValueArray.h"
 
+// small arrays are faster to search linearly
+#define VALUE_ARRAY_INDEX_THRESHOLD (8)
+
 void ValueArray_Create( TValueArray * array ) {
     array->values = NULL;
     array->count = 0;
+    HashMap_Create( &array->index );
+    array->indexedCount = 0;
+}
+
+static void ValueArray_BuildIndex( TValueArray * array ) {
+    HashMap_Clear( &array->index );
+    // insert in reverse order, so first value with the name wins, as it was with linear search
+    for( int i = array->count - 1; i >= 0; i-- ) {
+        HashMap_Insert( &array->index, array->values[i].name, &array->values[i] );
+    }
+    array->indexedCount = array->count;
 }
 
 
 TValue * ValueArray_GetValueByName( TValueArray * array, const char * name ) {
-    int i;
-    for( i = 0; i < array->count; i++ ) {
-        if( strcmp( name, array->values[i].name ) == 0 ) {
-            return &array->values[i];
+    if( array->count >= VALUE_ARRAY_INDEX_THRESHOLD ) {
+        if( array->indexedCount != array->count ) {
+            ValueArray_BuildIndex( array );
+        }
+        TValue * value = HashMap_Find( &array->index, name );
+        if( value ) {
+            return value;
+        }
+    } else {
+        for( int i = 0; i < array->count; i++ ) {
+            if( strcmp( name, array->values[i].name ) == 0 ) {
+                return &array->values[i];
+            }
         }
     }
 
@@ -26,4 +49,5 @@ void ValueArray_Free( TValueArray * var ) {
         Memory_Free( var->values[i].name );
     }
     Memory_Free( var->values );
+    HashMap_Free( &var->index );
 }
\ No newline at end of file
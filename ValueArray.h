@@ -2,6 +2,7 @@
 #define _VALUE_ARRAY_
 
 #include "common.h"
+#include "hashmap.h"
 
 typedef struct {
     char * name;
@@ -12,6 +13,9 @@ typedef struct {
 typedef struct {
     int count;
     TValue * values;
+    // name -> value, built on first lookup, rebuilt when 'count' changes
+    THashMap index;
+    int indexedCount;
 } TValueArray;
 
 void ValueArray_Create( TValueArray * array );
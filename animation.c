@@ -1,8 +1,19 @@
 #include "animation.h"
 #include "list.h"
+#include "timer.h"
 
 TList gAnimations = { .size = 0, .head = NULL, .tail = NULL };
 
+// components of unit quaternion except the largest one are within this range
+#define ANIMATION_ROTATION_RANGE (0.70710678f)
+#define ANIMATION_ROTATION_MAX (32767.0f)
+#define ANIMATION_POSITION_MAX (65535.0f)
+// key is dropped when interpolation of its neighbours differs from it less than this
+#define ANIMATION_POSITION_TOLERANCE (0.001f)
+#define ANIMATION_ROTATION_TOLERANCE (0.002f) // radians
+// longest distance between kept keys in frames, keeps key reduction linear in frame count
+#define ANIMATION_MAX_KEY_SPAN (64)
+
 TAnimation * Animation_Create( int begFrame, int endFrame, float duration ) {
     TAnimation * anim = Memory_New( TAnimation );
     if( endFrame < begFrame ) {
@@ -12,11 +23,8 @@ TAnimation * Animation_Create( int begFrame, int endFrame, float duration ) {
     }
     anim->begFrame = begFrame;
     anim->endFrame = endFrame;
-    anim->curFrame = begFrame;
-    anim->nextFrame = begFrame + 1;
     anim->duration = duration;
-    anim->frameDelta = endFrame - begFrame;
-    anim->interp = 0.0f;
+    anim->time = 0.0f;
     anim->enabled = false;
     List_Add( &gAnimations, anim );
     return anim;
@@ -27,22 +35,290 @@ void Animation_Free( TAnimation * anim ) {
     Memory_Free( anim );
 }
 
-void Animation_Update( TAnimation * anim, float dt ) {      
-    anim->interp += dt * (anim->frameDelta / anim->duration);
-    if( anim->interp >= 1.0f ) {
-        anim->curFrame++;
-        if( anim->curFrame >= anim->endFrame ) {
-            anim->curFrame = anim->begFrame;
+void Animation_Update( TAnimation * anim, float dt ) {
+    anim->time += dt;
+    if( anim->duration > 0.0f ) {
+        anim->time = fmodf( anim->time, anim->duration );
+        if( anim->time < 0.0f ) {
+            anim->time += anim->duration;
         }
-        anim->nextFrame = anim->curFrame + 1;
-        anim->interp = 0.0f;
-    } 
+    } else {
+        anim->time = 0.0f;
+    }
 }
 
-void Animation_UpdateAll( void ) {
+void Animation_UpdateAll( float dt ) {
     for_each( TAnimation, anim, gAnimations ) {
         if( anim->enabled ) {
-            Animation_Update( anim, 1.0f / 60.0f );
+            Animation_Update( anim, dt );
+        }
+    }
+}
+
+float Animation_GetFrame( const TAnimation * anim ) {
+    if( anim->duration <= 0.0f ) {
+        return anim->begFrame;
+    }
+    return anim->begFrame + ( anim->time / anim->duration ) * ( anim->endFrame - anim->begFrame );
+}
+
+static void AnimationTrack_PackRotation( TQuaternion q, unsigned short * out ) {
+    float c[4] = { q.x, q.y, q.z, q.w };
+    float length = sqrtf( c[0] * c[0] + c[1] * c[1] + c[2] * c[2] + c[3] * c[3] );
+    int largest = 0;
+    for( int i = 0; i < 4; i++ ) {
+        c[i] = length > 0.0f ? c[i] / length : ( i == 3 );
+        if( fabsf( c[i] ) > fabsf( c[largest] )) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation, so largest component is always positive and not stored
+    float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    int n = 0;
+    for( int i = 0; i < 4; i++ ) {
+        if( i != largest ) {
+            float v = ( c[i] * sign / ANIMATION_ROTATION_RANGE ) * 0.5f + 0.5f;
+            v = v < 0.0f ? 0.0f : ( v > 1.0f ? 1.0f : v );
+            out[n++] = (unsigned short)( v * ANIMATION_ROTATION_MAX + 0.5f );
+        }
+    }
+    out[0] |= ( largest & 1 ) << 15;
+    out[1] |= ( largest >> 1 ) << 15;
+}
+
+static TQuaternion AnimationTrack_UnpackRotation( const unsigned short * in ) {
+    int largest = ( in[0] >> 15 ) | (( in[1] >> 15 ) << 1 );
+    float c[4];
+    float sqrSum = 0.0f;
+    int n = 0;
+    for( int i = 0; i < 4; i++ ) {
+        if( i != largest ) {
+            c[i] = (( in[n++] & 0x7FFF ) / ANIMATION_ROTATION_MAX * 2.0f - 1.0f ) * ANIMATION_ROTATION_RANGE;
+            sqrSum += c[i] * c[i];
+        }
+    }
+    c[largest] = sqrtf( sqrSum < 1.0f ? 1.0f - sqrSum : 0.0f );
+    return Quaternion_Set( c[0], c[1], c[2], c[3] );
+}
+
+static void AnimationTrack_DecodeKey( const TAnimationTrack * track, const TAnimationKey * key, TVec3 * position, TQuaternion * rotation ) {
+    position->x = track->positionMin.x + key->position[0] * track->positionStep.x;
+    position->y = track->positionMin.y + key->position[1] * track->positionStep.y;
+    position->z = track->positionMin.z + key->position[2] * track->positionStep.z;
+    *rotation = AnimationTrack_UnpackRotation( key->rotation );
+}
+
+static TQuaternion AnimationTrack_Slerp( TQuaternion a, TQuaternion b, float t ) {
+    // take shortest way, sign of decoded quaternions is arbitrary
+    if( Quaternion_Dot( a, b ) < 0.0f ) {
+        b = Quaternion_Set( -b.x, -b.y, -b.z, -b.w );
+    }
+    return Quaternion_Slerp( a, b, t );
+}
+
+// true if frames between 'first' and 'last' can be interpolated from these two frames
+static bool AnimationTrack_CanInterpolate( const TKeyFrame * keyFrames, int first, int last ) {
+    float minDot = cosf( ANIMATION_ROTATION_TOLERANCE * 0.5f );
+    for( int i = first + 1; i < last; i++ ) {
+        float t = (float)( i - first ) / (float)( last - first );
+        TVec3 position = Vec3_Lerp( keyFrames[first].pos, keyFrames[last].pos, t );
+        if( Vec3_Distance( position, keyFrames[i].pos ) > ANIMATION_POSITION_TOLERANCE ) {
+            return false;
+        }
+        TQuaternion a = keyFrames[first].rot, b = keyFrames[last].rot, q = keyFrames[i].rot;
+        TQuaternion rotation = AnimationTrack_Slerp( a, b, t );
+        float dot = fabsf( Quaternion_Dot( rotation, q )) / sqrtf( Quaternion_SqrLength( rotation ) * Quaternion_SqrLength( q ));
+        if( dot < minDot ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TAnimationTrack * AnimationTrack_Create( const TKeyFrame * keyFrames, int frameCount ) {
+    if( frameCount <= 0 || frameCount > 65536 ) {
+        Util_RaiseError( "Unable to create animation track of %d frames!", frameCount );
+    }
+    TAnimationTrack * track = Memory_New( TAnimationTrack );
+    track->frameCount = frameCount;
+    track->refCount = 1;
+    // bounds of position
+    TVec3 min = keyFrames[0].pos, max = keyFrames[0].pos;
+    for( int i = 1; i < frameCount; i++ ) {
+        const TVec3 * p = &keyFrames[i].pos;
+        min = Vec3_Set( fminf( min.x, p->x ), fminf( min.y, p->y ), fminf( min.z, p->z ));
+        max = Vec3_Set( fmaxf( max.x, p->x ), fmaxf( max.y, p->y ), fmaxf( max.z, p->z ));
+    }
+    track->positionMin = min;
+    track->positionStep = Vec3_Scale( Vec3_Sub( max, min ), 1.0f / ANIMATION_POSITION_MAX );
+    // greedy key reduction, key is kept when the next one can't be reached by interpolation
+    // or is too far, so each check walks at most ANIMATION_MAX_KEY_SPAN frames
+    TScratchMark mark = Scratch_GetMark();
+    int * kept = Scratch_NewCount( frameCount, int );
+    int keptCount = 0;
+    kept[ keptCount++ ] = 0;
+    for( int i = 2; i < frameCount; i++ ) {
+        int first = kept[ keptCount - 1 ];
+        if( i - first > ANIMATION_MAX_KEY_SPAN || !AnimationTrack_CanInterpolate( keyFrames, first, i )) {
+            kept[ keptCount++ ] = i - 1;
         }
     }
+    if( frameCount > 1 ) {
+        kept[ keptCount++ ] = frameCount - 1;
+    }
+    track->keyCount = keptCount;
+    track->keys = Memory_NewCount( keptCount, TAnimationKey );
+    for( int n = 0; n < keptCount; n++ ) {
+        const TKeyFrame * keyFrame = keyFrames + kept[n];
+        TAnimationKey * key = track->keys + n;
+        key->frame = kept[n];
+        float p[3] = { keyFrame->pos.x - min.x, keyFrame->pos.y - min.y, keyFrame->pos.z - min.z };
+        float step[3] = { track->positionStep.x, track->positionStep.y, track->positionStep.z };
+        for( int k = 0; k < 3; k++ ) {
+            key->position[k] = step[k] > 0.0f ? (unsigned short)( p[k] / step[k] + 0.5f ) : 0;
+        }
+        AnimationTrack_PackRotation( keyFrame->rot, key->rotation );
+    }
+    Scratch_Rewind( mark );
+    return track;
+}
+
+TAnimationTrack * AnimationTrack_Share( TAnimationTrack * track ) {
+    if( track ) {
+        track->refCount++;
+    }
+    return track;
+}
+
+void AnimationTrack_Release( TAnimationTrack * track ) {
+    if( track ) {
+        track->refCount--;
+        if( track->refCount <= 0 ) {
+            Memory_Free( track->keys );
+            Memory_Free( track );
+        }
+    }
+}
+
+void AnimationTrack_Sample( const TAnimationTrack * track, float frame, TVec3 * position, TQuaternion * rotation ) {
+    const TAnimationKey * keys = track->keys;
+    int last = track->keyCount - 1;
+    if( frame <= keys[0].frame || !last ) {
+        AnimationTrack_DecodeKey( track, keys, position, rotation );
+        return;
+    }
+    if( frame >= keys[last].frame ) {
+        AnimationTrack_DecodeKey( track, keys + last, position, rotation );
+        return;
+    }
+    // binary search of keys surrounding the frame
+    int lo = 0, hi = last;
+    while( hi - lo > 1 ) {
+        int mid = ( lo + hi ) / 2;
+        if( keys[mid].frame <= frame ) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    TVec3 p0, p1;
+    TQuaternion q0, q1;
+    AnimationTrack_DecodeKey( track, keys + lo, &p0, &q0 );
+    AnimationTrack_DecodeKey( track, keys + hi, &p1, &q1 );
+    float t = ( frame - keys[lo].frame ) / (float)( keys[hi].frame - keys[lo].frame );
+    *position = Vec3_Lerp( p0, p1, t );
+    *rotation = AnimationTrack_Slerp( q0, q1, t );
+}
+
+void Pose_Create( TPose * pose, int count ) {
+    pose->count = count;
+    pose->positions = Memory_NewCount( count, TVec3 );
+    pose->rotations = Memory_NewCount( count, TQuaternion );
+    for( int i = 0; i < count; i++ ) {
+        pose->rotations[i] = Quaternion_Set( 0.0f, 0.0f, 0.0f, 1.0f );
+    }
+}
+
+void Pose_Free( TPose * pose ) {
+    Memory_Free( pose->positions );
+    Memory_Free( pose->rotations );
+    pose->positions = NULL;
+    pose->rotations = NULL;
+    pose->count = 0;
+}
+
+void Pose_Sample( TPose * pose, TAnimationTrack * const * tracks, float frame ) {
+    for( int i = 0; i < pose->count; i++ ) {
+        if( tracks[i] ) {
+            AnimationTrack_Sample( tracks[i], frame, pose->positions + i, pose->rotations + i );
+        }
+    }
+}
+
+void Pose_Blend( TPose * out, const TPose * a, const TPose * b, float t ) {
+    for( int i = 0; i < out->count; i++ ) {
+        out->positions[i] = Vec3_Lerp( a->positions[i], b->positions[i], t );
+        out->rotations[i] = AnimationTrack_Slerp( a->rotations[i], b->rotations[i], t );
+    }
+}
+
+#define TEST_ANIMATION_FRAME_COUNT (300)
+#define BENCHMARK_ANIMATION_FRAME_COUNT (6000)
+
+// holds, linear segments and curves, like in usual skeletal animation
+static void Test_FillKeyFrames( TKeyFrame * keyFrames, int frameCount ) {
+    for( int i = 0; i < frameCount; i++ ) {
+        float t = i / 30.0f;
+        int segment = i / 50;
+        if( segment % 3 == 0 ) {
+            keyFrames[i].pos = Vec3_Set( 1.0f, 2.0f, 3.0f );
+            keyFrames[i].rot = Quaternion_SetAxisAngle( Vec3_Set( 0.0f, 1.0f, 0.0f ), 0.5f );
+        } else if( segment % 3 == 1 ) {
+            keyFrames[i].pos = Vec3_Set( 2.0f * t, 0.5f * t, 0.0f );
+            keyFrames[i].rot = Quaternion_SetAxisAngle( Vec3_Set( 1.0f, 0.0f, 0.0f ), t );
+        } else {
+            keyFrames[i].pos = Vec3_Set( sinf( t ), cosf( t ), 0.0f );
+            keyFrames[i].rot = Quaternion_SetEulerAngles( 20.0f * sinf( t ), 90.0f * t, 0.0f );
+        }
+    }
+}
+
+void Test_AnimationTrack( void ) {
+    TKeyFrame * keyFrames = Memory_NewCount( TEST_ANIMATION_FRAME_COUNT, TKeyFrame );
+    Test_FillKeyFrames( keyFrames, TEST_ANIMATION_FRAME_COUNT );
+    TAnimationTrack * track = AnimationTrack_Create( keyFrames, TEST_ANIMATION_FRAME_COUNT );
+    for( int i = 0; i < TEST_ANIMATION_FRAME_COUNT; i++ ) {
+        TVec3 position;
+        TQuaternion rotation;
+        AnimationTrack_Sample( track, i, &position, &rotation );
+        TQuaternion q = keyFrames[i].rot;
+        float dot = fabsf( Quaternion_Dot( rotation, q )) / sqrtf( Quaternion_SqrLength( q ));
+        if( Vec3_Distance( position, keyFrames[i].pos ) > 0.01f || dot < 0.9999f ) {
+            Util_RaiseError( "Test_AnimationTrack: frame %d mismatch!", i );
+        }
+    }
+    AnimationTrack_Release( track );
+    Memory_Free( keyFrames );
+}
+
+void Benchmark_AnimationTrack( void ) {
+    TKeyFrame * keyFrames = Memory_NewCount( BENCHMARK_ANIMATION_FRAME_COUNT, TKeyFrame );
+    Test_FillKeyFrames( keyFrames, BENCHMARK_ANIMATION_FRAME_COUNT );
+    TTimer timer;
+    Timer_Create( &timer );
+    TAnimationTrack * track = AnimationTrack_Create( keyFrames, BENCHMARK_ANIMATION_FRAME_COUNT );
+    double createTime = Timer_GetElapsedMilliseconds( &timer );
+    // sampling between frames, as it is done with time-based playback
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_ANIMATION_FRAME_COUNT - 1; i++ ) {
+        TVec3 position;
+        TQuaternion rotation;
+        AnimationTrack_Sample( track, i + 0.5f, &position, &rotation );
+    }
+    double sampleTime = Timer_GetElapsedMilliseconds( &timer );
+    printf( "AnimationTrack: %d frames: %d bytes uncompressed, %d keys in %d bytes compressed, created in %.3f ms, sampled in %.3f ms\n",
+        BENCHMARK_ANIMATION_FRAME_COUNT, (int)( BENCHMARK_ANIMATION_FRAME_COUNT * sizeof( TKeyFrame )), track->keyCount,
+        (int)( track->keyCount * sizeof( TAnimationKey )), createTime, sampleTime );
+    AnimationTrack_Release( track );
+    Memory_Free( keyFrames );
 }
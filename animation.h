@@ -2,23 +2,78 @@
 #define _ANIM_
 
 #include "common.h"
+#include "vector3.h"
+#include "quaternion.h"
 
 OLDTECH_BEGIN_HEADER
 
+// uncompressed pose of node in one frame, used only while loading
+typedef struct SKeyFrame {
+    TVec3 pos;
+    TQuaternion rot;
+} TKeyFrame;
+
+// quantized key, 14 bytes instead of 28 of TKeyFrame
+typedef struct TAnimationKey {
+    unsigned short frame;
+    unsigned short position[3]; // 16 bit fraction of track bounds
+    unsigned short rotation[3]; // smallest three components, index of largest one in high bits
+} TAnimationKey;
+
+// compressed keyframes of one node, shared between all instances of the same source. keys
+// which can be interpolated from neighbours are dropped
+typedef struct TAnimationTrack {
+    TAnimationKey * keys;
+    int keyCount;
+    int frameCount;
+    TVec3 positionMin;
+    TVec3 positionStep; // dequantization scale of position
+    int refCount;
+} TAnimationTrack;
+
 typedef struct {
-    float interp;
-    int curFrame;
     int begFrame;
     int endFrame;
-    int nextFrame;
-    float frameDelta;
-    float duration;
+    float duration; // seconds to play from first to last frame
+    float time; // playback position in seconds
     bool enabled;
 } TAnimation;
 
 TAnimation * Animation_Create( int begFrame, int endFrame, float duration );
 void Animation_Free( TAnimation * anim );
-void Animation_UpdateAll( void );
+// advances playback position by dt seconds, animation is looped
+void Animation_Update( TAnimation * anim, float dt );
+void Animation_UpdateAll( float dt );
+// fractional frame number at current playback position
+float Animation_GetFrame( const TAnimation * anim );
+
+// compresses keyframes of node, i-th keyframe belongs to i-th frame
+TAnimationTrack * AnimationTrack_Create( const TKeyFrame * keyFrames, int frameCount );
+// returns same track with incremented reference counter
+TAnimationTrack * AnimationTrack_Share( TAnimationTrack * track );
+// frees track when last reference released
+void AnimationTrack_Release( TAnimationTrack * track );
+// interpolates pose at fractional frame, frame is clamped to track bounds, O(log(keyCount))
+void AnimationTrack_Sample( const TAnimationTrack * track, float frame, TVec3 * position, TQuaternion * rotation );
+
+// local transforms of set of nodes, i-th element belongs to i-th node of the owner
+typedef struct TPose {
+    int count;
+    TVec3 * positions;
+    TQuaternion * rotations;
+} TPose;
+
+void Pose_Create( TPose * pose, int count );
+void Pose_Free( TPose * pose );
+// samples i-th track into i-th element, elements of NULL tracks are left untouched
+void Pose_Sample( TPose * pose, TAnimationTrack * const * tracks, float frame );
+// out = a * ( 1 - t ) + b * t, 'out' can be one of the sources
+void Pose_Blend( TPose * out, const TPose * a, const TPose * b, float t );
+
+// tests
+void Test_AnimationTrack( void );
+// prints size of compressed track, time of its creation and sampling
+void Benchmark_AnimationTrack( void );
 
 OLDTECH_END_HEADER
 
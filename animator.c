@@ -0,0 +1,180 @@
+#include "animator.h"
+
+TList gAnimators = { .size = 0, .head = NULL, .tail = NULL };
+
+static void Animator_CollectNodes( TAnimator * animator, TEntity * ent, TEntityHandle * nodes, TAnimationTrack ** tracks ) {
+    if( ent->track && !ent->skinned ) {
+        if( nodes ) {
+            nodes[ animator->nodeCount ] = Entity_GetHandle( ent );
+            tracks[ animator->nodeCount ] = ent->track;
+        }
+        animator->nodeCount++;
+    }
+    for( TEntity * child = ent->firstChild; child; child = child->nextSibling ) {
+        Animator_CollectNodes( animator, child, nodes, tracks );
+    }
+}
+
+TAnimator * Animator_Create( TEntity * root ) {
+    TAnimator * animator = Memory_New( TAnimator );
+    // first pass counts nodes, second one fills arrays
+    Animator_CollectNodes( animator, root, NULL, NULL );
+    int nodeCount = animator->nodeCount;
+    animator->nodes = Memory_NewCount( nodeCount, TEntityHandle );
+    animator->tracks = Memory_NewCount( nodeCount, TAnimationTrack* );
+    animator->nodeCount = 0;
+    Animator_CollectNodes( animator, root, animator->nodes, animator->tracks );
+    // pose buffers are allocated once and reused by layers
+    for( int i = 0; i < ANIMATOR_MAX_LAYERS; i++ ) {
+        Pose_Create( &animator->layers[i].pose, nodeCount );
+    }
+    Pose_Create( &animator->pose, nodeCount );
+    List_Add( &gAnimators, animator );
+    return animator;
+}
+
+void Animator_Free( TAnimator * animator ) {
+    List_Remove( &gAnimators, animator );
+    for( int i = 0; i < ANIMATOR_MAX_LAYERS; i++ ) {
+        Pose_Free( &animator->layers[i].pose );
+    }
+    Pose_Free( &animator->pose );
+    Memory_Free( animator->nodes );
+    Memory_Free( animator->tracks );
+    Memory_Free( animator );
+}
+
+static TAnimationLayer * Animator_FindLayer( TAnimator * animator, TAnimation * anim ) {
+    for( int i = 0; i < animator->layerCount; i++ ) {
+        if( animator->layers[i].anim == anim ) {
+            return animator->layers + i;
+        }
+    }
+    return NULL;
+}
+
+static void Animator_RemoveLayer( TAnimator * animator, int index ) {
+    TAnimationLayer * layer = animator->layers + index;
+    layer->anim->enabled = false;
+    // swap with last one, so pose buffer stays in the pool of layers
+    animator->layerCount--;
+    TAnimationLayer temp = *layer;
+    *layer = animator->layers[ animator->layerCount ];
+    animator->layers[ animator->layerCount ] = temp;
+}
+
+static TAnimationLayer * Animator_AddLayer( TAnimator * animator, TAnimation * anim, float weight ) {
+    TAnimationLayer * layer = Animator_FindLayer( animator, anim );
+    if( !layer ) {
+        if( animator->layerCount == ANIMATOR_MAX_LAYERS ) {
+            // replace the weakest layer
+            int weakest = 0;
+            for( int i = 1; i < animator->layerCount; i++ ) {
+                if( animator->layers[i].weight < animator->layers[weakest].weight ) {
+                    weakest = i;
+                }
+            }
+            Animator_RemoveLayer( animator, weakest );
+        }
+        layer = animator->layers + animator->layerCount++;
+        layer->anim = anim;
+        layer->weight = weight;
+        layer->sampled = false;
+    }
+    layer->fadeSpeed = 0.0f;
+    anim->enabled = true;
+    return layer;
+}
+
+void Animator_Play( TAnimator * animator, TAnimation * anim ) {
+    Animator_CrossFade( animator, anim, 0.0f );
+}
+
+void Animator_CrossFade( TAnimator * animator, TAnimation * anim, float fadeTime ) {
+    // nothing to fade from, if there are no layers
+    if( fadeTime <= 0.0f || !animator->layerCount ) {
+        for( int i = animator->layerCount - 1; i >= 0; i-- ) {
+            if( animator->layers[i].anim != anim ) {
+                Animator_RemoveLayer( animator, i );
+            }
+        }
+        Animator_AddLayer( animator, anim, 1.0f )->weight = 1.0f;
+        return;
+    }
+    TAnimationLayer * target = Animator_AddLayer( animator, anim, 0.0f );
+    for( int i = 0; i < animator->layerCount; i++ ) {
+        TAnimationLayer * layer = animator->layers + i;
+        layer->fadeSpeed = ( layer == target ? 1.0f : -1.0f ) / fadeTime;
+    }
+}
+
+void Animator_SetWeight( TAnimator * animator, TAnimation * anim, float weight ) {
+    if( weight <= 0.0f ) {
+        TAnimationLayer * layer = Animator_FindLayer( animator, anim );
+        if( layer ) {
+            Animator_RemoveLayer( animator, layer - animator->layers );
+        }
+    } else {
+        Animator_AddLayer( animator, anim, weight )->weight = weight;
+    }
+}
+
+void Animator_Update( TAnimator * animator, float dt ) {
+    bool changed = false;
+    // fading
+    for( int i = animator->layerCount - 1; i >= 0; i-- ) {
+        TAnimationLayer * layer = animator->layers + i;
+        if( layer->fadeSpeed != 0.0f ) {
+            layer->weight += layer->fadeSpeed * dt;
+            changed = true;
+            if( layer->weight >= 1.0f ) {
+                layer->weight = 1.0f;
+                layer->fadeSpeed = 0.0f;
+            } else if( layer->weight <= 0.0f ) {
+                Animator_RemoveLayer( animator, i );
+            }
+        }
+    }
+    if( !animator->layerCount ) {
+        return;
+    }
+    // each animation is sampled once, paused one keeps its cached pose
+    for( int i = 0; i < animator->layerCount; i++ ) {
+        TAnimationLayer * layer = animator->layers + i;
+        float frame = Animation_GetFrame( layer->anim );
+        if( !layer->sampled || frame != layer->sampledFrame ) {
+            Pose_Sample( &layer->pose, animator->tracks, frame );
+            layer->sampledFrame = frame;
+            layer->sampled = true;
+            changed = true;
+        }
+    }
+    if( !changed ) {
+        return;
+    }
+    // normalized weighted blend, each layer is mixed in proportionally to sum of previous weights
+    const TPose * result = &animator->layers[0].pose;
+    float totalWeight = animator->layers[0].weight;
+    for( int i = 1; i < animator->layerCount; i++ ) {
+        TAnimationLayer * layer = animator->layers + i;
+        totalWeight += layer->weight;
+        if( totalWeight > 0.0f ) {
+            Pose_Blend( &animator->pose, result, &layer->pose, layer->weight / totalWeight );
+            result = &animator->pose;
+        }
+    }
+    // write final pose to nodes
+    for( int i = 0; i < animator->nodeCount; i++ ) {
+        TEntity * node = Entity_FromHandle( animator->nodes[i] );
+        if( node ) {
+            node->localPosition = result->positions[i];
+            node->localRotation = result->rotations[i];
+        }
+    }
+}
+
+void Animator_UpdateAll( float dt ) {
+    for_each( TAnimator, animator, gAnimators ) {
+        Animator_Update( animator, dt );
+    }
+}
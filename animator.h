@@ -0,0 +1,47 @@
+#ifndef _ANIMATOR_
+#define _ANIMATOR_
+
+#include "common.h"
+#include "entity.h"
+
+OLDTECH_BEGIN_HEADER
+
+#define ANIMATOR_MAX_LAYERS (4)
+
+typedef struct TAnimationLayer {
+    TAnimation * anim;
+    float weight;
+    float fadeSpeed; // change of weight per second, negative when layer fades out
+    TPose pose; // cached pose of 'anim', resampled only when its frame changes
+    float sampledFrame;
+    bool sampled;
+} TAnimationLayer;
+
+// plays animations on keyframe-animated descendants of an entity. each animation is
+// sampled into its own pose buffer, buffers are blended by weights of layers and the
+// result is written to the nodes in one pass
+typedef struct TAnimator {
+    int nodeCount;
+    TEntityHandle * nodes;
+    TAnimationTrack ** tracks; // i-th track belongs to i-th node
+    int layerCount;
+    TAnimationLayer layers[ANIMATOR_MAX_LAYERS];
+    TPose pose; // blended pose
+} TAnimator;
+
+// animator controls 'enabled' flag of animations passed to it, animation of layer which
+// faded out is disabled
+TAnimator * Animator_Create( TEntity * root );
+void Animator_Free( TAnimator * animator );
+// switches to animation immediately
+void Animator_Play( TAnimator * animator, TAnimation * anim );
+// fades animation in and all other layers out during fadeTime seconds
+void Animator_CrossFade( TAnimator * animator, TAnimation * anim, float fadeTime );
+// sets constant weight of animation layer, zero weight removes the layer
+void Animator_SetWeight( TAnimator * animator, TAnimation * anim, float weight );
+void Animator_Update( TAnimator * animator, float dt );
+void Animator_UpdateAll( float dt );
+
+OLDTECH_END_HEADER
+
+#endif
@@ -0,0 +1,66 @@
+#include "common.h"
+#include "hashmap.h"
+#include "thread.h"
+
+// strings are packed into big blocks to avoid allocation per string
+#define ATOM_BLOCK_SIZE (16384)
+
+typedef struct TAtomBlock {
+    struct TAtomBlock * next;
+    int used;
+    int size;
+    char data[1];
+} TAtomBlock;
+
+THashMap gAtomTable = HASHMAP_INITIALIZER;
+TAtomBlock * gAtomBlocks = NULL;
+TCriticalSection gAtomLock = NULL;
+
+static char * Atom_Store( const char * str, int size ) {
+    TAtomBlock * block = gAtomBlocks;
+    if( !block || ( block->size - block->used ) < size ) {
+        int blockSize = size > ATOM_BLOCK_SIZE ? size : ATOM_BLOCK_SIZE;
+        block = Memory_AllocateClean( sizeof( TAtomBlock ) + blockSize );
+        block->size = blockSize;
+        block->next = gAtomBlocks;
+        gAtomBlocks = block;
+    }
+    char * stored = block->data + block->used;
+    memcpy( stored, str, size );
+    block->used += size;
+    return stored;
+}
+
+TAtom Atom_Intern( const char * str ) {
+    if( !gAtomLock ) {
+        // first atom is created by main thread before any other thread starts
+        gAtomLock = CriticalSection_Create();
+    }
+    CriticalSection_Enter( gAtomLock );
+    TAtom atom = HashMap_Find( &gAtomTable, str );
+    if( !atom ) {
+        atom = Atom_Store( str, strlen( str ) + 1 );
+        HashMap_Insert( &gAtomTable, atom, (void*)atom );
+    }
+    CriticalSection_Leave( gAtomLock );
+    return atom;
+}
+
+TAtom Atom_Find( const char * str ) {
+    if( !gAtomLock ) {
+        return NULL;
+    }
+    CriticalSection_Enter( gAtomLock );
+    TAtom atom = HashMap_Find( &gAtomTable, str );
+    CriticalSection_Leave( gAtomLock );
+    return atom;
+}
+
+void Atom_FreeAll( void ) {
+    HashMap_Free( &gAtomTable );
+    while( gAtomBlocks ) {
+        TAtomBlock * next = gAtomBlocks->next;
+        Memory_Free( gAtomBlocks );
+        gAtomBlocks = next;
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef _ATOM_
+#define _ATOM_
+
+// Atom is an interned string: every distinct string is stored once in the global table,
+// so two atoms can be compared by pointer. Atoms live until Atom_FreeAll.
+typedef const char * TAtom;
+
+// returns atom for the string, adding string to the table if needed
+TAtom Atom_Intern( const char * str );
+// returns NULL if string was never interned, never adds anything
+TAtom Atom_Find( const char * str );
+void Atom_FreeAll( void );
+
+#endif
@@ -150,7 +150,7 @@ void Buffer_WriteByte( TBuffer * buf, char b ) {
     }        
 }
 
-void Buffer_WriteString( TBuffer * buf, char * str ) {
+void Buffer_WriteString( TBuffer * buf, const char * str ) {
     if( buf->file ) {
         while( *str ) {
             fwrite( str, sizeof( char ), 1, buf->file );
@@ -37,7 +37,7 @@ void Buffer_WriteVector3( TBuffer * buf, const TVec3 * vec );
 void Buffer_WriteVector2( TBuffer * buf, const TVector2 * vec );
 void Buffer_WriteQuaternion( TBuffer * buf, const TQuaternion * quat );
 void Buffer_WriteByte( TBuffer * buf, char b );
-void Buffer_WriteString( TBuffer * buf, char * str );
+void Buffer_WriteString( TBuffer * buf, const char * str );
 void Buffer_WriteData( TBuffer * buf, void * data, int size );
 
 OLDTECH_END_HEADER
@@ -0,0 +1,662 @@
+#include "bvh.h"
+#include "collision.h"
+#include "octree.h"
+#include "timer.h"
+#include "jobs.h"
+#include <float.h>
+
+#define BVH_BIN_COUNT (16)
+// leaves are made smaller only if surface area heuristic says it is worth it
+#define BVH_MIN_LEAF_TRIANGLES (2)
+#define BVH_MAX_LEAF_TRIANGLES (8)
+// cost of visiting a node relative to cost of testing a triangle
+#define BVH_TRAVERSAL_COST (1.0f)
+#define BVH_MAX_DEPTH (64)
+
+typedef struct TBvhBin {
+    TVec3 min;
+    TVec3 max;
+    int count;
+} TBvhBin;
+
+typedef struct TBvhBuilder {
+    TBvh * bvh;
+    TVec3 * triangleMin;
+    TVec3 * triangleMax;
+    TVec3 * centroid;
+} TBvhBuilder;
+
+static float Bvh_Component( const TVec3 * v, int axis ) {
+    return axis == 0 ? v->x : ( axis == 1 ? v->y : v->z );
+}
+
+static void Bvh_Grow( TVec3 * min, TVec3 * max, const TVec3 * pmin, const TVec3 * pmax ) {
+    if( pmin->x < min->x ) min->x = pmin->x;
+    if( pmin->y < min->y ) min->y = pmin->y;
+    if( pmin->z < min->z ) min->z = pmin->z;
+    if( pmax->x > max->x ) max->x = pmax->x;
+    if( pmax->y > max->y ) max->y = pmax->y;
+    if( pmax->z > max->z ) max->z = pmax->z;
+}
+
+static float Bvh_Area( const TVec3 * min, const TVec3 * max ) {
+    TVec3 d = Vec3_Sub( *max, *min );
+    return 2.0f * ( d.x * d.y + d.y * d.z + d.z * d.x );
+}
+
+static void Bvh_BuildNode( TBvhBuilder * builder, int nodeIndex, int first, int count, int depth ) {
+    TBvh * bvh = builder->bvh;
+    int * indices = bvh->indices + first;
+    TBvhNode * node = bvh->nodes + nodeIndex;
+    TVec3 centroidMin = Vec3_Set( FLT_MAX, FLT_MAX, FLT_MAX );
+    TVec3 centroidMax = Vec3_Set( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+    node->min = centroidMin;
+    node->max = centroidMax;
+    for( int i = 0; i < count; i++ ) {
+        Bvh_Grow( &node->min, &node->max, builder->triangleMin + indices[i], builder->triangleMax + indices[i] );
+        Bvh_Grow( &centroidMin, &centroidMax, builder->centroid + indices[i], builder->centroid + indices[i] );
+    }
+    node->offset = first;
+    node->count = count;
+    if( count <= BVH_MIN_LEAF_TRIANGLES || depth >= BVH_MAX_DEPTH ) {
+        return;
+    }
+    // find cheapest split between bins on each axis
+    float parentArea = Bvh_Area( &node->min, &node->max );
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestSplit = 0;
+    for( int axis = 0; axis < 3; axis++ ) {
+        float cmin = Bvh_Component( &centroidMin, axis );
+        float extent = Bvh_Component( &centroidMax, axis ) - cmin;
+        if( extent <= 0.0f ) {
+            continue;
+        }
+        float scale = BVH_BIN_COUNT / extent;
+        TBvhBin bins[BVH_BIN_COUNT];
+        for( int b = 0; b < BVH_BIN_COUNT; b++ ) {
+            bins[b].min = Vec3_Set( FLT_MAX, FLT_MAX, FLT_MAX );
+            bins[b].max = Vec3_Set( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+            bins[b].count = 0;
+        }
+        for( int i = 0; i < count; i++ ) {
+            int b = (int)(( Bvh_Component( builder->centroid + indices[i], axis ) - cmin ) * scale );
+            b = b < BVH_BIN_COUNT ? b : BVH_BIN_COUNT - 1;
+            Bvh_Grow( &bins[b].min, &bins[b].max, builder->triangleMin + indices[i], builder->triangleMax + indices[i] );
+            bins[b].count++;
+        }
+        // sweep from right, then from left; split 's' puts bins [0, s) to the left
+        float rightArea[BVH_BIN_COUNT];
+        int rightCount[BVH_BIN_COUNT];
+        TVec3 min = Vec3_Set( FLT_MAX, FLT_MAX, FLT_MAX );
+        TVec3 max = Vec3_Set( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+        int n = 0;
+        for( int s = BVH_BIN_COUNT - 1; s > 0; s-- ) {
+            Bvh_Grow( &min, &max, &bins[s].min, &bins[s].max );
+            n += bins[s].count;
+            rightArea[s] = n ? Bvh_Area( &min, &max ) : 0.0f;
+            rightCount[s] = n;
+        }
+        min = Vec3_Set( FLT_MAX, FLT_MAX, FLT_MAX );
+        max = Vec3_Set( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+        n = 0;
+        for( int s = 1; s < BVH_BIN_COUNT; s++ ) {
+            Bvh_Grow( &min, &max, &bins[ s - 1 ].min, &bins[ s - 1 ].max );
+            n += bins[ s - 1 ].count;
+            if( !n || !rightCount[s] ) {
+                continue;
+            }
+            float cost = BVH_TRAVERSAL_COST + ( Bvh_Area( &min, &max ) * n + rightArea[s] * rightCount[s] ) / parentArea;
+            if( cost < bestCost ) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = s;
+            }
+        }
+    }
+    // leaf is cheaper than split, or centroids can't be separated
+    if( bestAxis < 0 || ( bestCost >= count && count <= BVH_MAX_LEAF_TRIANGLES )) {
+        return;
+    }
+    // partition indices in place
+    float cmin = Bvh_Component( &centroidMin, bestAxis );
+    float scale = BVH_BIN_COUNT / ( Bvh_Component( &centroidMax, bestAxis ) - cmin );
+    int left = 0, right = count - 1;
+    while( left <= right ) {
+        int b = (int)(( Bvh_Component( builder->centroid + indices[left], bestAxis ) - cmin ) * scale );
+        b = b < BVH_BIN_COUNT ? b : BVH_BIN_COUNT - 1;
+        if( b < bestSplit ) {
+            left++;
+        } else {
+            int temp = indices[left];
+            indices[left] = indices[right];
+            indices[right--] = temp;
+        }
+    }
+    if( left == 0 || left == count ) {
+        return;
+    }
+    // first child follows the node, second one follows whole subtree of the first
+    node->count = 0;
+    int firstChild = bvh->nodeCount++;
+    Bvh_BuildNode( builder, firstChild, first, left, depth + 1 );
+    int secondChild = bvh->nodeCount++;
+    bvh->nodes[ nodeIndex ].offset = secondChild;
+    Bvh_BuildNode( builder, secondChild, first + left, count - left, depth + 1 );
+}
+
+void Bvh_Build( TBvh * bvh, const TTriangle * triangles, int triangleCount ) {
+    bvh->triangles = triangles;
+    bvh->triangleCount = triangleCount;
+    bvh->indices = Memory_NewCount( triangleCount, int );
+    // binary tree with n leaves has at most 2n - 1 nodes
+    int maxNodeCount = triangleCount > 0 ? 2 * triangleCount - 1 : 1;
+    bvh->nodes = Memory_NewCount( maxNodeCount, TBvhNode );
+    TScratchMark mark = Scratch_GetMark();
+    TBvhBuilder builder;
+    builder.bvh = bvh;
+    builder.triangleMin = Scratch_NewCount( triangleCount, TVec3 );
+    builder.triangleMax = Scratch_NewCount( triangleCount, TVec3 );
+    builder.centroid = Scratch_NewCount( triangleCount, TVec3 );
+    for( int i = 0; i < triangleCount; i++ ) {
+        const TTriangle * triangle = triangles + i;
+        builder.triangleMin[i] = triangle->a;
+        builder.triangleMax[i] = triangle->a;
+        Bvh_Grow( builder.triangleMin + i, builder.triangleMax + i, &triangle->b, &triangle->b );
+        Bvh_Grow( builder.triangleMin + i, builder.triangleMax + i, &triangle->c, &triangle->c );
+        builder.centroid[i] = Vec3_Middle( builder.triangleMin[i], builder.triangleMax[i] );
+        bvh->indices[i] = i;
+    }
+    bvh->nodeCount = 1;
+    Bvh_BuildNode( &builder, 0, 0, triangleCount, 0 );
+    Scratch_Rewind( mark );
+    bvh->nodes = Memory_Reallocate( bvh->nodes, bvh->nodeCount * sizeof( TBvhNode ));
+}
+
+void Bvh_Free( TBvh * bvh ) {
+    Memory_Free( bvh->nodes );
+    Memory_Free( bvh->indices );
+}
+
+void BvhQuery_Create( TBvhQuery * query ) {
+    query->indices = query->local;
+    query->count = 0;
+    query->capacity = BVH_QUERY_LOCAL_CAPACITY;
+}
+
+void BvhQuery_Free( TBvhQuery * query ) {
+    if( query->indices != query->local ) {
+        Memory_Free( query->indices );
+    }
+    BvhQuery_Create( query );
+}
+
+static void BvhQuery_Reserve( TBvhQuery * query, int capacity ) {
+    if( capacity <= query->capacity ) {
+        return;
+    }
+    while( query->capacity < capacity ) {
+        query->capacity *= 2;
+    }
+    if( query->indices == query->local ) {
+        query->indices = Memory_NewCount( query->capacity, int );
+        memcpy( query->indices, query->local, query->count * sizeof( int ));
+    } else {
+        query->indices = Memory_Reallocate( query->indices, query->capacity * sizeof( int ));
+    }
+}
+
+static bool Bvh_NodeIntersectSphere( const TBvhNode * node, const TSphereShape * sphere ) {
+    const TVec3 * p = &sphere->position;
+    float dx = p->x < node->min.x ? node->min.x - p->x : ( p->x > node->max.x ? p->x - node->max.x : 0.0f );
+    float dy = p->y < node->min.y ? node->min.y - p->y : ( p->y > node->max.y ? p->y - node->max.y : 0.0f );
+    float dz = p->z < node->min.z ? node->min.z - p->z : ( p->z > node->max.z ? p->z - node->max.z : 0.0f );
+    return dx * dx + dy * dy + dz * dz <= sphere->radius * sphere->radius;
+}
+
+// slab test against part of segment in [from, to], no divisions thanks to inverse direction
+static bool Bvh_NodeIntersectRay( const TBvhNode * node, const TRay * ray, float from, float to, float * entry ) {
+    // NaN from zero direction is ignored by fminf and fmaxf
+    float t1 = ( node->min.x - ray->begin.x ) * ray->invDir.x;
+    float t2 = ( node->max.x - ray->begin.x ) * ray->invDir.x;
+    float tmin = fmaxf( from, fminf( t1, t2 ));
+    float tmax = fminf( to, fmaxf( t1, t2 ));
+    t1 = ( node->min.y - ray->begin.y ) * ray->invDir.y;
+    t2 = ( node->max.y - ray->begin.y ) * ray->invDir.y;
+    tmin = fmaxf( tmin, fminf( t1, t2 ));
+    tmax = fminf( tmax, fmaxf( t1, t2 ));
+    t1 = ( node->min.z - ray->begin.z ) * ray->invDir.z;
+    t2 = ( node->max.z - ray->begin.z ) * ray->invDir.z;
+    tmin = fmaxf( tmin, fminf( t1, t2 ));
+    tmax = fminf( tmax, fmaxf( t1, t2 ));
+    *entry = tmin;
+    return tmin <= tmax;
+}
+
+static void Bvh_Collect( const TBvh * bvh, const TSphereShape * sphere, const TRay * ray, TBvhQuery * query ) {
+    query->count = 0;
+    if( !bvh->triangleCount ) {
+        return;
+    }
+    int stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    int index = 0;
+    float entry;
+    while( true ) {
+        const TBvhNode * node = bvh->nodes + index;
+        bool hit = sphere ? Bvh_NodeIntersectSphere( node, sphere ) : Bvh_NodeIntersectRay( node, ray, 0.0f, 1.0f, &entry );
+        if( hit ) {
+            if( node->count ) {
+                BvhQuery_Reserve( query, query->count + node->count );
+                memcpy( query->indices + query->count, bvh->indices + node->offset, node->count * sizeof( int ));
+                query->count += node->count;
+            } else {
+                // go to first child, second one is visited later
+                stack[ top++ ] = node->offset;
+                index++;
+                continue;
+            }
+        }
+        if( !top ) {
+            break;
+        }
+        index = stack[ --top ];
+    }
+}
+
+void Bvh_QuerySphere( const TBvh * bvh, const TSphereShape * sphere, TBvhQuery * query ) {
+    Bvh_Collect( bvh, sphere, NULL, query );
+}
+
+void Bvh_QueryRay( const TBvh * bvh, const TRay * ray, TBvhQuery * query ) {
+    Bvh_Collect( bvh, NULL, ray, query );
+}
+
+// same as Intersection_RayTriangle with segment, but hit must be in [from, to) and parameter of point is returned
+static bool Bvh_RayTriangle( const TRay * ray, const TTriangle * triangle, float from, float to, float * t, TVec3 * point ) {
+    float v = Vec3_Dot( ray->dir, triangle->normal );
+    if( v == 0.0f ) {
+        return false;
+    }
+    float u = -( Vec3_Dot( ray->begin, triangle->normal ) + triangle->distance );
+    float tHit = u / v;
+    if( tHit < from || tHit >= to ) {
+        return false;
+    }
+    TVec3 hitPoint = Vec3_Add( ray->begin, Vec3_Scale( ray->dir, tHit ));
+    if( !Triangle_CheckPoint( &hitPoint, triangle )) {
+        return false;
+    }
+    *t = tHit;
+    *point = hitPoint;
+    return true;
+}
+
+typedef struct TBvhStackEntry {
+    int node;
+    float entry;
+} TBvhStackEntry;
+
+int Bvh_TraceRayClosest( const TBvh * bvh, const TRay * ray, float * t, TVec3 * point ) {
+    int closest = -1;
+    float entry;
+    if( !bvh->triangleCount || !Bvh_NodeIntersectRay( bvh->nodes, ray, 0.0f, *t, &entry )) {
+        return closest;
+    }
+    TBvhStackEntry stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    int index = 0;
+    while( true ) {
+        const TBvhNode * node = bvh->nodes + index;
+        if( node->count ) {
+            for( int i = 0; i < node->count; i++ ) {
+                int triangleIndex = bvh->indices[ node->offset + i ];
+                if( Bvh_RayTriangle( ray, bvh->triangles + triangleIndex, 0.0f, *t, t, point )) {
+                    closest = triangleIndex;
+                }
+            }
+        } else {
+            // visit nearest child first, farther one waits on stack with its entry distance
+            int first = index + 1, second = node->offset;
+            float firstEntry, secondEntry;
+            bool firstHit = Bvh_NodeIntersectRay( bvh->nodes + first, ray, 0.0f, *t, &firstEntry );
+            bool secondHit = Bvh_NodeIntersectRay( bvh->nodes + second, ray, 0.0f, *t, &secondEntry );
+            if( firstHit && secondHit ) {
+                if( secondEntry < firstEntry ) {
+                    stack[ top ].node = first;
+                    stack[ top++ ].entry = firstEntry;
+                    index = second;
+                } else {
+                    stack[ top ].node = second;
+                    stack[ top++ ].entry = secondEntry;
+                    index = first;
+                }
+                continue;
+            } else if( firstHit || secondHit ) {
+                index = firstHit ? first : second;
+                continue;
+            }
+        }
+        // skip nodes that begin behind the closest hit
+        while( top && stack[ top - 1 ].entry > *t ) {
+            top--;
+        }
+        if( !top ) {
+            break;
+        }
+        index = stack[ --top ].node;
+    }
+    return closest;
+}
+
+bool Bvh_IsOccluded( const TBvh * bvh, const TRay * ray, float tmin, float tmax ) {
+    if( !bvh->triangleCount ) {
+        return false;
+    }
+    // order of visit doesn't matter, any hit ends the query
+    int stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    int index = 0;
+    float entry, t;
+    TVec3 point;
+    while( true ) {
+        const TBvhNode * node = bvh->nodes + index;
+        if( Bvh_NodeIntersectRay( node, ray, tmin, tmax, &entry )) {
+            if( node->count ) {
+                for( int i = 0; i < node->count; i++ ) {
+                    if( Bvh_RayTriangle( ray, bvh->triangles + bvh->indices[ node->offset + i ], tmin, tmax, &t, &point )) {
+                        return true;
+                    }
+                }
+            } else {
+                stack[ top++ ] = node->offset;
+                index++;
+                continue;
+            }
+        }
+        if( !top ) {
+            break;
+        }
+        index = stack[ --top ];
+    }
+    return false;
+}
+
+#define BENCHMARK_BVH_QUERY_COUNT (10000)
+
+// random point inside of bounds of triangles
+static TVec3 Bvh_RandomPoint( const TBvh * bvh ) {
+    TVec3 d = Vec3_Sub( bvh->nodes[0].max, bvh->nodes[0].min );
+    return Vec3_Add( bvh->nodes[0].min, Vec3_Set( d.x * ( rand() % 1000 ) / 1000.0f, d.y * ( rand() % 1000 ) / 1000.0f, d.z * ( rand() % 1000 ) / 1000.0f ));
+}
+
+// counts triangles from query result that pass exact test, as collision code does
+static int Bvh_CountHits( const TTriangle * triangles, const int * indices, int count, const TSphereShape * sphere, const TRay * ray ) {
+    int hits = 0;
+    for( int i = 0; i < count; i++ ) {
+        TVec3 point;
+        const TTriangle * triangle = triangles + indices[i];
+        if( sphere ? Intersection_SphereTriangle( sphere, triangle, &point ) : Intersection_RayTriangle( ray, triangle, &point, RAY_LINE_SEGMENT )) {
+            hits++;
+        }
+    }
+    return hits;
+}
+
+void Bvh_Benchmark( TTriangle * triangles, int triangleCount ) {
+    TTimer timer;
+    Timer_Create( &timer );
+    TBvh bvh;
+    Bvh_Build( &bvh, triangles, triangleCount );
+    double bvhBuildTime = Timer_GetElapsedMilliseconds( &timer );
+    Timer_Restart( &timer );
+    TOctree octree;
+    Octree_Build( &octree, triangles, triangleCount, 64 );
+    double octreeBuildTime = Timer_GetElapsedMilliseconds( &timer );
+    // same queries for both structures
+    TScratchMark mark = Scratch_GetMark();
+    TSphereShape * spheres = Scratch_NewCount( BENCHMARK_BVH_QUERY_COUNT, TSphereShape );
+    TRay * rays = Scratch_NewCount( BENCHMARK_BVH_QUERY_COUNT, TRay );
+    srand( triangleCount );
+    float size = Vec3_Length( Vec3_Sub( bvh.nodes[0].max, bvh.nodes[0].min ));
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        spheres[i] = SphereShape_Set( Bvh_RandomPoint( &bvh ), size * 0.01f );
+        rays[i] = Ray_Set( Bvh_RandomPoint( &bvh ), Bvh_RandomPoint( &bvh ));
+    }
+    // time includes exact tests, because duplicates and loose leaves cost there
+    int bvhSphereIndices = 0, bvhSphereHits = 0, octreeSphereIndices = 0, octreeSphereHits = 0;
+    int bvhRayIndices = 0, bvhRayHits = 0, octreeRayIndices = 0, octreeRayHits = 0;
+    TBvhQuery query;
+    BvhQuery_Create( &query );
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        Bvh_QuerySphere( &bvh, spheres + i, &query );
+        bvhSphereIndices += query.count;
+        bvhSphereHits += Bvh_CountHits( triangles, query.indices, query.count, spheres + i, NULL );
+    }
+    double bvhSphereTime = Timer_GetElapsedMilliseconds( &timer );
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        Octree_GetContainIndex( &octree, spheres + i );
+        octreeSphereIndices += octree.containIndexCount;
+        octreeSphereHits += Bvh_CountHits( triangles, octree.containIndices, octree.containIndexCount, spheres + i, NULL );
+    }
+    double octreeSphereTime = Timer_GetElapsedMilliseconds( &timer );
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        Bvh_QueryRay( &bvh, rays + i, &query );
+        bvhRayIndices += query.count;
+        bvhRayHits += Bvh_CountHits( triangles, query.indices, query.count, NULL, rays + i );
+    }
+    double bvhRayTime = Timer_GetElapsedMilliseconds( &timer );
+    BvhQuery_Free( &query );
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        Octree_TraceRay( &octree, rays + i );
+        octreeRayIndices += octree.containIndexCount;
+        octreeRayHits += Bvh_CountHits( triangles, octree.containIndices, octree.containIndexCount, NULL, rays + i );
+    }
+    double octreeRayTime = Timer_GetElapsedMilliseconds( &timer );
+    // closest hit, octree way is to test whole list as Ray_TraceWorldStatic did
+    int bvhClosestHits = 0, octreeClosestHits = 0;
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        float t = 1.0f;
+        TVec3 point;
+        if( Bvh_TraceRayClosest( &bvh, rays + i, &t, &point ) >= 0 ) {
+            bvhClosestHits++;
+        }
+    }
+    double bvhClosestTime = Timer_GetElapsedMilliseconds( &timer );
+    int bvhOccludedHits = 0;
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        if( Bvh_IsOccluded( &bvh, rays + i, 0.0f, 1.0f )) {
+            bvhOccludedHits++;
+        }
+    }
+    double bvhOccludedTime = Timer_GetElapsedMilliseconds( &timer );
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_BVH_QUERY_COUNT; i++ ) {
+        Octree_TraceRay( &octree, rays + i );
+        float closest = FLT_MAX;
+        for( int k = 0; k < octree.containIndexCount; k++ ) {
+            TVec3 point;
+            if( Intersection_RayTriangle( rays + i, triangles + octree.containIndices[k], &point, RAY_LINE_SEGMENT )) {
+                closest = fminf( closest, Vec3_SqrDistance( point, rays[i].begin ));
+            }
+        }
+        if( closest < FLT_MAX ) {
+            octreeClosestHits++;
+        }
+    }
+    double octreeClosestTime = Timer_GetElapsedMilliseconds( &timer );
+    Scratch_Rewind( mark );
+    printf( "Bvh: %d triangles, %d nodes: build bvh %.3f ms, octree %.3f ms\n", triangleCount, bvh.nodeCount, bvhBuildTime, octreeBuildTime );
+    printf( "Bvh: %d sphere queries: bvh %.3f ms ( %d indices, %d hits ), octree %.3f ms ( %d indices, %d hits )\n",
+        BENCHMARK_BVH_QUERY_COUNT, bvhSphereTime, bvhSphereIndices, bvhSphereHits, octreeSphereTime, octreeSphereIndices, octreeSphereHits );
+    printf( "Bvh: %d ray queries: bvh %.3f ms ( %d indices, %d hits ), octree %.3f ms ( %d indices, %d hits )\n",
+        BENCHMARK_BVH_QUERY_COUNT, bvhRayTime, bvhRayIndices, bvhRayHits, octreeRayTime, octreeRayIndices, octreeRayHits );
+    printf( "Bvh: %d closest hit queries: bvh %.3f ms ( %d hits ), octree %.3f ms ( %d hits )\n",
+        BENCHMARK_BVH_QUERY_COUNT, bvhClosestTime, bvhClosestHits, octreeClosestTime, octreeClosestHits );
+    printf( "Bvh: %d occlusion queries: bvh %.3f ms ( %d hits )\n", BENCHMARK_BVH_QUERY_COUNT, bvhOccludedTime, bvhOccludedHits );
+    Bvh_Free( &bvh );
+    Octree_Free( &octree );
+}
+
+// checks against brute force are done on every launch, so test cave is small
+#define TEST_BVH_RINGS (16)
+#define TEST_BVH_SEGMENTS (24)
+#define TEST_BVH_QUERY_COUNT (64)
+#define BENCHMARK_BVH_RINGS (60)
+#define BENCHMARK_BVH_SEGMENTS (80)
+
+// bumpy closed surface, similar to a cave
+static TVec3 Test_BvhCavePoint( int ring, int ringCount, int segment, int segmentCount ) {
+    float theta = M_PI * ring / ringCount;
+    float phi = 2.0f * M_PI * segment / segmentCount;
+    float radius = 30.0f + 3.0f * sinf( 5.0f * theta ) * cosf( 7.0f * phi ) + 1.5f * sinf( 13.0f * phi + 3.0f * theta );
+    return Vec3_Set( radius * sinf( theta ) * cosf( phi ) * 2.0f, radius * cosf( theta ) * 0.5f, radius * sinf( theta ) * sinf( phi ));
+}
+
+static bool Test_BvhContains( const int * indices, int count, int index ) {
+    for( int i = 0; i < count; i++ ) {
+        if( indices[i] == index ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct TTestBvhJobData {
+    const TBvh * bvh;
+    TSphereShape * spheres;
+    TRay * rays;
+    // expected results
+    int * sphereCounts;
+    int * closest;
+    volatile long failed;
+} TTestBvhJobData;
+
+static void Test_BvhJob( void * data, int index ) {
+    TTestBvhJobData * test = data;
+    TBvhQuery query;
+    BvhQuery_Create( &query );
+    Bvh_QuerySphere( test->bvh, test->spheres + index, &query );
+    float t = 1.0f;
+    TVec3 point;
+    if( query.count != test->sphereCounts[index] || Bvh_TraceRayClosest( test->bvh, test->rays + index, &t, &point ) != test->closest[index] ) {
+        Atomic_Increment( &test->failed );
+    }
+    BvhQuery_Free( &query );
+}
+
+static TTriangle * Test_BvhCreateCave( int ringCount, int segmentCount, int * triangleCount ) {
+    *triangleCount = ringCount * segmentCount * 2;
+    TTriangle * triangles = Memory_NewCount( *triangleCount, TTriangle );
+    int n = 0;
+    for( int ring = 0; ring < ringCount; ring++ ) {
+        for( int segment = 0; segment < segmentCount; segment++ ) {
+            TVec3 a = Test_BvhCavePoint( ring, ringCount, segment, segmentCount );
+            TVec3 b = Test_BvhCavePoint( ring + 1, ringCount, segment, segmentCount );
+            TVec3 c = Test_BvhCavePoint( ring + 1, ringCount, segment + 1, segmentCount );
+            TVec3 d = Test_BvhCavePoint( ring, ringCount, segment + 1, segmentCount );
+            Triangle_Set( triangles + n++, &a, &b, &c );
+            Triangle_Set( triangles + n++, &a, &c, &d );
+        }
+    }
+    return triangles;
+}
+
+void Test_Bvh( void ) {
+    int triangleCount;
+    TTriangle * triangles = Test_BvhCreateCave( TEST_BVH_RINGS, TEST_BVH_SEGMENTS, &triangleCount );
+    TBvh bvh;
+    Bvh_Build( &bvh, triangles, triangleCount );
+    // every triangle is in exactly one leaf
+    char * seen = Memory_NewCount( triangleCount, char );
+    for( int i = 0; i < bvh.nodeCount; i++ ) {
+        for( int k = 0; k < bvh.nodes[i].count; k++ ) {
+            int index = bvh.indices[ bvh.nodes[i].offset + k ];
+            if( seen[ index ] ) {
+                Util_RaiseError( "Test_Bvh: triangle %d is in two leaves!", index );
+            }
+            seen[ index ] = 1;
+        }
+    }
+    // queries must report every triangle found by exact test
+    TTestBvhJobData data;
+    data.bvh = &bvh;
+    data.spheres = Memory_NewCount( TEST_BVH_QUERY_COUNT, TSphereShape );
+    data.rays = Memory_NewCount( TEST_BVH_QUERY_COUNT, TRay );
+    data.sphereCounts = Memory_NewCount( TEST_BVH_QUERY_COUNT, int );
+    data.closest = Memory_NewCount( TEST_BVH_QUERY_COUNT, int );
+    TBvhQuery sphereQuery, rayQuery;
+    BvhQuery_Create( &sphereQuery );
+    BvhQuery_Create( &rayQuery );
+    srand( 1 );
+    for( int q = 0; q < TEST_BVH_QUERY_COUNT; q++ ) {
+        TSphereShape sphere = SphereShape_Set( Bvh_RandomPoint( &bvh ), 1.0f + ( rand() % 100 ) / 20.0f );
+        Bvh_QuerySphere( &bvh, &sphere, &sphereQuery );
+        TRay ray = Ray_Set( Bvh_RandomPoint( &bvh ), Bvh_RandomPoint( &bvh ));
+        Bvh_QueryRay( &bvh, &ray, &rayQuery );
+        float closest = FLT_MAX;
+        for( int i = 0; i < triangleCount; i++ ) {
+            TVec3 point;
+            if( Intersection_SphereTriangle( &sphere, triangles + i, &point ) && !Test_BvhContains( sphereQuery.indices, sphereQuery.count, i )) {
+                Util_RaiseError( "Test_Bvh: sphere query missed triangle %d!", i );
+            }
+            if( Intersection_RayTriangle( &ray, triangles + i, &point, RAY_LINE_SEGMENT )) {
+                if( !Test_BvhContains( rayQuery.indices, rayQuery.count, i )) {
+                    Util_RaiseError( "Test_Bvh: ray query missed triangle %d!", i );
+                }
+                closest = fminf( closest, Vec3_SqrDistance( point, ray.begin ));
+            }
+        }
+        // closest hit must be the nearest of all hits
+        float t = 1.0f;
+        TVec3 point;
+        int closestIndex = Bvh_TraceRayClosest( &bvh, &ray, &t, &point );
+        if(( closestIndex >= 0 ) != ( closest < FLT_MAX )) {
+            Util_RaiseError( "Test_Bvh: closest hit query disagrees with exact test!" );
+        }
+        if( closestIndex >= 0 && fabsf( Vec3_SqrDistance( point, ray.begin ) - closest ) > 0.001f ) {
+            Util_RaiseError( "Test_Bvh: closest hit query found farther triangle %d!", closestIndex );
+        }
+        // any hit must agree with closest one, also before and after it
+        if( Bvh_IsOccluded( &bvh, &ray, 0.0f, 1.0f ) != ( closestIndex >= 0 )) {
+            Util_RaiseError( "Test_Bvh: occlusion query disagrees with closest hit!" );
+        }
+        if( closestIndex >= 0 && ( Bvh_IsOccluded( &bvh, &ray, 0.0f, t * 0.999f ) || !Bvh_IsOccluded( &bvh, &ray, t * 0.999f, 1.0f ))) {
+            Util_RaiseError( "Test_Bvh: occlusion query ignores bounds of segment!" );
+        }
+        data.spheres[q] = sphere;
+        data.rays[q] = ray;
+        data.sphereCounts[q] = sphereQuery.count;
+        data.closest[q] = closestIndex;
+    }
+    BvhQuery_Free( &sphereQuery );
+    BvhQuery_Free( &rayQuery );
+    // same queries from all workers at once must give same results
+    data.failed = 0;
+    TJobBatch batch = JOB_BATCH_INITIALIZER;
+    Jobs_Dispatch( &batch, Test_BvhJob, &data, TEST_BVH_QUERY_COUNT );
+    Jobs_Wait( &batch );
+    JobBatch_Free( &batch );
+    if( data.failed ) {
+        Util_RaiseError( "Test_Bvh: %d queries from jobs gave different results!", data.failed );
+    }
+    Memory_Free( data.spheres );
+    Memory_Free( data.rays );
+    Memory_Free( data.sphereCounts );
+    Memory_Free( data.closest );
+    Memory_Free( seen );
+    Bvh_Free( &bvh );
+    Memory_Free( triangles );
+}
+
+void Benchmark_Bvh( void ) {
+    int triangleCount;
+    TTriangle * triangles = Test_BvhCreateCave( BENCHMARK_BVH_RINGS, BENCHMARK_BVH_SEGMENTS, &triangleCount );
+    Bvh_Benchmark( triangles, triangleCount );
+    Memory_Free( triangles );
+}
@@ -0,0 +1,76 @@
+#ifndef _BVH_
+#define _BVH_
+
+/* Bounding volume hierarchy used for collision detection and lightmap generation
+ * with static triangle soups
+ */
+
+#include "common.h"
+#include "vector3.h"
+
+OLDTECH_BEGIN_HEADER
+
+struct TTriangle;
+struct TSphereShape;
+struct TRay;
+
+// nodes are stored in depth-first order, so first child of inner node follows it
+typedef struct TBvhNode {
+    TVec3 min;
+    int offset; // first index in 'indices' for leaf, index of second child for inner node
+    TVec3 max;
+    int count; // count of triangles in leaf, zero for inner node
+} TBvhNode;
+
+typedef struct TBvh {
+    TBvhNode * nodes;
+    int nodeCount;
+    int * indices; // triangle indices of leaves, each triangle is in exactly one leaf
+    const struct TTriangle * triangles; // not owned, must outlive bvh
+    int triangleCount;
+} TBvh;
+
+#define BVH_QUERY_LOCAL_CAPACITY (128)
+
+// Result of a query, owned by caller, so any number of threads can query same bvh.
+// Usually lives on stack, indices go to heap only if local storage is too small:
+//
+//      TBvhQuery query;
+//      BvhQuery_Create( &query );
+//      Bvh_QuerySphere( bvh, &sphere, &query );
+//      ...
+//      BvhQuery_Free( &query );
+typedef struct TBvhQuery {
+    int * indices; // has no duplicates
+    int count;
+    int capacity;
+    int local[BVH_QUERY_LOCAL_CAPACITY];
+} TBvhQuery;
+
+void BvhQuery_Create( TBvhQuery * query );
+void BvhQuery_Free( TBvhQuery * query );
+
+// splits are chosen by surface area heuristic over centroids put in bins
+void Bvh_Build( TBvh * bvh, const struct TTriangle * triangles, int triangleCount );
+void Bvh_Free( TBvh * bvh );
+// collects triangles of leaves touched by sphere, previous result of query is discarded
+void Bvh_QuerySphere( const TBvh * bvh, const struct TSphereShape * sphere, TBvhQuery * query );
+// collects triangles of leaves touched by segment from ray->begin to ray->begin + ray->dir
+void Bvh_QueryRay( const TBvh * bvh, const struct TRay * ray, TBvhQuery * query );
+// finds nearest triangle hit by segment closer than 't' ( fraction of ray->dir, 1.0 for whole segment ).
+// returns its index and updates 't' and 'point', or returns -1. children are visited front to back
+// and nodes farther than the hit are skipped
+int Bvh_TraceRayClosest( const TBvh * bvh, const struct TRay * ray, float * t, TVec3 * point );
+// returns true on first triangle hit by segment in [tmin, tmax) ( fractions of ray->dir )
+bool Bvh_IsOccluded( const TBvh * bvh, const struct TRay * ray, float tmin, float tmax );
+
+// prints build and query time of bvh and octree over same triangles
+void Bvh_Benchmark( struct TTriangle * triangles, int triangleCount );
+// tests
+void Test_Bvh( void );
+// runs Bvh_Benchmark over large cave-like mesh
+void Benchmark_Bvh( void );
+
+OLDTECH_END_HEADER
+
+#endif
@@ -22,13 +22,44 @@ void Camera_MakeCurrent( TCamera * pCam ) {
 void Camera_BuildMatrices( TCamera * cam ) {
 	TEntity * owner = cam->owner;
     if( owner ) {		
-        Entity_CalculateGlobalTransform( owner );
+        // render transform of the owner is already updated by World_InterpolateTransforms
         cam->projectionMatrix = Matrix4_PerspectiveFov( cam->halfFov, Renderer_GetWindowAspectRatio(), cam->zNear, cam->zFar );
-        TVec3 eye = Entity_GetGlobalPosition( owner );
-        TVec3 up = Entity_GetUpVector( owner );
-        TVec3 lookAt = Vec3_Add( eye, Entity_GetLookVector( owner ));
+        const float * m = owner->renderTransform.f;
+        TVec3 eye = Vec3_Set( m[12], m[13], m[14] );
+        TVec3 up = Vec3_Set( m[4], m[5], m[6] );
+        TVec3 lookAt = Vec3_Add( eye, Vec3_Set( m[8], m[9], m[10] ));
         cam->viewMatrix = Matrix4_LookAt( eye, lookAt, up );
     }
+    // planes are sums and differences of fourth and other columns of view-projection matrix
+    TMatrix4 viewProjection;
+    Matrix4_MultiplyTo( &cam->viewMatrix, &cam->projectionMatrix, &viewProjection );
+    const float * m = viewProjection.f;
+    for( int i = 0; i < 6; i++ ) {
+        int column = i / 2;
+        float sign = ( i % 2 ) ? -1.0f : 1.0f;
+        float * plane = cam->frustum[i];
+        plane[0] = m[3] + sign * m[column];
+        plane[1] = m[7] + sign * m[4 + column];
+        plane[2] = m[11] + sign * m[8 + column];
+        plane[3] = m[15] + sign * m[12 + column];
+        float length = sqrtf( plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2] );
+        if( length > 0.0f ) {
+            plane[0] /= length;
+            plane[1] /= length;
+            plane[2] /= length;
+            plane[3] /= length;
+        }
+    }
+}
+
+bool Camera_IsSphereVisible( const TCamera * cam, TVec3 center, float radius ) {
+    for( int i = 0; i < 6; i++ ) {
+        const float * plane = cam->frustum[i];
+        if( plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3] < -radius ) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void Camera_EnterDepthHack( TCamera * cam, float depthHack ) {    
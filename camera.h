@@ -17,6 +17,8 @@ typedef struct TCamera {
     TMatrix4 projectionMatrix;
     TMatrix4 tempProjectionMatrix;
     bool inDepthHack;
+    // normalized planes (a, b, c, d) of view frustum, normals point inside
+    float frustum[6][4];
 } TCamera;
 
 extern TCamera * pActiveCamera;
@@ -26,6 +28,8 @@ void Camera_MakeCurrent( TCamera * pCam );
 void Camera_BuildMatrices( TCamera * cam );
 void Camera_EnterDepthHack( TCamera * cam, float depthHack );
 void Camera_LeaveDepthHack( TCamera * cam );
+// uses frustum of last Camera_BuildMatrices
+bool Camera_IsSphereVisible( const TCamera * cam, TVec3 center, float radius );
 
 OLDTECH_END_HEADER
 
@@ -1,17 +1,27 @@
 #include "collision.h"
+#include "timer.h"
 #include <float.h>
 
 TDynamicsWorld g_dynamicsWorld;
 
+// bodies can move this far before their bounds in body tree are updated
+#define DYNAMICS_BOUNDS_MARGIN (0.25f)
+
 //====================================
 // RAY ROUTINE
 //====================================
+// infinity on zero component is handled by slab tests
+static TVec3 Ray_InvertDirection( TVec3 dir ) {
+    return Vec3_Set( 1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z );
+}
+
 TRay Ray_Set( TVec3 begin, TVec3 end ) {
-    return (TRay) { .begin = begin, .end = end, .dir = Vec3_Sub( end, begin ) };
+    TVec3 dir = Vec3_Sub( end, begin );
+    return (TRay) { .begin = begin, .end = end, .dir = dir, .invDir = Ray_InvertDirection( dir ) };
 }
 
 TRay Ray_SetDirection( TVec3 begin, TVec3 direction ) {
-    return (TRay) { .begin = begin, .end = direction, .dir = direction };
+    return (TRay) { .begin = begin, .end = direction, .dir = direction, .invDir = Ray_InvertDirection( direction ) };
 }
 
 bool Intersection_RayPlane( const TRay * ray, const TPlane * plane, TVec3 * outIntersectPoint, ERayType rayType ) {
@@ -70,8 +80,10 @@ TSphereShape SphereShape_Set( TVec3 position, float radius ) {
 // CAPSULE INTERSECTION AND DYNAMICS
 //====================================
 TCollisionShape * CapsuleShape_Create( TVec3 a, TVec3 b, float radius ) {
+    Memory_PushTag( MEMORY_TAG_COLLISION );
     TCollisionShape * shape = Memory_New( TCollisionShape );
     shape->capsule = Memory_New( TCapsuleShape );
+    Memory_PopTag();
     shape->capsule->a = a;
     shape->capsule->b = b;
     shape->capsule->radius = radius;
@@ -126,12 +138,14 @@ void Dynamics_CapsulePolygonCollision( TBody * capsuleBody, TBody * polygon ) {
     float fakeSphereRadius = capsuleBody->shape->capsule->radius + Vec3_Distance( capsuleBody->shape->capsule->a, capsuleBody->shape->capsule->b ) / 2;
     TSphereShape sph = SphereShape_Set( capsuleBody->position, fakeSphereRadius );
     // acquire for list of triangle indices in the polygon, that are close enough to our capsule
-    Octree_GetContainIndex( &polygon->shape->octree, &sph );
+    TBvhQuery query;
+    BvhQuery_Create( &query );
+    Bvh_QuerySphere( &polygon->shape->bvh, &sph, &query );
     
     TCapsuleShape * capsuleShape = capsuleBody->shape->capsule;
     
-    for( int i = 0; i < polygon->shape->octree.containIndexCount; i++ ) {
-        TTriangle * triangle = polygon->shape->triangles + polygon->shape->octree.containIndices[i];
+    for( int i = 0; i < query.count; i++ ) {
+        TTriangle * triangle = polygon->shape->triangles + query.indices[i];
 
         // create copy of actual capsule shape and add body's offset to it
         TCapsuleShape shape = *capsuleShape;
@@ -158,6 +172,7 @@ void Dynamics_CapsulePolygonCollision( TBody * capsuleBody, TBody * polygon ) {
             }
         }
     }
+    BvhQuery_Free( &query );
 }
 
 //====================================
@@ -322,105 +337,76 @@ TVec3 Geometry_ProjectPointOnLine( TVec3 point, TVec3 a, TVec3 b ) {
 // RAY-TRACING ROUTINE
 //====================================
 void Ray_TraceWorldStatic( TRay * ray, TRayTraceResult * out ) {
-    TTriangle * nearestTriangle = 0;
-    TVec3 nearestPosition;
-    TVec3 nearestNormal;
-    TBody * nearestBody = 0;
-    float distanceToNearest = FLT_MAX;
-
+    out->body = NULL;
+    out->triangle = NULL;
+    // closest hit so far limits traversal of next polygons
+    float t = 1.0f;
     for_each( TBody, body, g_dynamicsWorld.bodies ) {
-        // trace ray through polygon to find nearest triangle 
         if( body->shape->type == SHAPE_POLYGON ) {
-            // trace ray through polygon's octree 
-            Octree_TraceRay( &body->shape->octree, ray );
-            for( int i = 0; i < body->shape->octree.containIndexCount; i++ ) {
-                int currentTriangleIndex = body->shape->octree.containIndices[i];
-                TTriangle * triangle = &body->shape->triangles[ currentTriangleIndex ];
-                TVec3 intersectionPoint;
-                const float sqrDistanceThreshold = 0.025f;
-                if( Intersection_RayTriangle( ray, triangle, &intersectionPoint, RAY_INFINITE ) ) {
-                    float sqrDist = Vec3_SqrDistance( intersectionPoint, ray->begin );
-                    if( sqrDist < distanceToNearest ) {
-                        distanceToNearest = sqrDist;
-                        nearestTriangle = triangle;
-                        nearestPosition = intersectionPoint;
-                        nearestNormal = triangle->normal;
-                        nearestBody = body;                            
-                        if( sqrDist < sqrDistanceThreshold ) {
-                            break;
-                        }
-                    }
-                }                
+            TVec3 intersectionPoint;
+            int triangleIndex = Bvh_TraceRayClosest( &body->shape->bvh, ray, &t, &intersectionPoint );
+            if( triangleIndex >= 0 ) {
+                out->body = body;
+                out->triangle = body->shape->triangles + triangleIndex;
+                out->position = intersectionPoint;
+                out->normal = out->triangle->normal;
             }
         }
     }
-
-    out->body = nearestBody;
-    out->position = nearestPosition;
-    out->triangle = nearestTriangle;
-    out->normal = nearestNormal;
 }
 
-void Ray_TraceWorldStaticMultithreaded( TRay * ray, TRayTraceResult * out, int threadNum ) {
-    TTriangle * nearestTriangle = 0;
-    TVec3 nearestPosition;
-    TVec3 nearestNormal;
-    TBody * nearestBody = 0;
-    float distanceToNearest = FLT_MAX;
-
+bool Ray_Occluded( const TRay * ray, float tmin, float tmax ) {
     for_each( TBody, body, g_dynamicsWorld.bodies ) {
-        // trace ray through polygon to find nearest triangle 
         if( body->shape->type == SHAPE_POLYGON ) {
-            // trace ray through polygon's octree 
-            Octree_TraceRayMultithreaded( &body->shape->octree, ray, threadNum );
-            for( int i = 0; i < body->shape->octree.containIndexCountMT[threadNum]; i++ ) {
-                int * ptr = body->shape->octree.containIndicesMT[threadNum];
-                int currentTriangleIndex = *(ptr + i);               
-                TTriangle * triangle = &body->shape->triangles[ currentTriangleIndex ];
-                TVec3 intersectionPoint;
-                const float sqrDistanceThreshold = 0.025f;
-                if( Intersection_RayTriangle( ray, triangle, &intersectionPoint, RAY_INFINITE ) ) {
-                    float sqrDist = Vec3_SqrDistance( intersectionPoint, ray->begin );
-                    if( sqrDist < distanceToNearest ) {
-                        distanceToNearest = sqrDist;
-                        nearestTriangle = triangle;
-                        nearestPosition = intersectionPoint;
-                        nearestNormal = triangle->normal;
-                        nearestBody = body;                            
-                        if( sqrDist < sqrDistanceThreshold ) {
-                            break;
-                        }
-                    }
-                }  
+            if( Bvh_IsOccluded( &body->shape->bvh, ray, tmin, tmax )) {
+                return true;
             }
         }
     }
-
-    out->body = nearestBody;
-    out->position = nearestPosition;
-    out->triangle = nearestTriangle;
-    out->normal = nearestNormal;
+    return false;
 }
 
-void Ray_TraceWorldDynamic( TRay * ray, TRayTraceResult * out ) {
-    for_each( TBody, body, g_dynamicsWorld.bodies ) {
-        // trace ray through spheres 
-        if( body->shape->type == SHAPE_SPHERE ) {
-            TSphereShape sph = SphereShape_Set( body->position, body->shape->sphereRadius );
-            TVec3 ip1, ip2;
-            if( Intersection_RaySphere( ray, &sph, &ip1, &ip2, RAY_INFINITE )) {
-                out->position = Vec3_Max( ip1, ip2 );
-                out->triangle = NULL;
-                out->normal = ray->dir;
-                out->body = body;
-                return;
+typedef struct TDynamicRayTrace {
+    TRay * ray;
+    TRayTraceResult * out;
+    float sqrDistance;
+} TDynamicRayTrace;
+
+static bool Ray_TraceBody( void * data, void * userData ) {
+    TBody * body = data;
+    TDynamicRayTrace * trace = userData;
+    // trace ray through spheres 
+    if( body->shape->type == SHAPE_SPHERE ) {
+        TSphereShape sph = SphereShape_Set( body->position, body->shape->sphereRadius );
+        TVec3 ip1, ip2;
+        if( Intersection_RaySphere( trace->ray, &sph, &ip1, &ip2, RAY_INFINITE )) {
+            TVec3 position = Vec3_Max( ip1, ip2 );
+            float sqrDistance = Vec3_SqrDistance( position, trace->ray->begin );
+            if( sqrDistance < trace->sqrDistance ) {
+                trace->sqrDistance = sqrDistance;
+                trace->out->position = position;
+                trace->out->triangle = NULL;
+                trace->out->normal = trace->ray->dir;
+                trace->out->body = body;
             }
         }
     }
+    return true;
+}
+
+void Ray_TraceWorldDynamic( TRay * ray, TRayTraceResult * out ) {
     out->position = Vec3_Zero();
     out->body = NULL;
     out->normal = Vec3_Zero();
     out->triangle = NULL;
+    TDynamicRayTrace trace;
+    trace.ray = ray;
+    trace.out = out;
+    trace.sqrDistance = FLT_MAX;
+    // only bodies whose bounds are touched by segment are checked. Ray_SetDirection stores
+    // direction in 'end', so end of segment is always begin + dir
+    TVec3 end = Vec3_Add( ray->begin, ray->dir );
+    SpatialTree_QueryRay( &g_dynamicsWorld.bodyTree, &ray->begin, &end, Ray_TraceBody, &trace );
 }
 
 bool Intersection_EdgeSphere( const TRay * edgeRay, const TSphereShape * sphere, TVec3 * intersectionPoint ) {
@@ -571,7 +557,6 @@ void Shape_BoxFromSurfaces( TCollisionShape * shape, const TList * surfaces ) {
     shape->type = SHAPE_AABB;
     shape->triangleCount = 0;
     shape->triangles = 0;
-    shape->octree.root = 0;
     shape->sphereRadius = 0;
 }
 
@@ -580,7 +565,6 @@ void Shape_SphereFromSurfaces( TCollisionShape * shape, const TList * surfaces )
     shape->type = SHAPE_SPHERE;
     shape->triangleCount = 0;
     shape->triangles = 0;
-    shape->octree.root = 0;
     shape->sphereRadius = Vec3_Length( Vec3_Sub( shape->max, shape->min )) / 4.0f;
 }
 
@@ -591,6 +575,8 @@ void Shape_PolygonFromSurfaces( TCollisionShape * shape, const TList * surfaces
         shape->triangleCount += surface->faceCount;
     }    
     shape->type = SHAPE_POLYGON;
+    Shape_GetSurfacesExtents( surfaces, &shape->min, &shape->max );
+    Memory_PushTag( MEMORY_TAG_COLLISION );
     shape->triangles = Memory_NewCount( shape->triangleCount, TTriangle );
     shape->sphereRadius = 0;
     // copy triangles 
@@ -604,10 +590,8 @@ void Shape_PolygonFromSurfaces( TCollisionShape * shape, const TList * surfaces
             triangleNum++;
         }
     }
-    shape->octree.containIndexCount = 0;
-    shape->octree.root = 0;
-    // build octree 
-    Octree_Build( &shape->octree, shape->triangles, shape->triangleCount, 64 );
+    Bvh_Build( &shape->bvh, shape->triangles, shape->triangleCount );
+    Memory_PopTag();
 }
 
 void Dynamics_SphereSphereCollision( TBody * sphere1, TBody * sphere2 ) {
@@ -624,18 +608,18 @@ void Dynamics_SphereSphereCollision( TBody * sphere1, TBody * sphere2 ) {
         sphere1->linearVelocity = Plane_ProjectVector( sphere1->linearVelocity, direction );
         sphere2->linearVelocity = Plane_ProjectVector( sphere2->linearVelocity, direction );
         // fill contact information 
-        sphere1->contacts[ sphere1->contactCount ].body = sphere2;
-        sphere1->contacts[ sphere1->contactCount ].normal = direction;
-        sphere1->contacts[ sphere1->contactCount ].triangle = 0;
-        sphere1->contacts[ sphere1->contactCount ].position = middle;
         if( sphere1->contactCount < MAX_CONTACTS ) {
+            sphere1->contacts[ sphere1->contactCount ].body = sphere2;
+            sphere1->contacts[ sphere1->contactCount ].normal = direction;
+            sphere1->contacts[ sphere1->contactCount ].triangle = 0;
+            sphere1->contacts[ sphere1->contactCount ].position = middle;
             sphere1->contactCount++;
         }
-        sphere2->contacts[ sphere2->contactCount ].body = sphere1;
-        sphere2->contacts[ sphere2->contactCount ].normal = direction;
-        sphere2->contacts[ sphere2->contactCount ].triangle = 0;
-        sphere2->contacts[ sphere2->contactCount ].position = middle;
         if( sphere2->contactCount < MAX_CONTACTS ) {
+            sphere2->contacts[ sphere2->contactCount ].body = sphere1;
+            sphere2->contacts[ sphere2->contactCount ].normal = direction;
+            sphere2->contacts[ sphere2->contactCount ].triangle = 0;
+            sphere2->contacts[ sphere2->contactCount ].position = middle;
             sphere2->contactCount++;
         }
         if( g_dynamicsWorld.SphereSphereCollisionCallback ) {
@@ -658,45 +642,42 @@ TVec3 Plane_ProjectVector( TVec3 a, TVec3 planeNormal ) {
 void Dynamics_SpherePolygonCollision( TBody * sphere, TBody * polygon ) {
     TSphereShape sph = SphereShape_Set( sphere->position, sphere->shape->sphereRadius );
     // now find list of triangles that are close enough to our sphere 
-    Octree_GetContainIndex( &polygon->shape->octree, &sph );
-    int lastTriangleIndex = -1;
+    TBvhQuery query;
+    BvhQuery_Create( &query );
+    Bvh_QuerySphere( &polygon->shape->bvh, &sph, &query );
     // iterate over it and do collision detection 
-    for( int i = 0; i < polygon->shape->octree.containIndexCount; i++ ) {
-        TTriangle * triangle = polygon->shape->triangles + polygon->shape->octree.containIndices[i];
-        int currentTriangleIndex = polygon->shape->octree.containIndices[i];
-        // remove intersection check with duplicated triangle indices
-        if( currentTriangleIndex != lastTriangleIndex ) {
-            TVec3 intersectionPoint;
-            if( Intersection_SphereTriangle( &sph, triangle, &intersectionPoint) ) {
-                float length = 0.0f;
-                TVec3 middle = Vec3_Sub( sphere->position, intersectionPoint );
-                TVec3 direction = Vec3_NormalizeEx( middle, &length );
-                float penetrationDepth = sphere->shape->sphereRadius - length;
-                // degenerated case, ignore 
-                if( penetrationDepth < 0 ) continue;                
-                sphere->position = Vec3_Add( sphere->position, Vec3_Scale( direction, penetrationDepth ));
-                // perform sliding by projecting velocity vector on triangle plane 
-                sphere->linearVelocity = Plane_ProjectVector( sphere->linearVelocity, triangle->normal );
-                // write contact info 
-                if( sphere->contactCount < MAX_CONTACTS ) {
-                    sphere->contacts[ sphere->contactCount ].normal = direction;
-                    sphere->contacts[ sphere->contactCount ].triangle = triangle;
-                    sphere->contacts[ sphere->contactCount ].body = polygon;
-                    sphere->contacts[ sphere->contactCount ].position = intersectionPoint;
-                    sphere->contactCount++;
-                }
-                // contact count of polygon body can be exteremely high, so skip polygon's contact info 
-                if( polygon->contactCount < MAX_CONTACTS ) {
-                    polygon->contactCount++;
-                }
-                // use callback if defined 
-                if( g_dynamicsWorld.SphereTriangleCollisionCallback ) {
-                    g_dynamicsWorld.SphereTriangleCollisionCallback( sphere, polygon, triangle );
-                }
+    for( int i = 0; i < query.count; i++ ) {
+        TTriangle * triangle = polygon->shape->triangles + query.indices[i];
+        TVec3 intersectionPoint;
+        if( Intersection_SphereTriangle( &sph, triangle, &intersectionPoint) ) {
+            float length = 0.0f;
+            TVec3 middle = Vec3_Sub( sphere->position, intersectionPoint );
+            TVec3 direction = Vec3_NormalizeEx( middle, &length );
+            float penetrationDepth = sphere->shape->sphereRadius - length;
+            // degenerated case, ignore 
+            if( penetrationDepth < 0 ) continue;                
+            sphere->position = Vec3_Add( sphere->position, Vec3_Scale( direction, penetrationDepth ));
+            // perform sliding by projecting velocity vector on triangle plane 
+            sphere->linearVelocity = Plane_ProjectVector( sphere->linearVelocity, triangle->normal );
+            // write contact info 
+            if( sphere->contactCount < MAX_CONTACTS ) {
+                sphere->contacts[ sphere->contactCount ].normal = direction;
+                sphere->contacts[ sphere->contactCount ].triangle = triangle;
+                sphere->contacts[ sphere->contactCount ].body = polygon;
+                sphere->contacts[ sphere->contactCount ].position = intersectionPoint;
+                sphere->contactCount++;
+            }
+            // contact count of polygon body can be exteremely high, so skip polygon's contact info 
+            if( polygon->contactCount < MAX_CONTACTS ) {
+                polygon->contactCount++;
+            }
+            // use callback if defined 
+            if( g_dynamicsWorld.SphereTriangleCollisionCallback ) {
+                g_dynamicsWorld.SphereTriangleCollisionCallback( sphere, polygon, triangle );
             }
-            lastTriangleIndex = currentTriangleIndex;
         }
     }
+    BvhQuery_Free( &query );
 }
 
 void BoxShape_Set( TBoxShape * box, const TVec3 * min, const TVec3 * max, const TVec3 * position ) {
@@ -747,6 +728,29 @@ void Body_Create( TBody * body, TCollisionShape * shape ) {
     body->elasticity = 0.5f;
     body->linearVelocity = Vec3_Zero();
     body->position = Vec3_Zero();
+    body->spatialProxy = SPATIAL_NULL;
+}
+
+void Body_GetBounds( const TBody * body, TVec3 * min, TVec3 * max ) {
+    const TCollisionShape * shape = body->shape;
+    if( shape->capsule ) {
+        TVec3 a = Vec3_Add( shape->capsule->a, body->position );
+        TVec3 b = Vec3_Add( shape->capsule->b, body->position );
+        TVec3 extent = Vec3_Set( shape->capsule->radius, shape->capsule->radius, shape->capsule->radius );
+        *min = Vec3_Sub( Vec3_Set( fminf( a.x, b.x ), fminf( a.y, b.y ), fminf( a.z, b.z )), extent );
+        *max = Vec3_Add( Vec3_Set( fmaxf( a.x, b.x ), fmaxf( a.y, b.y ), fmaxf( a.z, b.z )), extent );
+    } else if( shape->type == SHAPE_SPHERE ) {
+        TVec3 extent = Vec3_Set( shape->sphereRadius, shape->sphereRadius, shape->sphereRadius );
+        *min = Vec3_Sub( body->position, extent );
+        *max = Vec3_Add( body->position, extent );
+    } else if( shape->type == SHAPE_POLYGON ) {
+        // polygon is static and has identity transform
+        *min = shape->min;
+        *max = shape->max;
+    } else {
+        *min = Vec3_Add( shape->min, body->position );
+        *max = Vec3_Add( shape->max, body->position );
+    }
 }
 
 void Body_ApplyGravity( TBody * body ) {
@@ -792,12 +796,22 @@ void Dynamics_CreateWorld() {
     g_dynamicsWorld.SphereTriangleCollisionCallback = NULL;    
     List_Create( &g_dynamicsWorld.bodies );
     List_Create( &g_dynamicsWorld.constraints );
+    SpatialTree_Create( &g_dynamicsWorld.bodyTree, DYNAMICS_BOUNDS_MARGIN );
 }
 
 void Dynamics_AddBody( TBody * body ) {
+    TVec3 min, max;
+    Body_GetBounds( body, &min, &max );
+    body->spatialProxy = SpatialTree_Insert( &g_dynamicsWorld.bodyTree, &min, &max, body );
     List_Add( &g_dynamicsWorld.bodies, body );
 }
 
+void Dynamics_RemoveBody( TBody * body ) {
+    SpatialTree_Remove( &g_dynamicsWorld.bodyTree, body->spatialProxy );
+    body->spatialProxy = SPATIAL_NULL;
+    List_Remove( &g_dynamicsWorld.bodies, body );
+}
+
 void Shape_CreateSphere( TCollisionShape * shape, float radius ) {
     shape->sphereRadius = radius;
     shape->type = SHAPE_SPHERE;
@@ -805,6 +819,40 @@ void Shape_CreateSphere( TCollisionShape * shape, float radius ) {
     shape->triangleCount = 0;
 }
 
+// narrowphase for a pair of bodies whose bounds overlap. collision pairs can be: sphere-sphere,
+// sphere-polygon, box-polygon and capsule-polygon; polygon-sphere is not supported, because
+// polygon must be static body, with identity transform
+static void Dynamics_CollidePair( TBody * body, TBody * otherBody ) {
+    if( body->shape->type == SHAPE_SPHERE ) {
+        if( otherBody->shape->type == SHAPE_SPHERE ) {
+            // sphere-sphere collision is symmetric, so each pair is resolved once
+            if( body->spatialProxy < otherBody->spatialProxy ) {
+                Dynamics_SphereSphereCollision( body, otherBody );
+            }
+        } else if( otherBody->shape->type == SHAPE_POLYGON ) {
+            Dynamics_SpherePolygonCollision( body, otherBody );
+        }
+    }
+    if( body->shape->type == SHAPE_AABB ) {
+        if( otherBody->shape->type == SHAPE_POLYGON ) {
+            Dynamics_BoxPolygonCollision( body, otherBody );
+        }
+    }
+    if( body->shape->capsule ) {
+        if( otherBody->shape->type == SHAPE_POLYGON ) {
+            Dynamics_CapsulePolygonCollision( body, otherBody );                        
+        }
+    }
+}
+
+static bool Dynamics_CollideCandidate( void * data, void * userData ) {
+    // prevent self-collision 
+    if( data != userData ) {
+        Dynamics_CollidePair( userData, data );
+    }
+    return true;
+}
+
 void Dynamics_StepSimulation() {
     // solve constraints first
     Dynamics_SolveConstraints( );
@@ -814,30 +862,167 @@ void Dynamics_StepSimulation() {
         Body_ApplyGravity( body );
         body->position = Vec3_Add( body->position, body->linearVelocity );
         body->contactCount = 0;        
-        // check collisions with each other world's body 
-        // collision pairs can be: sphere-sphere, sphere-polygon; polygon-sphere is not supported, 
-        // because polygon must be static body, with identity transform 
-        for_each( TBody, otherBody, g_dynamicsWorld.bodies ) {
-            // prevent self-collision 
-            if( otherBody != body ) {
-                if( body->shape->type == SHAPE_SPHERE ) {
-                    if( otherBody->shape->type == SHAPE_SPHERE ) {
-                        Dynamics_SphereSphereCollision( body, otherBody );
-                    } else if( otherBody->shape->type == SHAPE_POLYGON ) {
-                        Dynamics_SpherePolygonCollision( body, otherBody );
+        // refit bounds, most bodies stay inside of their enlarged bounds
+        TVec3 min, max;
+        Body_GetBounds( body, &min, &max );
+        SpatialTree_Move( &g_dynamicsWorld.bodyTree, body->spatialProxy, &min, &max );
+    }
+    // broadphase: each body is checked only against bodies whose bounds overlap its own
+    for_each( TBody, movedBody, g_dynamicsWorld.bodies ) {
+        // polygons are static and never collide as first body of a pair
+        if( movedBody->shape->type != SHAPE_POLYGON ) {
+            TVec3 min, max;
+            Body_GetBounds( movedBody, &min, &max );
+            SpatialTree_QueryAABB( &g_dynamicsWorld.bodyTree, &min, &max, Dynamics_CollideCandidate, movedBody );
+        }
+    }
+}
+
+#define TEST_BROADPHASE_SPHERE_RADIUS (0.5f)
+#define TEST_BROADPHASE_BODY_COUNT (1000)
+#define BENCHMARK_BROADPHASE_MAX_BODY_COUNT (10000)
+
+typedef struct TTestOverlapCount {
+    TBody * body;
+    int count;
+} TTestOverlapCount;
+
+static bool Test_CountOverlap( void * data, void * userData ) {
+    TTestOverlapCount * overlap = userData;
+    TBody * other = data;
+    if( other != overlap->body && other->spatialProxy > overlap->body->spatialProxy ) {
+        TSphereShape a = SphereShape_Set( overlap->body->position, overlap->body->shape->sphereRadius );
+        TSphereShape b = SphereShape_Set( other->position, other->shape->sphereRadius );
+        float depth;
+        if( Intersection_SphereSphere( &a, &b, &depth )) {
+            overlap->count++;
+        }
+    }
+    return true;
+}
+
+static void Test_PlaceBodies( TBody * bodies, int count, float size ) {
+    srand( count );
+    for( int i = 0; i < count; i++ ) {
+        bodies[i].position = Vec3_Set( size * ( rand() % 10000 ) / 10000.0f, size * ( rand() % 10000 ) / 10000.0f, size * ( rand() % 10000 ) / 10000.0f );
+        bodies[i].linearVelocity = Vec3_Zero();
+    }
+}
+
+// tests work in their own world, world of the game is saved here and restored afterwards
+static TDynamicsWorld gTestSavedWorld;
+
+// creates world of 'count' spheres of same density for every count, about 8 cubic units
+// per body. quarter more bodies is added and removed, so they must not take part in collision
+static TBody * Test_CreateBroadphaseWorld( TCollisionShape * shape, int count, float * size ) {
+    gTestSavedWorld = g_dynamicsWorld;
+    Shape_CreateSphere( shape, TEST_BROADPHASE_SPHERE_RADIUS );
+    Dynamics_CreateWorld();
+    int totalCount = count + count / 4;
+    TBody * bodies = Memory_NewCount( totalCount, TBody );
+    *size = cbrtf( 8.0f * count );
+    for( int i = 0; i < totalCount; i++ ) {
+        Body_Create( bodies + i, shape );
+    }
+    Test_PlaceBodies( bodies, totalCount, *size );
+    for( int i = 0; i < totalCount; i++ ) {
+        Dynamics_AddBody( bodies + i );
+    }
+    for( int i = count; i < totalCount; i++ ) {
+        Dynamics_RemoveBody( bodies + i );
+    }
+    return bodies;
+}
+
+static void Test_FreeBroadphaseWorld( TBody * bodies ) {
+    SpatialTree_Free( &g_dynamicsWorld.bodyTree );
+    List_Free( &g_dynamicsWorld.bodies );
+    List_Free( &g_dynamicsWorld.constraints );
+    Memory_Free( bodies );
+    g_dynamicsWorld = gTestSavedWorld;
+}
+
+// overlapping pairs reported by body tree
+static int Test_CountTreePairs( TBody * bodies, int count ) {
+    int pairs = 0;
+    for( int i = 0; i < count; i++ ) {
+        TTestOverlapCount overlap = { bodies + i, 0 };
+        TVec3 min, max;
+        Body_GetBounds( bodies + i, &min, &max );
+        SpatialTree_QueryAABB( &g_dynamicsWorld.bodyTree, &min, &max, Test_CountOverlap, &overlap );
+        pairs += overlap.count;
+    }
+    return pairs;
+}
+
+void Test_Broadphase( void ) {
+    TCollisionShape shape = { 0 };
+    float size;
+    TBody * bodies = Test_CreateBroadphaseWorld( &shape, TEST_BROADPHASE_BODY_COUNT, &size );
+    if( g_dynamicsWorld.bodyTree.leafCount != TEST_BROADPHASE_BODY_COUNT || g_dynamicsWorld.bodies.size != TEST_BROADPHASE_BODY_COUNT ) {
+        Util_RaiseError( "Test_Broadphase: body removal failed!" );
+    }
+    // broadphase must find every overlapping pair
+    int exactPairs = 0;
+    for( int i = 0; i < TEST_BROADPHASE_BODY_COUNT; i++ ) {
+        for( int j = i + 1; j < TEST_BROADPHASE_BODY_COUNT; j++ ) {
+            TSphereShape a = SphereShape_Set( bodies[i].position, TEST_BROADPHASE_SPHERE_RADIUS );
+            TSphereShape b = SphereShape_Set( bodies[j].position, TEST_BROADPHASE_SPHERE_RADIUS );
+            float depth;
+            exactPairs += Intersection_SphereSphere( &a, &b, &depth ) ? 1 : 0;
+        }
+    }
+    int foundPairs = Test_CountTreePairs( bodies, TEST_BROADPHASE_BODY_COUNT );
+    if( foundPairs != exactPairs ) {
+        Util_RaiseError( "Test_Broadphase: found %d pairs of %d!", foundPairs, exactPairs );
+    }
+    Dynamics_StepSimulation();
+    Test_FreeBroadphaseWorld( bodies );
+}
+
+void Benchmark_Broadphase( void ) {
+    for( int count = 10; count <= BENCHMARK_BROADPHASE_MAX_BODY_COUNT; count *= 10 ) {
+        TCollisionShape shape = { 0 };
+        float size;
+        TBody * bodies = Test_CreateBroadphaseWorld( &shape, count, &size );
+        int pairs = Test_CountTreePairs( bodies, count );
+        // previous path: each body against each other body, sphere-sphere pairs are resolved twice
+        TTimer timer;
+        Timer_Create( &timer );
+        for_each( TBody, body, g_dynamicsWorld.bodies ) {
+            Body_ApplyGravity( body );
+            body->position = Vec3_Add( body->position, body->linearVelocity );
+            body->contactCount = 0;
+            for_each( TBody, otherBody, g_dynamicsWorld.bodies ) {
+                if( otherBody != body ) {
+                    if( body->shape->type == SHAPE_SPHERE ) {
+                        if( otherBody->shape->type == SHAPE_SPHERE ) {
+                            Dynamics_SphereSphereCollision( body, otherBody );
+                        } else if( otherBody->shape->type == SHAPE_POLYGON ) {
+                            Dynamics_SpherePolygonCollision( body, otherBody );
+                        }
                     }
-                }
-                if( body->shape->type == SHAPE_AABB ) {
-                    if( otherBody->shape->type == SHAPE_POLYGON ) {
-                        Dynamics_BoxPolygonCollision( body, otherBody );
+                    if( body->shape->type == SHAPE_AABB ) {
+                        if( otherBody->shape->type == SHAPE_POLYGON ) {
+                            Dynamics_BoxPolygonCollision( body, otherBody );
+                        }
                     }
-                }
-                if( body->shape->capsule ) {
-                    if( otherBody->shape->type == SHAPE_POLYGON ) {
-                        Dynamics_CapsulePolygonCollision( body, otherBody );                        
+                    if( body->shape->capsule ) {
+                        if( otherBody->shape->type == SHAPE_POLYGON ) {
+                            Dynamics_CapsulePolygonCollision( body, otherBody );
+                        }
                     }
                 }
             }
         }
+        double bruteTime = Timer_GetElapsedMilliseconds( &timer );
+        // first step reinserts all bodies, which were teleported, second one is measured
+        Test_PlaceBodies( bodies, count, size );
+        Dynamics_StepSimulation();
+        Timer_Restart( &timer );
+        Dynamics_StepSimulation();
+        double broadphaseTime = Timer_GetElapsedMilliseconds( &timer );
+        printf( "Broadphase: %d bodies, %d pairs: all pairs %.3f ms, broadphase %.3f ms\n", count, pairs, bruteTime, broadphaseTime );
+        Test_FreeBroadphaseWorld( bodies );
     }
-}
\ No newline at end of file
+}
@@ -5,7 +5,8 @@
 #include "Vector3.h"
 #include "surface.h"
 #include "list.h"
-#include "octree.h"
+#include "bvh.h"
+#include "spatial.h"
 
 OLDTECH_BEGIN_HEADER
 
@@ -13,6 +14,7 @@ typedef struct TRay {
     TVec3 begin;
     TVec3 end;
     TVec3 dir;
+    TVec3 invDir; // 1 / dir, for slab tests
 } TRay;
 
 typedef enum ERayType {
@@ -84,7 +86,7 @@ typedef struct TCollisionShape {
     EShapeType type;
     // polygon shape 
     TTriangle * triangles;
-    TOctree octree;
+    TBvh bvh;
     int triangleCount;
     // sphere 
     float sphereRadius;
@@ -110,11 +112,13 @@ typedef struct TBody {
     int contactCount;
     TContact contacts[ MAX_CONTACTS ];
     float elasticity;
+    int spatialProxy; // proxy in body tree of the world
 } TBody;
 
 typedef struct TDynamicsWorld {
     TList bodies;
     TList constraints;
+    TSpatialTree bodyTree; // bounds of all bodies, refitted each step
     void (*SphereSphereCollisionCallback)( TBody * sph1, TBody * sph2 );
     void (*SphereTriangleCollisionCallback)( TBody * sph1, TBody * polygon, TTriangle * triangle );
 } TDynamicsWorld;
@@ -148,13 +152,13 @@ bool Intersection_EdgeSphere( const TRay * edgeRay, const TSphereShape * sphere,
 
 TRay Ray_Set( TVec3 begin, TVec3 end );
 TRay Ray_SetDirection( TVec3 begin, TVec3 direction );
+// static and occlusion queries keep their state on stack, so they can be called from any thread
 void Ray_TraceWorldStatic( TRay * ray, TRayTraceResult * out );
-// traces ray only through dynamic object, such as spheres and boxes
+// checks if static geometry blocks part of segment in [tmin, tmax), stops on first hit,
+// so it is cheaper than Ray_TraceWorldStatic when only yes or no is needed
+bool Ray_Occluded( const TRay * ray, float tmin, float tmax );
+// traces ray segment only through dynamic object, such as spheres and boxes, returns closest hit
 void Ray_TraceWorldDynamic( TRay * ray, TRayTraceResult * out ); 
-// special multithreaded version, mostly used in lightmap generation
-// threadNum can be 0 to 4, keep in mind that this function traces ray
-// only through static geometry
-void Ray_TraceWorldStaticMultithreaded( TRay * ray, TRayTraceResult * out, int threadNum );
 
 TVec3 Geometry_ProjectPointOnLine( TVec3 point, TVec3 a, TVec3 b );
 bool Geometry_PointOnLineSegment( TVec3 * point, const TVec3 * a, const TVec3 * b );
@@ -197,6 +201,7 @@ void Dynamics_CapsulePolygonCollision( TBody * capsuleBody, TBody * polygon );
 void Dynamics_BoxPolygonCollision( TBody * box, TBody * polygon );
 void Dynamics_CreateWorld( void );
 void Dynamics_AddBody( TBody * body );
+void Dynamics_RemoveBody( TBody * body );
 void Dynamics_StepSimulation( void );
 void Dynamics_SolveConstraints( void );
 
@@ -206,8 +211,14 @@ void Shape_CreateSphere( TCollisionShape * shape, float radius );
 void Shape_BoxFromSurfaces( TCollisionShape * shape, const TList * surfaces );
 
 void Body_Create( TBody * body, TCollisionShape * shape );
+void Body_GetBounds( const TBody * body, TVec3 * min, TVec3 * max );
 void Body_ApplyGravity( TBody * body );
 
+// tests
+void Test_Broadphase( void );
+// prints time of simulation step against collision of each body with every other one
+void Benchmark_Broadphase( void );
+
 OLDTECH_END_HEADER
 
 #endif
\ No newline at end of file
@@ -5,6 +5,11 @@
 #   define _DEBUG_GL_
 #endif
 
+// SSE is used by math kernels when compiler targets it, scalar code is used otherwise
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#   define OLDTECH_SSE
+#endif
+
 #ifdef _cplusplus
 #   define OLDTECH_BEGIN_HEADER extern "C" {
 #   define OLDTECH_END_HEADER   }
@@ -24,7 +29,9 @@ OLDTECH_BEGIN_HEADER
 #include <locale.h>
 
 #include "memory.h"
+#include "scratch.h"
 #include "str.h"
+#include "atom.h"
 #include "utils.h"
 #include "log.h"
 #include "crc32.h"
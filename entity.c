@@ -4,12 +4,131 @@
 #include "buffer.h"
 #include "billboard.h"
 #include "lightmap.h"
+#include "transform.h"
+#include "pool.h"
+#include "jobs.h"
+#include "animator.h"
+#include "timer.h"
 
-TList g_entities = { NULL, NULL, 0 };
-int gEntityCounter = 0;
+TEntity ** g_entities = NULL;
+int g_entityCount = 0;
+int gEntityCapacity = 0;
+// entities are placed in pool, so pointers to them are stable
+TPool gEntityPool = POOL_INITIALIZER( TEntity, 256, false );
+// slot map, generation of slot is incremented when its entity is freed, so
+// stale handles are detected without search
+typedef struct TEntitySlot {
+    TEntity * entity;
+    unsigned int generation;
+    int nextFree;
+} TEntitySlot;
+TEntitySlot * gEntitySlots = NULL;
+int gEntitySlotCount = 0;
+int gEntitySlotCapacity = 0;
+int gEntityFreeSlot = -1;
+// all entities sorted by depth, so parent is always updated before its childs
+TEntity ** gTransformOrder = NULL;
+int gTransformOrderCount = 0;
+int gTransformOrderCapacity = 0;
+// freed entities leave NULL in the order until it is rebuilt
+int gTransformOrderHoles = 0;
+bool gTransformOrderValid = false;
+// local and global transforms of entities in same order
+TTransformArray gTransforms;
+// skinned surfaces of last update, skinned by workers until World_WaitAnimation
+TSurface ** gSkinQueue = NULL;
+int gSkinQueueCount = 0;
+int gSkinQueueCapacity = 0;
+TJobBatch gSkinBatch = JOB_BATCH_INITIALIZER;
+// animation LOD, skinned entities are skinned less often and with less bones when far
+// from camera, and not skinned at all when invisible
+#define ANIMATION_LOD_NEAR_DISTANCE (20.0f)
+#define ANIMATION_LOD_FAR_DISTANCE (50.0f)
+// skinned vertices can leave bounds of bind pose
+#define ANIMATION_LOD_BOUNDS_SCALE (1.5f)
+#define ANIMATION_LOD_INVISIBLE (-1)
+static const int gAnimationLodInterval[] = { 1, 2, 4 };
+static const int gAnimationLodInfluences[] = { SKIN_BONES_PER_VERTEX, SKIN_BONES_PER_VERTEX, 1 };
+unsigned int gAnimationTick = 0;
+TAnimationStats gAnimationStats;
+
+static void Entity_Register( TEntity * ent ) {
+    // take slot
+    if( gEntityFreeSlot < 0 ) {
+        if( gEntitySlotCount >= gEntitySlotCapacity ) {
+            gEntitySlotCapacity = gEntitySlotCapacity ? gEntitySlotCapacity * 2 : 256;
+            gEntitySlots = Memory_Reallocate( gEntitySlots, gEntitySlotCapacity * sizeof( TEntitySlot ));
+        }
+        gEntitySlots[ gEntitySlotCount ].generation = 1;
+        gEntitySlots[ gEntitySlotCount ].nextFree = -1;
+        gEntityFreeSlot = gEntitySlotCount++;
+    }
+    ent->slot = gEntityFreeSlot;
+    gEntityFreeSlot = gEntitySlots[ ent->slot ].nextFree;
+    ent->skinInvalid = true;
+    gEntitySlots[ ent->slot ].entity = ent;
+    // add to dense array
+    if( g_entityCount >= gEntityCapacity ) {
+        gEntityCapacity = gEntityCapacity ? gEntityCapacity * 2 : 256;
+        g_entities = Memory_Reallocate( g_entities, gEntityCapacity * sizeof( TEntity * ));
+    }
+    ent->denseIndex = g_entityCount;
+    g_entities[ g_entityCount++ ] = ent;
+    // new entity has no parent, so it can be placed at the end of transform order
+    if( gTransformOrderValid ) {
+        if( gTransformOrderCount >= gTransformOrderCapacity ) {
+            gTransformOrderCapacity = gTransformOrderCapacity ? gTransformOrderCapacity * 2 : 256;
+            gTransformOrder = Memory_Reallocate( gTransformOrder, gTransformOrderCapacity * sizeof( TEntity * ));
+        }
+        ent->depth = 0;
+        ent->transformIndex = gTransformOrderCount;
+        gTransformOrder[ gTransformOrderCount++ ] = ent;
+        TransformArray_Resize( &gTransforms, gTransformOrderCount );
+        gTransforms.parent[ ent->transformIndex ] = -1;
+    }
+}
+
+static void Entity_Unregister( TEntity * ent ) {
+    // move last entity to the place of removed one
+    TEntity * last = g_entities[ --g_entityCount ];
+    g_entities[ ent->denseIndex ] = last;
+    last->denseIndex = ent->denseIndex;
+    // invalidate handles
+    TEntitySlot * slot = gEntitySlots + ent->slot;
+    slot->entity = NULL;
+    slot->generation++;
+    slot->nextFree = gEntityFreeSlot;
+    gEntityFreeSlot = ent->slot;
+    if( gTransformOrderValid ) {
+        gTransformOrder[ ent->transformIndex ] = NULL;
+        gTransformOrderHoles++;
+        // rebuild order when it is mostly holes
+        if( gTransformOrderHoles > 256 && gTransformOrderHoles > g_entityCount ) {
+            gTransformOrderValid = false;
+        }
+    }
+}
+
+TEntityHandle Entity_GetHandle( TEntity * ent ) {
+    TEntityHandle handle = { ent->slot, gEntitySlots[ ent->slot ].generation };
+    return handle;
+}
+
+TEntity * Entity_FromHandle( TEntityHandle handle ) {
+    if( handle.index < 0 || handle.index >= gEntitySlotCount ) {
+        return NULL;
+    }
+    TEntitySlot * slot = gEntitySlots + handle.index;
+    return slot->generation == handle.generation ? slot->entity : NULL;
+}
+
+bool Entity_IsAlive( TEntityHandle handle ) {
+    return Entity_FromHandle( handle ) != NULL;
+}
 
 TEntity * Entity_Create( ) {
-    TEntity * ent = Memory_New( TEntity );
+    Memory_PushTag( MEMORY_TAG_ENTITY );
+    TEntity * ent = Pool_New( &gEntityPool, TEntity );
     ent->localPosition = Vec3_Set( 0.0f, 0.0f, 0.0f );
 	ent->localScale = Vec3_Set( 1.0f, 1.0f, 1.0f );
     ent->globalPosition = Vec3_Set( 0.0f, 0.0f, 0.0f );
@@ -23,97 +142,293 @@ TEntity * Entity_Create( ) {
     ent->globalTransform = Matrix4_Identity();
     ent->localTransform = Matrix4_Identity();
     ent->invBindTransform = Matrix4_Identity();
+    ent->renderTransform = Matrix4_Identity();
     List_Create( &ent->surfaces );
-    List_Create( &ent->childs );
-    List_Create( &ent->keyFrames );
+    HashMap_Create( &ent->childIndex );
+    ent->track = NULL;
     List_Create( &ent->allSurfaces );
     ent->skinned = false;
     ent->dynBody = NULL;
     ent->totalFrames = 0;
     ent->componentLight = NULL;
-    ent->anim = NULL;
 	ent->depthHack = 0.0f;
     ent->instanceOf = NULL;
     ent->alpha = 1.0f;
     ent->sourceCRC32 = 0; // computed when entity loading from file
-    ent->name = String_Format( "UnnamedEntity%d", gEntityCounter++ );
-    List_Add( &g_entities, ent );
+    ent->name = Atom_Intern( "Unnamed" );
+    Entity_Register( ent );
+    Memory_PopTag();
     return ent;
 }
 
-TEntity * Entity_CreateInstance( TEntity * source ) {
-    TEntity * ent = Memory_New( TEntity );
-    ent->localPosition = source->localPosition;
-    ent->localRotation = source->localRotation;
-	ent->localScale = source->localScale;
-    ent->parent = NULL;
-    ent->visible = true;
-    ent->alpha = source->alpha;
-	ent->globalTransformCalculated = false;
-	ent->depthHack = source->depthHack;
-    ent->animated = source->animated;
-    ent->globalTransform = source->globalTransform;
-    ent->localTransform = source->localTransform;
-    ent->invBindTransform = source->invBindTransform;
-    ent->color = source->color;
-    ent->sourceCRC32 = source->sourceCRC32;
-    for_each( TSurface, surf, source->allSurfaces ) {
-        List_Add( &ent->allSurfaces, surf );
+//=================
+// Prefabs
+//=================
+// memory block of prefab instance: header, nodes, lights, billboards
+typedef struct TPrefabInstance {
+    TPrefab * prefab;
+    int aliveCount; // block is freed when last of its nodes is freed
+} TPrefabInstance;
+
+#define PREFAB_ALIGN( size ) ((( size ) + 15 ) & ~15 )
+#define PREFAB_INSTANCES_PER_PAGE (8)
+
+static int Prefab_CountNodes( TEntity * ent ) {
+    int count = 1;
+    for( TEntity * child = ent->firstChild; child; child = child->nextSibling ) {
+        count += Prefab_CountNodes( child );
     }
-    // copy pointers to surfaces, surfaces can be shared
-    List_Create( &ent->surfaces );
+    return count;
+}
+
+static TEntity * Prefab_AddNode( TPrefab * prefab, TEntity * source, TEntity * parent ) {
+    TEntity * node = prefab->nodes + prefab->nodeCount++;
+    node->localPosition = source->localPosition;
+    node->localRotation = source->localRotation;
+    node->localScale = source->localScale;
+    node->visible = true;
+    node->alpha = source->alpha;
+    node->depthHack = source->depthHack;
+    node->animated = source->animated;
+    node->globalTransform = source->globalTransform;
+    node->localTransform = source->localTransform;
+    node->invBindTransform = source->invBindTransform;
+    node->color = source->color;
+    node->sourceCRC32 = source->sourceCRC32;
+    node->skinned = source->skinned;
+    // todo: fix body copying
+    node->dynBody = source->dynBody;
+    node->totalFrames = source->totalFrames;
+    node->instanceOf = source;
+    node->name = source->name;
+    node->componentCamera = source->componentCamera;
+    // shared data, prefab holds a reference to it
+    node->track = AnimationTrack_Share( source->track );
+    node->sharedSurfaces = true;
+    List_Create( &node->surfaces );
     for_each( TSurface, surface, source->surfaces ) {
         surface->shareCount++;
-        List_Add( &ent->surfaces, surface );
+        List_Add( &node->surfaces, surface );
     }
-    // instantiate childs
-    List_Create( &ent->childs );
-    for_each( TEntity, sourceChild, source->childs ) {
-        TEntity * child = Entity_CreateInstance( sourceChild );
-        List_Add( &ent->childs, child );
-        child->parent = ent;
-    }
-    // copy keyframes
-    List_Create( &ent->keyFrames );
-    for_each( TKeyFrame, sourceKF, source->keyFrames ) {
-        TKeyFrame * kf = Memory_New( TKeyFrame );
-        memcpy( kf, sourceKF, sizeof( TKeyFrame ));
-        List_Add( &ent->keyFrames, kf );
+    List_Create( &node->allSurfaces );
+    for_each( TSurface, surf, source->allSurfaces ) {
+        List_Add( &node->allSurfaces, surf );
     }
-    ent->skinned = source->skinned;
-    // todo: fix body copying
-    ent->dynBody = source->dynBody;
-    ent->totalFrames = source->totalFrames;
-    ent->anim = source->anim;
-    ent->instanceOf = source;    
-    ent->name = String_Duplicate( source->name );
-    List_Add( &g_entities, ent );
-
+    // components are cloned by each instance
     if( source->componentLight ) {
-        ent->componentLight = Memory_New( TLight );
-        (*ent->componentLight) = (*source->componentLight);
-        ent->componentLight->owner = ent;
-        List_Create( &ent->componentLight->affectedAtlasList );
-    } else {
-        ent->componentLight = NULL;
+        node->componentLight = Memory_New( TLight );
+        (*node->componentLight) = (*source->componentLight);
+        prefab->lightCount++;
     }
-    
     if( source->componentBillboard ) {
-        ent->componentBillboard = Memory_New( TBillboard );
-        (*ent->componentBillboard) = (*source->componentBillboard);
-        ent->componentBillboard->owner = ent;
+        node->componentBillboard = Memory_New( TBillboard );
+        (*node->componentBillboard) = (*source->componentBillboard);
+        prefab->billboardCount++;
+    }
+    // links between templates, instance translates them to its own nodes, child index
+    // is shared and translated on search
+    HashMap_Create( &node->childIndex );
+    node->sharedChildIndex = true;
+    if( parent ) {
+        node->parent = parent;
+        node->prevSibling = parent->lastChild;
+        if( parent->lastChild ) {
+            parent->lastChild->nextSibling = node;
+        } else {
+            parent->firstChild = node;
+        }
+        parent->lastChild = node;
+        parent->childCount++;
+        if( !HashMap_Find( &parent->childIndex, node->name )) {
+            HashMap_Insert( &parent->childIndex, node->name, node );
+        }
+    }
+    for( TEntity * sourceChild = source->firstChild; sourceChild; sourceChild = sourceChild->nextSibling ) {
+        Prefab_AddNode( prefab, sourceChild, node );
+    }
+    return node;
+}
+
+static TPrefab * Prefab_Build( TEntity * source, bool pooled ) {
+    Memory_PushTag( MEMORY_TAG_ENTITY );
+    TPrefab * prefab = Memory_New( TPrefab );
+    prefab->nodes = Memory_NewCount( Prefab_CountNodes( source ), TEntity );
+    prefab->refCount = 1;
+    Prefab_AddNode( prefab, source, NULL );
+    // instance is header, nodes, lights and billboards
+    prefab->instanceSize = PREFAB_ALIGN( sizeof( TPrefabInstance )) + PREFAB_ALIGN( prefab->nodeCount * sizeof( TEntity )) +
+        PREFAB_ALIGN( prefab->lightCount * sizeof( TLight )) + PREFAB_ALIGN( prefab->billboardCount * sizeof( TBillboard ));
+    prefab->pooled = pooled;
+    if( pooled ) {
+        Pool_Create( &prefab->instancePool, prefab->instanceSize, PREFAB_INSTANCES_PER_PAGE, false );
+    }
+    Memory_PopTag();
+    return prefab;
+}
+
+TPrefab * Prefab_Create( TEntity * source ) {
+    return Prefab_Build( source, true );
+}
+
+void Prefab_Release( TPrefab * prefab ) {
+    prefab->refCount--;
+    if( prefab->refCount > 0 ) {
+        return;
+    }
+    for( int i = 0; i < prefab->nodeCount; i++ ) {
+        TEntity * node = prefab->nodes + i;
+        for_each( TSurface, surface, node->surfaces ) {
+            surface->shareCount--;
+            if( surface->shareCount <= 0 ) {
+                Surface_Free( surface );
+            }
+        }
+        List_Free( &node->surfaces );
+        List_Free( &node->allSurfaces );
+        HashMap_Free( &node->childIndex );
+        AnimationTrack_Release( node->track );
+        if( node->componentLight ) {
+            Memory_Free( node->componentLight );
+        }
+        if( node->componentBillboard ) {
+            Memory_Free( node->componentBillboard );
+        }
+    }
+    if( prefab->pooled ) {
+        Pool_Free( &prefab->instancePool );
+    }
+    Memory_Free( prefab->nodes );
+    Memory_Free( prefab );
+}
+
+// translates pointer to template into pointer to node of instance
+static TEntity * Prefab_Relocate( TPrefab * prefab, TEntity * nodes, TEntity * templateNode ) {
+    return templateNode ? nodes + ( templateNode - prefab->nodes ) : NULL;
+}
+
+static TEntity * Prefab_GetInstanceNodes( TPrefabInstance * instance ) {
+    return (TEntity*)((char*)instance + PREFAB_ALIGN( sizeof( TPrefabInstance )));
+}
+
+TEntity * Prefab_Instantiate( TPrefab * prefab ) {
+    Memory_PushTag( MEMORY_TAG_ENTITY );
+    // one block for all nodes and their components, pool reuses blocks of freed instances
+    int headerSize = PREFAB_ALIGN( sizeof( TPrefabInstance ));
+    int nodesSize = PREFAB_ALIGN( prefab->nodeCount * sizeof( TEntity ));
+    int lightsSize = PREFAB_ALIGN( prefab->lightCount * sizeof( TLight ));
+    char * block = prefab->pooled ? Pool_Allocate( &prefab->instancePool ) : Memory_Allocate( prefab->instanceSize );
+    TPrefabInstance * instance = (TPrefabInstance*)block;
+    TEntity * nodes = Prefab_GetInstanceNodes( instance );
+    TLight * light = (TLight*)( block + headerSize + nodesSize );
+    TBillboard * billboard = (TBillboard*)( block + headerSize + nodesSize + lightsSize );
+    instance->prefab = prefab;
+    instance->aliveCount = prefab->nodeCount;
+    prefab->refCount++;
+    memcpy( nodes, prefab->nodes, prefab->nodeCount * sizeof( TEntity ));
+    for( int i = 0; i < prefab->nodeCount; i++ ) {
+        TEntity * ent = nodes + i;
+        ent->prefabInstance = instance;
+        ent->parent = Prefab_Relocate( prefab, nodes, ent->parent );
+        ent->firstChild = Prefab_Relocate( prefab, nodes, ent->firstChild );
+        ent->lastChild = Prefab_Relocate( prefab, nodes, ent->lastChild );
+        ent->prevSibling = Prefab_Relocate( prefab, nodes, ent->prevSibling );
+        ent->nextSibling = Prefab_Relocate( prefab, nodes, ent->nextSibling );
+        if( ent->componentLight ) {
+            *light = *ent->componentLight;
+            light->owner = ent;
+            List_Create( &light->affectedAtlasList );
+            light->spatialProxy = SPATIAL_NULL;
+            ent->componentLight = light++;
+        }
+        if( ent->componentBillboard ) {
+            *billboard = *ent->componentBillboard;
+            billboard->owner = ent;
+            ent->componentBillboard = billboard++;
+        }
+        // parent is registered before, so order stays valid
+        Entity_Register( ent );
+        if( gTransformOrderValid && ent->parent ) {
+            gTransforms.parent[ ent->transformIndex ] = ent->parent->transformIndex;
+        }
+    }
+    Memory_PopTag();
+    return nodes;
+}
+
+// frees memory of the entity, but not its contents
+static void Entity_ReleaseMemory( TEntity * ent ) {
+    TPrefabInstance * instance = ent->prefabInstance;
+    if( instance ) {
+        instance->aliveCount--;
+        if( instance->aliveCount <= 0 ) {
+            TPrefab * prefab = instance->prefab;
+            if( prefab->pooled ) {
+                Pool_Release( &prefab->instancePool, instance );
+            } else {
+                Memory_Free( instance );
+            }
+            Prefab_Release( prefab );
+        }
     } else {
-        ent->componentBillboard = NULL;
+        Pool_Release( &gEntityPool, ent );
     }
-    
-    ent->componentCamera = source->componentCamera;
+}
+
+// makes own copies of surface lists of prefab instance before modification
+static void Entity_UnshareSurfaces( TEntity * ent ) {
+    if( ent->sharedSurfaces ) {
+        TList surfaces = ent->surfaces;
+        TList allSurfaces = ent->allSurfaces;
+        List_Create( &ent->surfaces );
+        for_each( TSurface, surface, surfaces ) {
+            surface->shareCount++;
+            List_Add( &ent->surfaces, surface );
+        }
+        List_Create( &ent->allSurfaces );
+        for_each( TSurface, surf, allSurfaces ) {
+            List_Add( &ent->allSurfaces, surf );
+        }
+        ent->sharedSurfaces = false;
+    }
+}
+
+// search in child index, which can be shared with prefab
+static TEntity * Entity_FindIndexedChild( TEntity * ent, const char * name ) {
+    TEntity * child = HashMap_Find( &ent->childIndex, name );
+    if( child && ent->sharedChildIndex ) {
+        TPrefabInstance * instance = ent->prefabInstance;
+        child = Prefab_Relocate( instance->prefab, Prefab_GetInstanceNodes( instance ), child );
+    }
+    return child;
+}
+
+// makes own copy of child index of prefab instance before modification
+static void Entity_UnshareChildIndex( TEntity * ent ) {
+    if( ent->sharedChildIndex ) {
+        TPrefabInstance * instance = ent->prefabInstance;
+        TEntity * nodes = Prefab_GetInstanceNodes( instance );
+        THashMap childIndex = ent->childIndex;
+        HashMap_Copy( &ent->childIndex, &childIndex );
+        for( int i = 0; i < ent->childIndex.capacity; i++ ) {
+            THashMapEntry * entry = ent->childIndex.entries + i;
+            entry->value = Prefab_Relocate( instance->prefab, nodes, entry->value );
+        }
+        ent->sharedChildIndex = false;
+    }
+}
+
+TEntity * Entity_CreateInstance( TEntity * source ) {
+    // prefab lives while the instance is alive, single instance doesn't need a pool
+    TPrefab * prefab = Prefab_Build( source, false );
+    TEntity * ent = Prefab_Instantiate( prefab );
+    Prefab_Release( prefab );
     return ent;
 }
 
 void Entity_SetColor( TEntity * ent, const TVec3 * color, bool affectChilds ) {
     ent->color = *color;
     if( affectChilds ) {
-        for_each( TEntity, child, ent->childs ) {
+        for( TEntity * child = ent->firstChild; child; child = child->nextSibling ) {
             Entity_SetColor( child, color, affectChilds );
         }
     }
@@ -121,53 +436,90 @@ void Entity_SetColor( TEntity * ent, const TVec3 * color, bool affectChilds ) {
 
 void Entity_SetDepthHack( TEntity * ent, float depthHack ) {
     ent->depthHack = depthHack;
-    for_each( TEntity, child, ent->childs ) {
+    for( TEntity * child = ent->firstChild; child; child = child->nextSibling ) {
         Entity_SetDepthHack( child, depthHack );
     }
 }
 
-void Entity_Free( TEntity * ent ) {
-    String_Free( ent->name );    
-    for_each( TEntity, entity, g_entities ) {
-        // if this entity is a child of other entity, remove it from child list
-        for_each( TEntity, child, entity->childs ) {
-            if( child == ent ) {
-                List_Remove( &entity->childs, ent );
+// must be called after 'child' removed from child list of 'ent'
+static void Entity_UnindexChild( TEntity * ent, TEntity * child ) {
+    if( Entity_FindIndexedChild( ent, child->name ) == child ) {
+        Entity_UnshareChildIndex( ent );
+        HashMap_Remove( &ent->childIndex, child->name );
+        // other child can have same name
+        for( TEntity * other = ent->firstChild; other; other = other->nextSibling ) {
+            if( other->name == child->name ) {
+                HashMap_Insert( &ent->childIndex, other->name, other );
                 break;
             }
         }
-        // if this entity is parent for other entity, orphan it
-        if( entity->parent == ent ) {
-            entity->parent = NULL;
-        }
     }
+}
+
+// hierarchy below 'ent' and its ancestors changed, so their descendant indices are stale
+static void Entity_DropDescendantIndex( TEntity * ent ) {
+    for( ; ent; ent = ent->parent ) {
+        HashMap_Free( &ent->descendantIndex );
+    }
+}
+
+static void Entity_Detach( TEntity * ent ) {
+    TEntity * parent = ent->parent;
+    if( !parent ) {
+        return;
+    }
+    Entity_DropDescendantIndex( parent );
+    if( ent->prevSibling ) {
+        ent->prevSibling->nextSibling = ent->nextSibling;
+    } else {
+        parent->firstChild = ent->nextSibling;
+    }
+    if( ent->nextSibling ) {
+        ent->nextSibling->prevSibling = ent->prevSibling;
+    } else {
+        parent->lastChild = ent->prevSibling;
+    }
+    ent->prevSibling = NULL;
+    ent->nextSibling = NULL;
+    ent->parent = NULL;
+    parent->childCount--;
+    Entity_UnindexChild( parent, ent );
+}
+
+void Entity_Free( TEntity * ent ) {
+    // surfaces of entity can be skinned by workers right now
+    World_WaitAnimation();
+    Entity_Detach( ent );
+    // index isn't needed anymore, so detaching childs won't copy index shared with prefab
+    if( !ent->sharedChildIndex ) {
+        HashMap_Free( &ent->childIndex );
+    }
+    HashMap_Create( &ent->childIndex );
+    ent->sharedChildIndex = false;
+    HashMap_Free( &ent->descendantIndex );
+    // free childs, each child detaches itself
+    while( ent->firstChild ) {
+        Entity_Free( ent->firstChild );
+    }
+    Entity_Unregister( ent );
     
-    List_Remove( &g_entities, ent );
-    
-    // free surfaces
-    if( !ent->instanceOf ) {
+    // free surfaces, shared lists are freed by prefab
+    if( !ent->sharedSurfaces ) {
         for_each( TSurface, surface, ent->surfaces ) {
             surface->shareCount--;
             if( surface->shareCount <= 0 ) {
                 Surface_Free( surface );
             }
         }
+        List_Free( &ent->surfaces );
     }
-    List_Free( &ent->surfaces );
-
-    // free keyframes
-    for_each( TKeyFrame, kf, ent->keyFrames ) {
-        Memory_Free( kf );
-    }
-    List_Free( &ent->keyFrames );
 
-    // free childs
-    for_each( TEntity, child, ent->childs ) {
-        Entity_Free( child );
+    // prefab holds reference to track of its instances
+    if( !ent->prefabInstance ) {
+        AnimationTrack_Release( ent->track );
     }
-    List_Free( &ent->childs );
 
-    Memory_Free( ent );
+    Entity_ReleaseMemory( ent );
 }
 
 TBillboard * Entity_MakeBillboard( TEntity * ent ) {    
@@ -187,10 +539,51 @@ void Entity_GetGlobalRotation( TEntity * ent, TQuaternion * globRot ) {
 }
 
 void Entity_FreeAll() {
-    List_Clear( &g_entities, 1 );
+    World_WaitAnimation();
+    JobBatch_Free( &gSkinBatch );
+    if( gSkinQueue ) {
+        Memory_Free( gSkinQueue );
+    }
+    gSkinQueue = NULL;
+    gSkinQueueCount = 0;
+    gSkinQueueCapacity = 0;
+    for( int i = 0; i < g_entityCount; i++ ) {
+        if( !g_entities[i]->sharedChildIndex ) {
+            HashMap_Free( &g_entities[i]->childIndex );
+        }
+        HashMap_Free( &g_entities[i]->descendantIndex );
+        // entities from pool are freed all at once
+        if( g_entities[i]->prefabInstance ) {
+            Entity_ReleaseMemory( g_entities[i] );
+        }
+    }
+    Pool_Free( &gEntityPool );
+    if( g_entities ) {
+        Memory_Free( g_entities );
+    }
+    g_entities = NULL;
+    g_entityCount = 0;
+    gEntityCapacity = 0;
+    if( gEntitySlots ) {
+        Memory_Free( gEntitySlots );
+    }
+    gEntitySlots = NULL;
+    gEntitySlotCount = 0;
+    gEntitySlotCapacity = 0;
+    gEntityFreeSlot = -1;
+    if( gTransformOrder ) {
+        Memory_Free( gTransformOrder );
+    }
+    gTransformOrder = NULL;
+    gTransformOrderCount = 0;
+    gTransformOrderCapacity = 0;
+    gTransformOrderHoles = 0;
+    gTransformOrderValid = false;
+    TransformArray_Free( &gTransforms );
 }
 
 void Entity_AddSurface( TEntity * ent, TSurface * surf ) {
+    Entity_UnshareSurfaces( ent );
     List_Add( &ent->surfaces, surf );
 }
 
@@ -207,11 +600,15 @@ TVec3 Entity_GetUpVector( TEntity * ent ) {
 }
 
 void Entity_AddChild( TEntity * ent, TEntity * child ) {
-    List_Add( &ent->childs, child );
+    Entity_Attach( child, ent );
 }
 
 TEntity * Entity_GetChild( TEntity * ent, int childNum ) {
-    return List_GetNodeData( &ent->childs, childNum );
+    TEntity * child = ent->firstChild;
+    while( child && childNum-- > 0 ) {
+        child = child->nextSibling;
+    }
+    return child;
 }
 
 TCamera * Entity_MakeCamera( TEntity * ent ) {
@@ -225,9 +622,7 @@ void Entity_CalculateGlobalTransform( TEntity * ent ) {
     if( ent->dynBody ) {
         ent->localPosition = ent->dynBody->position;
     }
-    TMatrix4 scale = Matrix4_Scale( ent->localScale );
-    ent->localTransform = Matrix4_SetRotationOrigin( ent->localRotation, ent->localPosition );	    
-    ent->localTransform = Matrix4_Multiply( scale, ent->localTransform );
+    ent->localTransform = Matrix4_ComposeTransform( ent->localScale, ent->localRotation, ent->localPosition );
     if( ent->parent ) {
         Entity_CalculateGlobalTransform( ent->parent );
         ent->globalTransform = Matrix4_Multiply( ent->localTransform, ent->parent->globalTransform );
@@ -241,8 +636,36 @@ void Entity_CalculateGlobalTransform( TEntity * ent ) {
 }
 
 void Entity_Attach( TEntity * ent, TEntity * parent ) {
-    ent->parent = parent;
-    List_Add( &parent->childs, ent );
+    Entity_Detach( ent );
+    ent->globalTransformCalculated = false;
+    if( parent ) {
+        Entity_DropDescendantIndex( parent );
+        ent->parent = parent;
+        ent->prevSibling = parent->lastChild;
+        if( parent->lastChild ) {
+            parent->lastChild->nextSibling = ent;
+        } else {
+            parent->firstChild = ent;
+        }
+        parent->lastChild = ent;
+        parent->childCount++;
+        // first child with the name wins, as it was with linear search
+        if( !Entity_FindIndexedChild( parent, ent->name )) {
+            Entity_UnshareChildIndex( parent );
+            HashMap_Insert( &parent->childIndex, ent->name, ent );
+        }
+    }
+    // order stays correct while parent precedes the entity, descendants of the entity
+    // are already placed after it
+    if( gTransformOrderValid ) {
+        if( !parent ) {
+            gTransforms.parent[ ent->transformIndex ] = -1;
+        } else if( parent->transformIndex < ent->transformIndex ) {
+            gTransforms.parent[ ent->transformIndex ] = parent->transformIndex;
+        } else {
+            gTransformOrderValid = false;
+        }
+    }
 }
 
 TVec3 Entity_GetGlobalPosition( TEntity * ent ) {
@@ -260,52 +683,45 @@ void Entity_SetLocalPosition( TEntity * ent, const TVec3 * pos ) {
 //=================
 // Animation
 //=================
-void Entity_SetAnimation( TEntity * ent, TAnimation * anim ) {
-    ent->anim = anim;
-    // also process childs
-    for_each( TEntity, child, ent->childs ) {
-        child->anim = anim;
+// computes transformation of the each bone affecting surfaces of the entity
+static void Entity_UpdateSkinPalette( TEntity * ent ) {
+    for_each( TSurface, surface, ent->surfaces ) {
+        TSkinData * skin = &surface->skin;
+        for( int i = 0; i < skin->boneCount; i++ ) {
+            TEntity * boneEnt = skin->bones[i];
+            if( boneEnt ) {
+                TMatrix4 boneTransform;
+                Matrix4_MultiplyTo( &boneEnt->invBindTransform, &boneEnt->globalTransform, &boneTransform );
+                Matrix4_MultiplyTo( &ent->localTransform, &boneTransform, skin->palette + i );    // correct ??
+            } else {
+                skin->palette[i] = ent->localTransform;
+            }
+        }
+        // mark buffers as 'not processed' for the renderer
+        surface->buffersReady = false;
     }
 }
 
-void Entity_Animate( TEntity * ent ) {
+static void Entity_AnimateSkin( TEntity * ent ) {
     // skeletal animation 
     if( ent->skinned ) {
+        Entity_UpdateSkinPalette( ent );
         for_each( TSurface, surface, ent->surfaces ) {
-            // firstly, compute transformation of the each bone affecting this surface
-            for_each( TBone, bone, surface->bones ) {
-                bone->transform = Matrix4_Multiply( bone->boneEnt->invBindTransform, bone->boneEnt->globalTransform  );                  
-                bone->transform = Matrix4_Multiply( ent->localTransform, bone->transform );    // correct ??    
-                //bone->transform = Matrix4_Multiply( ent->globalTransform, bone->transform );               
-            }
-            // mark buffers as 'not processed' for the renderer
-            surface->buffersReady = false;
-            // finally, do skeletal animation                 
-            for( int i = 0; i < surface->vertexCount; i++ ) {
-                TVertex * vertex = surface->vertices + i;
-                TVertex * skinVertex = surface->skinVertices + i;
-                TBoneGroup * bg = surface->vertexBones + i;
-                skinVertex->p = Vec3_Zero();
-                for( int k = 0; k < bg->boneCount; k++ ) {
-                    TBone * bone = &bg->bones[k];
-                    // transform vertex 
-                    TVec3 transformed = Matrix4_TransformVector( bone->transform, vertex->p );
-                    skinVertex->p = Vec3_Add( skinVertex->p, Vec3_Scale( transformed, bone->weight ));
-                }
-            }
+            surface->skin.maxInfluences = SKIN_BONES_PER_VERTEX;
+            Skin_Apply( &surface->skin, surface->skinVertices );
         }
-    } else {
-        // keyframe animation 
-        if( ent->anim ) {
-            if( ent->keyFrames.size ) {
-                TKeyFrame * currentFrame = List_GetNodeData( &ent->keyFrames, ent->anim->curFrame );
-                TKeyFrame * nextFrame = List_GetNodeData( &ent->keyFrames, ent->anim->nextFrame );
-
-                ent->localRotation = Quaternion_Slerp( currentFrame->rot, nextFrame->rot, ent->anim->interp );
-                ent->localPosition = Vec3_Lerp( currentFrame->pos, nextFrame->pos, ent->anim->interp );
-            }
-        } 
-    }    
+        ent->skinInvalid = false;
+    }
+}
+
+static void Entity_SkinJob( void * data, int index ) {
+    TSurface * surface = ((TSurface**)data)[index];
+    Skin_Apply( &surface->skin, surface->skinVertices );
+}
+
+void Entity_Animate( TEntity * ent ) {
+    World_WaitAnimation();
+    Entity_AnimateSkin( ent );
 }
 
 void Entity_ApplyProperties( TEntity * ent ) {
@@ -323,17 +739,320 @@ void Entity_ApplyProperties( TEntity * ent ) {
 //=================
 // World
 //=================
-void World_Update( ) {
-    Animation_UpdateAll();
-	for_each( TEntity, entity, g_entities ) {
-		Entity_CalculateGlobalTransform( entity );        
-        Entity_Animate( entity );
+static void World_BuildTransformOrder( void ) {
+    if( gTransformOrderCapacity < g_entityCount ) {
+        gTransformOrderCapacity = g_entityCount * 2;
+        gTransformOrder = Memory_Reallocate( gTransformOrder, gTransformOrderCapacity * sizeof( TEntity * ));
+    }
+    TransformArray_Resize( &gTransforms, g_entityCount );
+    // counting sort by depth
+    int maxDepth = 0;
+    for( int i = 0; i < g_entityCount; i++ ) {
+        TEntity * entity = g_entities[i];
+        entity->depth = 0;
+        for( TEntity * parent = entity->parent; parent; parent = parent->parent ) {
+            entity->depth++;
+        }
+        if( entity->depth > maxDepth ) {
+            maxDepth = entity->depth;
+        }
+    }
+    TScratchMark mark = Scratch_GetMark();
+    int * depthOffset = Scratch_AllocateClean(( maxDepth + 2 ) * sizeof( int ));
+    for( int i = 0; i < g_entityCount; i++ ) {
+        depthOffset[ g_entities[i]->depth + 1 ]++;
+    }
+    for( int i = 1; i <= maxDepth + 1; i++ ) {
+        depthOffset[i] += depthOffset[ i - 1 ];
+    }
+    for( int i = 0; i < g_entityCount; i++ ) {
+        TEntity * placed = g_entities[i];
+        placed->transformIndex = depthOffset[ placed->depth ]++;
+        gTransformOrder[ placed->transformIndex ] = placed;
+    }
+    Scratch_Rewind( mark );
+    gTransformOrderCount = g_entityCount;
+    gTransformOrderHoles = 0;
+    for( int i = 0; i < gTransformOrderCount; i++ ) {
+        TEntity * parent = gTransformOrder[i]->parent;
+        gTransforms.parent[i] = parent ? parent->transformIndex : -1;
+    }
+    gTransformOrderValid = true;
+}
+
+void World_UpdateTransforms( void ) {
+    // contents of transform array is meaningless after reordering
+    bool updateAll = !gTransformOrderValid;
+    if( !gTransformOrderValid ) {
+        World_BuildTransformOrder();
+    }
+    TScratchMark mark = Scratch_GetMark();
+    int * changedLocal = Scratch_NewCount( gTransformOrderCount, int );
+    int * changedGlobal = Scratch_NewCount( gTransformOrderCount, int );
+    int changedLocalCount = 0, changedGlobalCount = 0;
+    // gather local transforms which were changed since last update, transform array
+    // keeps components used to build current local matrices
+    for( int i = 0; i < gTransformOrderCount; i++ ) {
+        TEntity * ent = gTransformOrder[i];
+        if( !ent ) {
+            continue;
+        }
+        if( ent->dynBody ) {
+            ent->localPosition = ent->dynBody->position;
+        }
+        bool localChanged = updateAll || !ent->globalTransformCalculated ||
+            !TransformArray_Equals( &gTransforms, i, ent->localPosition, ent->localRotation, ent->localScale );
+        if( localChanged ) {
+            TransformArray_Set( &gTransforms, i, ent->localPosition, ent->localRotation, ent->localScale );
+            ent->globalTransformCalculated = true;
+            changedLocal[ changedLocalCount++ ] = i;
+        }
+        // parent is already processed, because of order
+        int parent = gTransforms.parent[i];
+        ent->transformChanged = localChanged || ( parent >= 0 && gTransformOrder[ parent ]->transformChanged );
+        if( ent->transformChanged ) {
+            changedGlobal[ changedGlobalCount++ ] = i;
+        }
+    }
+    Transform_ComposeBatch( &gTransforms, changedLocal, changedLocalCount );
+    Transform_PropagateBatch( &gTransforms, changedGlobal, changedGlobalCount );
+    // scatter results back to entities
+    for( int n = 0; n < changedGlobalCount; n++ ) {
+        int i = changedGlobal[n];
+        TEntity * ent = gTransformOrder[i];
+        ent->localTransform = gTransforms.local[i];
+        ent->globalTransform = gTransforms.global[i];
+        ent->globalPosition.x = ent->globalTransform.f[12];
+        ent->globalPosition.y = ent->globalTransform.f[13];
+        ent->globalPosition.z = ent->globalTransform.f[14];
+    }
+    Scratch_Rewind( mark );
+}
+
+void World_SaveState( void ) {
+    for( int i = 0; i < g_entityCount; i++ ) {
+        TEntity * ent = g_entities[i];
+        // position of body gets to entity only on transform update
+        ent->prevPosition = ent->dynBody ? ent->dynBody->position : ent->localPosition;
+        ent->prevRotation = ent->localRotation;
+        ent->prevStateValid = true;
+    }
+}
+
+static bool World_StateChanged( const TEntity * ent ) {
+    if( !ent->prevStateValid ) {
+        return false;
+    }
+    const TVec3 * a = &ent->prevPosition, * b = &ent->localPosition;
+    const TQuaternion * p = &ent->prevRotation, * q = &ent->localRotation;
+    return a->x != b->x || a->y != b->y || a->z != b->z || p->x != q->x || p->y != q->y || p->z != q->z || p->w != q->w;
+}
+
+void World_InterpolateTransforms( float alpha ) {
+    for( int i = 0; i < gTransformOrderCount; i++ ) {
+        TEntity * ent = gTransformOrder[i];
+        if( !ent ) {
+            continue;
+        }
+        // parent is already processed, because of order
+        int parent = gTransforms.parent[i];
+        TEntity * parentEnt = parent >= 0 ? gTransformOrder[ parent ] : NULL;
+        bool changed = World_StateChanged( ent );
+        ent->renderInterpolated = changed || ( parentEnt && parentEnt->renderInterpolated );
+        // most entities don't move, they are drawn with their global transform
+        if( !ent->renderInterpolated ) {
+            ent->renderTransform = ent->globalTransform;
+            continue;
+        }
+        TMatrix4 local = ent->localTransform;
+        if( changed ) {
+            TVec3 position = Vec3_Lerp( ent->prevPosition, ent->localPosition, alpha );
+            TQuaternion rotation = Quaternion_Slerp( ent->prevRotation, ent->localRotation, alpha );
+            local = Matrix4_ComposeTransform( ent->localScale, rotation, position );
+        }
+        if( parentEnt ) {
+            Matrix4_MultiplyTo( &local, &parentEnt->renderTransform, &ent->renderTransform );
+        } else {
+            ent->renderTransform = local;
+        }
+    }
+}
+
+void World_WaitAnimation( void ) {
+    Jobs_Wait( &gSkinBatch );
+}
+
+const TAnimationStats * World_GetAnimationStats( void ) {
+    return &gAnimationStats;
+}
+
+static int World_SelectAnimationLod( TEntity * ent ) {
+    if( !pActiveCamera || !pActiveCamera->owner ) {
+        return 0;
+    }
+    bool visible = false;
+    if( ent->visible ) {
+        for_each( TSurface, surface, ent->surfaces ) {
+            TVec3 center = Matrix4_TransformVector( ent->globalTransform, surface->aabb.center );
+            if( Camera_IsSphereVisible( pActiveCamera, center, surface->aabb.radius * ANIMATION_LOD_BOUNDS_SCALE )) {
+                visible = true;
+                break;
+            }
+        }
+    }
+    if( !visible ) {
+        return ANIMATION_LOD_INVISIBLE;
+    }
+    float distance = Vec3_Distance( ent->globalPosition, pActiveCamera->owner->globalPosition );
+    if( distance < ANIMATION_LOD_NEAR_DISTANCE ) {
+        return 0;
+    } else if( distance < ANIMATION_LOD_FAR_DISTANCE ) {
+        return 1;
+    }
+    return 2;
+}
+
+void World_Update( float dt ) {
+    // previous skinning must be done before bones are moved again
+    World_WaitAnimation();
+    Animation_UpdateAll( dt );
+    // poses first, so bones are in actual pose when skinning is done
+    Animator_UpdateAll( dt );
+    World_UpdateTransforms();
+    // palettes are computed here, so workers don't read transforms which can be changed by game code
+    gSkinQueueCount = 0;
+    gAnimationTick++;
+    memset( &gAnimationStats, 0, sizeof( gAnimationStats ));
+	for( int i = 0; i < g_entityCount; i++ ) {
+        TEntity * ent = g_entities[i];
+        if( !ent->skinned ) {
+            continue;
+        }
+        int vertexCount = 0;
+        for_each( TSurface, counted, ent->surfaces ) {
+            vertexCount += counted->vertexCount;
+        }
+        int lod = World_SelectAnimationLod( ent );
+        if( lod == ANIMATION_LOD_INVISIBLE ) {
+            ent->skinInvalid = true;
+            gAnimationStats.skippedInvisibleVertices += vertexCount;
+            continue;
+        }
+        // slot number spreads decimated entities over ticks
+        if( !ent->skinInvalid && ( gAnimationTick + ent->slot ) % gAnimationLodInterval[ lod ] ) {
+            gAnimationStats.skippedDecimatedVertices += vertexCount;
+            continue;
+        }
+        ent->skinInvalid = false;
+        gAnimationStats.skinnedVertices += vertexCount;
+        if( gAnimationLodInfluences[ lod ] < SKIN_BONES_PER_VERTEX ) {
+            gAnimationStats.reducedVertices += vertexCount;
+        }
+        Entity_UpdateSkinPalette( ent );
+        for_each( TSurface, surface, ent->surfaces ) {
+            surface->skin.maxInfluences = gAnimationLodInfluences[ lod ];
+            // shared surface is skinned once with palette of its last owner, as it was before
+            if( !surface->skin.queued ) {
+                surface->skin.queued = true;
+                if( gSkinQueueCount >= gSkinQueueCapacity ) {
+                    gSkinQueueCapacity = gSkinQueueCapacity ? gSkinQueueCapacity * 2 : 64;
+                    gSkinQueue = Memory_Reallocate( gSkinQueue, gSkinQueueCapacity * sizeof( TSurface * ));
+                }
+                gSkinQueue[ gSkinQueueCount++ ] = surface;
+            }
+        }
 	}
+    for( int i = 0; i < gSkinQueueCount; i++ ) {
+        gSkinQueue[i]->skin.queued = false;
+    }
+    // one job per surface, results are joined in World_WaitAnimation before rendering
+    Jobs_Dispatch( &gSkinBatch, Entity_SkinJob, gSkinQueue, gSkinQueueCount );
 }
 
 //=================
 // Loading
 //=================
+static void Entity_AddVertexBone( TBoneGroup * bg, int boneId, float weight ) {
+    int slot = bg->boneCount;
+    if( slot >= SKIN_BONES_PER_VERTEX ) {
+        // replace the weakest influence
+        slot = 0;
+        for( int i = 1; i < bg->boneCount; i++ ) {
+            if( bg->bones[i].weight < bg->bones[slot].weight ) {
+                slot = i;
+            }
+        }
+        if( bg->bones[slot].weight >= weight ) {
+            return;
+        }
+    } else {
+        bg->boneCount++;
+    }
+    bg->bones[slot].boneId = boneId;
+    bg->bones[slot].weight = weight;
+}
+
+// converts per-vertex bone groups into skin data with compact bone palette. bone ids are
+// indices in 'nodes', invalid ids refer to a NULL bone
+static void Entity_BuildSkin( TSurface * surf, TEntity ** nodes, int nodeCount ) {
+    TEntity * bones[SKIN_MAX_BONES];
+    int boneCount = 0;
+    // palette index of each node, last element is for invalid ids
+    TScratchMark mark = Scratch_GetMark();
+    int * paletteIndex = Scratch_NewCount( nodeCount + 1, int );
+    memset( paletteIndex, 0xFF, ( nodeCount + 1 ) * sizeof( int ));
+    for( int i = 0; i < surf->vertexCount; i++ ) {
+        TBoneGroup * bg = surf->vertexBones + i;
+        for( int k = 0; k < bg->boneCount; k++ ) {
+            TBone * bone = bg->bones + k;
+            if( bone->boneId < 0 || bone->boneId >= nodeCount ) {
+                bone->boneId = nodeCount;
+            }
+            if( paletteIndex[ bone->boneId ] < 0 ) {
+                if( boneCount >= SKIN_MAX_BONES ) {
+                    Util_RaiseError( "Skinned surface has more than %d bones!", SKIN_MAX_BONES );
+                }
+                paletteIndex[ bone->boneId ] = boneCount;
+                bones[ boneCount++ ] = bone->boneId < nodeCount ? nodes[ bone->boneId ] : NULL;
+            }
+        }
+    }
+    SkinData_Create( &surf->skin, surf->vertices, surf->vertexCount, boneCount );
+    memcpy( surf->skin.bones, bones, boneCount * sizeof( TEntity * ));
+    for( int i = 0; i < surf->vertexCount; i++ ) {
+        TBoneGroup * bg = surf->vertexBones + i;
+        unsigned char * index = surf->skin.boneIndices + i * SKIN_BONES_PER_VERTEX;
+        float * weight = surf->skin.boneWeights + i * SKIN_BONES_PER_VERTEX;
+        for( int k = 0; k < bg->boneCount; k++ ) {
+            // insertion by descending weight, so LOD can take the strongest influences
+            int n = k;
+            while( n > 0 && weight[ n - 1 ] < bg->bones[k].weight ) {
+                index[n] = index[ n - 1 ];
+                weight[n] = weight[ n - 1 ];
+                n--;
+            }
+            index[n] = paletteIndex[ bg->bones[k].boneId ];
+            weight[n] = bg->bones[k].weight;
+        }
+    }
+    Scratch_Rewind( mark );
+    Memory_Free( surf->vertexBones );
+    surf->vertexBones = NULL;
+}
+
+// fills index in the order of Entity_GetChildByName search: childs of entity first, then
+// descendants of each child in turn, first node with the name wins
+static void Entity_IndexDescendants( TEntity * ent, THashMap * index ) {
+    for( TEntity * child = ent->firstChild; child; child = child->nextSibling ) {
+        if( !HashMap_Find( index, child->name )) {
+            HashMap_Insert( index, child->name, child );
+        }
+    }
+    for( TEntity * child = ent->firstChild; child; child = child->nextSibling ) {
+        Entity_IndexDescendants( child, index );
+    }
+}
+
 TEntity * Entity_LoadFromFile( const char * fileName ) {
     TBuffer buf;
     int meshObjectNum;
@@ -344,12 +1063,18 @@ TEntity * Entity_LoadFromFile( const char * fileName ) {
     if( !Buffer_LoadFile( &buf, fileName, &crc32 ) ) {
         Util_RaiseError( "Unable to load scene %s", fileName );
     }    
+    // surfaces, bones and keyframes of the scene are accounted as entity memory
+    Memory_PushTag( MEMORY_TAG_ENTITY );
     int numObjects = Buffer_ReadInteger( &buf );
     int numMeshes = Buffer_ReadInteger( &buf );
     int numLights = Buffer_ReadInteger( &buf ); 
     int framesCount = Buffer_ReadInteger( &buf );   
     TEntity * root = Entity_Create();    
     root->sourceCRC32 = crc32;
+    // entities attached to the root in order of loading, bones and hierarchy refer to them
+    TEntity ** nodes = Memory_NewCount( numMeshes + numLights + 1, TEntity * );
+    int nodeCount = 0;
+    THashMap nodeIndex = HASHMAP_INITIALIZER;
     for( meshObjectNum = 0; meshObjectNum < numMeshes; meshObjectNum++ ) {
         TEntity * node;
         if( numObjects == 1 ) {
@@ -370,17 +1095,17 @@ TEntity * Entity_LoadFromFile( const char * fileName ) {
         Buffer_ReadString( &buf, tempBuffer );
         Parser_LoadString( tempBuffer, &node->properties );
         Buffer_ReadString( &buf, tempBuffer );
-        node->name = String_Duplicate( tempBuffer );        
-        for( i = 0; i < keyframeCount; i++ ) {
-            TKeyFrame * keyframe = Memory_New( TKeyFrame );
-            Buffer_ReadVector3( &buf, &keyframe->pos );
-            Buffer_ReadQuaternion( &buf, &keyframe->rot );
-            List_Add( &node->keyFrames, keyframe );
-        }
+        node->name = Atom_Intern( tempBuffer );        
         if( keyframeCount ) {
-            TKeyFrame * keyFrame = List_GetNodeData( &node->keyFrames, 0 );
-            node->localPosition = keyFrame->pos;
-            node->localRotation = keyFrame->rot;
+            // raw keyframes are needed only to build compressed track
+            TKeyFrame * keyframes = Memory_NewCount( keyframeCount, TKeyFrame );
+            for( i = 0; i < keyframeCount; i++ ) {
+                Buffer_ReadVector3( &buf, &keyframes[i].pos );
+                Buffer_ReadQuaternion( &buf, &keyframes[i].rot );
+            }
+            node->track = AnimationTrack_Create( keyframes, keyframeCount );
+            Memory_Free( keyframes );
+            AnimationTrack_Sample( node->track, 0.0f, &node->localPosition, &node->localRotation );
         }
         node->totalFrames = framesCount - 1;
         for( i = 0; i < meshCount; i++ ) {
@@ -440,18 +1165,21 @@ TEntity * Entity_LoadFromFile( const char * fileName ) {
                 surf->vertexBones = Memory_NewCount( surf->vertexCount, TBoneGroup );
                 for( vertexNum = 0; vertexNum < vertexCount; vertexNum++ ) {
                     TBoneGroup * bg = surf->vertexBones + vertexNum;
-                    bg->boneCount = Buffer_ReadInteger( &buf );
-                    for( boneNum = 0; boneNum < bg->boneCount; boneNum++ ) {
+                    int boneCount = Buffer_ReadInteger( &buf );
+                    for( boneNum = 0; boneNum < boneCount; boneNum++ ) {
                         // read entity identifier, that represents bone in the current scene
-                        bg->bones[boneNum].boneId = Buffer_ReadInteger( &buf );
+                        int boneId = Buffer_ReadInteger( &buf );
                         // read weight of that bone
-                        bg->bones[boneNum].weight = Buffer_ReadFloat( &buf );
+                        float weight = Buffer_ReadFloat( &buf );
+                        // only four strongest influences are kept
+                        Entity_AddVertexBone( bg, boneId, weight );
                     }
                 }
             }
         }
         if( numObjects > 1 ) {
             Entity_Attach( node, root );
+            nodes[ nodeCount++ ] = node;
         }        
     }
     // load lights
@@ -460,7 +1188,9 @@ TEntity * Entity_LoadFromFile( const char * fileName ) {
         TLight * lit = Memory_New( TLight );
         TEntity * litEnt = Entity_Create();
         litEnt->componentLight = lit;
-        Buffer_ReadString( &buf, litEnt->name );
+        char nameBuffer[256];
+        Buffer_ReadString( &buf, nameBuffer );
+        litEnt->name = Atom_Intern( nameBuffer );
         lit->type = Buffer_ReadInteger( &buf );
         Buffer_ReadVector3( &buf, &lit->color );
         lit->color = Vec3_Scale( lit->color, 1.0f / 255.0f );
@@ -476,56 +1206,254 @@ TEntity * Entity_LoadFromFile( const char * fileName ) {
             Buffer_ReadQuaternion( &buf, &litEnt->localRotation );
         }
         Entity_Attach( litEnt, root );
-        List_Add( &g_lights, lit );
+        nodes[ nodeCount++ ] = litEnt;
+        Light_Register( lit );
+    }
+    // first node with the name wins
+    for( i = nodeCount - 1; i >= 0; i-- ) {
+        HashMap_Insert( &nodeIndex, nodes[i]->name, nodes[i] );
     }
-    // load hierarchy
-    for_each( TEntity, child, root->childs ) {
-        UNUSED_VARIABLE( child );
+    // load hierarchy, nodes are moved from root to their parents
+    for( i = 0; i < nodeCount; i++ ) {
         char objName[128], parName[128];
         Buffer_ReadString( &buf, objName );
         Buffer_ReadString( &buf, parName );
-        TEntity * object = Entity_GetChildByName( root, objName );
-        TEntity * parent = Entity_GetChildByName( root, parName );
-        if( parent ) {
+        TEntity * object = HashMap_Find( &nodeIndex, objName );
+        TEntity * parent = HashMap_Find( &nodeIndex, parName );
+        if( object && parent ) {
             Entity_Attach( object, parent );
         }
     }
+    HashMap_Free( &nodeIndex );
+    // search by name from the root doesn't walk whole scene
+    Entity_IndexDescendants( root, &root->descendantIndex );
     // iterate over scene's entities
-    for_each( TEntity, ent, root->childs ) {
+    for( int nodeNum = 0; nodeNum < nodeCount; nodeNum++ ) {
+        TEntity * ent = nodes[ nodeNum ];
         Entity_ApplyProperties( ent );
         Entity_CalculateGlobalTransform( ent );
         // calculate inverse bind transform of the entity
         ent->invBindTransform = Matrix4_Inverse( ent->globalTransform );
         if( ent->skinned ) {
-            // find bones. we can't assing correct bone to each vertex in loading time, because
-            // there is no confidence that needed bone does exist, assigning bones after load 
-            // each entity removes this undefined behaviour
+            // bones are resolved after load, because bone can be stored after skinned entity
             for_each( TSurface, surf, ent->surfaces ) {
-                for( vertexNum = 0; vertexNum < surf->vertexCount; vertexNum++ ) {
-                    TBoneGroup * bg = surf->vertexBones + vertexNum;
-                    for( boneNum = 0; boneNum < bg->boneCount; boneNum++ ) {
-                        TBone * bone = &bg->bones[boneNum];
-                        // acquire correct bone node
-                        bone->boneEnt = List_GetNodeData( &root->childs, bone->boneId );
-                        // check for duplicates
-                        if( !List_Find( &surf->bones, bone )) { 
-                            List_Add( &surf->bones, bone );
-                        }
-                    }
-                }
+                Entity_BuildSkin( surf, nodes, nodeCount );
             }
         }
     }
+    Memory_Free( nodes );
     Buffer_Free( &buf );
+    Memory_PopTag();
     return root;
 }
 
 TEntity * Entity_GetChildByName( TEntity * parent, const char * name ) {
-    for_each( TEntity, child, parent->childs ) {
-        if( !strcmp( child->name, name ) ) {
-            return child;
+    if( parent->descendantIndex.entries ) {
+        return HashMap_Find( &parent->descendantIndex, name );
+    }
+    TEntity * found = Entity_FindIndexedChild( parent, name );
+    if( !found ) {
+        for( TEntity * child = parent->firstChild; child && !found; child = child->nextSibling ) {
+            found = Entity_GetChildByName( child, name );
         }
     }
-    return NULL;
+    return found;
 }
 
+#define TEST_PREFAB_CHILD_COUNT (7)
+#define TEST_PREFAB_GRANDCHILD_COUNT (6)
+#define TEST_PREFAB_INSTANCE_COUNT (100)
+#define BENCHMARK_PREFAB_INSTANCE_COUNT (1000)
+
+// instancing as it was done before prefabs, each node is created and attached separately
+static TEntity * Test_CreateInstancePerNode( TEntity * source ) {
+    TEntity * ent = Pool_New( &gEntityPool, TEntity );
+    Entity_Register( ent );
+    ent->localPosition = source->localPosition;
+    ent->localRotation = source->localRotation;
+    ent->localScale = source->localScale;
+    ent->visible = true;
+    ent->alpha = source->alpha;
+    ent->depthHack = source->depthHack;
+    ent->animated = source->animated;
+    ent->globalTransform = source->globalTransform;
+    ent->localTransform = source->localTransform;
+    ent->invBindTransform = source->invBindTransform;
+    ent->color = source->color;
+    ent->sourceCRC32 = source->sourceCRC32;
+    for_each( TSurface, surf, source->allSurfaces ) {
+        List_Add( &ent->allSurfaces, surf );
+    }
+    List_Create( &ent->surfaces );
+    for_each( TSurface, surface, source->surfaces ) {
+        surface->shareCount++;
+        List_Add( &ent->surfaces, surface );
+    }
+    HashMap_Create( &ent->childIndex );
+    for( TEntity * sourceChild = source->firstChild; sourceChild; sourceChild = sourceChild->nextSibling ) {
+        Entity_Attach( Test_CreateInstancePerNode( sourceChild ), ent );
+    }
+    ent->track = AnimationTrack_Share( source->track );
+    ent->skinned = source->skinned;
+    ent->dynBody = source->dynBody;
+    ent->totalFrames = source->totalFrames;
+    ent->instanceOf = source;
+    ent->name = source->name;
+    if( source->componentLight ) {
+        ent->componentLight = Memory_New( TLight );
+        (*ent->componentLight) = (*source->componentLight);
+        ent->componentLight->owner = ent;
+        List_Create( &ent->componentLight->affectedAtlasList );
+    }
+    return ent;
+}
+
+static void Test_CheckInstance( TEntity * instance, TEntity * source ) {
+    if( instance->name != source->name || instance->childCount != source->childCount || instance->track != source->track ||
+        instance->surfaces.size != source->surfaces.size || instance->allSurfaces.size != source->allSurfaces.size ||
+        ( source->componentLight && instance->componentLight->owner != instance )) {
+        Util_RaiseError( "Test_Prefab: node '%s' of instance doesn't match source!", source->name );
+    }
+    TEntity * child = instance->firstChild;
+    for( TEntity * sourceChild = source->firstChild; sourceChild; sourceChild = sourceChild->nextSibling ) {
+        if( !child || child->parent != instance || Entity_FindIndexedChild( instance, child->name ) != child ) {
+            Util_RaiseError( "Test_Prefab: hierarchy of instance is broken!" );
+        }
+        Test_CheckInstance( child, sourceChild );
+        child = child->nextSibling;
+    }
+}
+
+static TEntity * Test_CreatePrefabNode( TEntity * parent, const char * name, TAnimationTrack * track, TSurface * surface ) {
+    TEntity * ent = Entity_Create();
+    ent->name = Atom_Intern( name );
+    ent->track = AnimationTrack_Share( track );
+    // surface is owned by test, so it is never freed by entity
+    surface->shareCount = 2;
+    Entity_AddSurface( ent, surface );
+    if( parent ) {
+        Entity_Attach( ent, parent );
+    }
+    return ent;
+}
+
+// 50 nodes like in loaded model: each one is keyframe-animated and has a surface, root
+// has list of all surfaces, few nodes are lights. all of it is owned by test
+typedef struct TTestPrefabModel {
+    TAnimationTrack * track;
+    TSurface * surfaces;
+    TLight * lights;
+    TEntity * source;
+} TTestPrefabModel;
+
+static void Test_CreatePrefabModel( TTestPrefabModel * model ) {
+    TKeyFrame keyFrames[2] = {
+        { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+        { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }}
+    };
+    model->track = AnimationTrack_Create( keyFrames, 2 );
+    int nodeCount = 1 + TEST_PREFAB_CHILD_COUNT * ( 1 + TEST_PREFAB_GRANDCHILD_COUNT );
+    model->surfaces = Memory_NewCount( nodeCount, TSurface );
+    model->lights = Memory_NewCount( TEST_PREFAB_CHILD_COUNT, TLight );
+    int surfaceCount = 0;
+    model->source = Test_CreatePrefabNode( NULL, "Root", model->track, model->surfaces + surfaceCount++ );
+    for( int i = 0; i < TEST_PREFAB_CHILD_COUNT; i++ ) {
+        char name[64];
+        sprintf( name, "Child%d", i );
+        TEntity * child = Test_CreatePrefabNode( model->source, name, model->track, model->surfaces + surfaceCount++ );
+        child->componentLight = model->lights + i;
+        for( int k = 0; k < TEST_PREFAB_GRANDCHILD_COUNT; k++ ) {
+            sprintf( name, "Child%d_%d", i, k );
+            Test_CreatePrefabNode( child, name, model->track, model->surfaces + surfaceCount++ );
+        }
+    }
+    for( int i = 0; i < surfaceCount; i++ ) {
+        List_Add( &model->source->allSurfaces, model->surfaces + i );
+    }
+}
+
+static void Test_FreePrefabModel( TTestPrefabModel * model ) {
+    for( TEntity * child = model->source->firstChild; child; child = child->nextSibling ) {
+        child->componentLight = NULL;
+    }
+    Entity_Free( model->source );
+    AnimationTrack_Release( model->track );
+    Memory_Free( model->lights );
+    Memory_Free( model->surfaces );
+}
+
+void Test_Prefab( void ) {
+    TTestPrefabModel model;
+    Test_CreatePrefabModel( &model );
+    TEntity * source = model.source;
+    TPrefab * prefab = Prefab_Create( source );
+    TEntity * instances[TEST_PREFAB_INSTANCE_COUNT];
+    for( int i = 0; i < TEST_PREFAB_INSTANCE_COUNT; i++ ) {
+        instances[i] = Prefab_Instantiate( prefab );
+    }
+    for( int i = 0; i < TEST_PREFAB_INSTANCE_COUNT; i++ ) {
+        Test_CheckInstance( instances[i], source );
+        if( Entity_GetChildByName( instances[i], "Child3_4" ) != Entity_GetChildByName( instances[i], "Child3" )->lastChild->prevSibling ) {
+            Util_RaiseError( "Test_Prefab: search by name failed!" );
+        }
+    }
+    // detached child outlives its instance
+    TEntity * orphan = Entity_GetChildByName( instances[0], "Child2" );
+    Entity_Attach( orphan, NULL );
+    // attaching to node of other instance makes own copy of its child index
+    TEntity * other = Entity_GetChildByName( instances[ TEST_PREFAB_INSTANCE_COUNT - 1 ], "Child0" );
+    TEntity * otherChild = other->lastChild;
+    Entity_Attach( orphan, other );
+    if( Entity_GetChildByName( other, "Child2" ) != orphan || Entity_GetChildByName( other, "Child0_5" ) != otherChild ||
+        other->sharedChildIndex ) {
+        Util_RaiseError( "Test_Prefab: child index of instance is broken!" );
+    }
+    Entity_Attach( orphan, NULL );
+    for( int i = 0; i < TEST_PREFAB_INSTANCE_COUNT; i++ ) {
+        Entity_Free( instances[i] );
+    }
+    Test_CheckInstance( orphan, Entity_GetChildByName( source, "Child2" ));
+    Entity_Free( orphan );
+    // single instance without prefab of caller
+    TEntity * single = Entity_CreateInstance( source );
+    Test_CheckInstance( single, source );
+    Entity_Free( single );
+    Prefab_Release( prefab );
+    Test_FreePrefabModel( &model );
+}
+
+void Benchmark_Prefab( void ) {
+    TTestPrefabModel model;
+    Test_CreatePrefabModel( &model );
+    TPrefab * prefab = Prefab_Create( model.source );
+    TEntity ** instances = Memory_NewCount( BENCHMARK_PREFAB_INSTANCE_COUNT, TEntity* );
+    // best of few passes, first ones grow entity arrays and pools
+    TTimer timer;
+    Timer_Create( &timer );
+    double perNodeTime = 1e9, prefabTime = 1e9;
+    for( int pass = 0; pass < 3; pass++ ) {
+        Timer_Restart( &timer );
+        for( int i = 0; i < BENCHMARK_PREFAB_INSTANCE_COUNT; i++ ) {
+            instances[i] = Test_CreateInstancePerNode( model.source );
+        }
+        double time = Timer_GetElapsedMilliseconds( &timer );
+        perNodeTime = time < perNodeTime ? time : perNodeTime;
+        for( int i = 0; i < BENCHMARK_PREFAB_INSTANCE_COUNT; i++ ) {
+            Entity_Free( instances[i] );
+        }
+        Timer_Restart( &timer );
+        for( int i = 0; i < BENCHMARK_PREFAB_INSTANCE_COUNT; i++ ) {
+            instances[i] = Prefab_Instantiate( prefab );
+        }
+        time = Timer_GetElapsedMilliseconds( &timer );
+        prefabTime = time < prefabTime ? time : prefabTime;
+        for( int i = 0; i < BENCHMARK_PREFAB_INSTANCE_COUNT; i++ ) {
+            Entity_Free( instances[i] );
+        }
+    }
+    printf( "Prefab: %d instances of %d nodes: per node %.3f ms, prefab %.3f ms\n", BENCHMARK_PREFAB_INSTANCE_COUNT, prefab->nodeCount,
+        perNodeTime, prefabTime );
+    Memory_Free( instances );
+    Prefab_Release( prefab );
+    Test_FreePrefabModel( &model );
+}
@@ -7,6 +7,7 @@
 #include "matrix4.h"
 #include "surface.h"
 #include "list.h"
+#include "hashmap.h"
 #include "renderer.h"
 #include "light.h"
 #include "animation.h"
@@ -14,6 +15,7 @@
 #include "ValueArray.h"
 #include "Parser.h"
 #include "billboard.h"
+#include "pool.h"
 
 OLDTECH_BEGIN_HEADER
 
@@ -24,10 +26,13 @@ typedef enum {
     EFX_BLEND_MULTIPLY = 2,
 } EEntityFX;
 
-typedef struct SKeyFrame {
-    TVec3 pos;
-    TQuaternion rot;
-} TKeyFrame;
+// weak reference to an entity, stays valid after entity is freed, but resolves to NULL
+typedef struct TEntityHandle {
+    int index; // slot index, -1 for null handle
+    unsigned int generation;
+} TEntityHandle;
+
+#define ENTITY_NULL_HANDLE { -1, 0 }
 
 typedef struct TEntity {
     TVec3 localPosition; // read\write
@@ -37,17 +42,35 @@ typedef struct TEntity {
     TMatrix4 globalTransform; // read only
     TMatrix4 localTransform; // read\write
     TMatrix4 invBindTransform; // read only
+    TMatrix4 renderTransform; // read only, global transform interpolated between two last simulation steps
+    // local state before last simulation step
+    TVec3 prevPosition;
+    TQuaternion prevRotation;
+    bool prevStateValid; // false for entities created after last World_SaveState
+    bool renderInterpolated; // renderTransform differs from globalTransform
     struct TEntity * parent;
+    // intrusive child list, childs are in order of attachment
+    struct TEntity * firstChild;
+    struct TEntity * lastChild;
+    struct TEntity * prevSibling;
+    struct TEntity * nextSibling;
+    int childCount;
     TList surfaces;
-    TList childs;
+    THashMap childIndex; // name -> child, name of a child must not change while it attached
+    THashMap descendantIndex; // name -> descendant, built for root of loaded scene, dropped when hierarchy changes
     bool skinned;
-    char * name;
-    TList keyFrames;
+    bool skinInvalid; // skinned vertices don't match current pose, forces skinning on next update
+    TAtom name;
+    TAnimationTrack * track; // NULL if node isn't keyframe-animated
     int totalFrames;
-    TAnimation * anim;
     bool visible;
     bool animated;
-	bool globalTransformCalculated;
+	bool globalTransformCalculated; // false forces recalculation on next World_UpdateTransforms
+    bool transformChanged; // global transform was changed by last World_UpdateTransforms
+    int depth; // depth in the hierarchy, entity without parent has zero depth
+    int transformIndex; // index in the world transform array
+    int slot; // index in the slot map
+    int denseIndex; // index in g_entities
 	float depthHack;
     TValueArray properties;
     int fxFlags;
@@ -62,20 +85,52 @@ typedef struct TEntity {
     TLight * componentLight;    
     struct TBillboard * componentBillboard;
     struct TEntity *instanceOf;
+    // instance of prefab is placed in one memory block together with its components
+    struct TPrefabInstance * prefabInstance; // NULL if entity is allocated alone
+    bool sharedSurfaces; // surfaces and allSurfaces lists belong to prefab, copied on modification
+    bool sharedChildIndex; // childIndex belongs to prefab and points to its templates, copied on modification
 } TEntity;
 
-extern TList g_entities;
+// immutable data of an entity hierarchy shared by all of its instances: surfaces, tracks and
+// layout of the hierarchy. instantiating copies node templates and fixes links between them
+typedef struct TPrefab {
+    int nodeCount;
+    TEntity * nodes; // templates in depth-first order, so parent precedes its childs
+    int lightCount;
+    int billboardCount;
+    int instanceSize; // size of memory block of instance
+    bool pooled; // false - block of each instance is allocated alone
+    TPool instancePool; // memory blocks of instances
+    int refCount; // owner and each alive instance
+} TPrefab;
+
+// all alive entities in no particular order, order changes when an entity is freed
+extern TEntity ** g_entities;
+extern int g_entityCount;
 
 TEntity * Entity_Create( void );
+// copy of hierarchy of source sharing its surfaces and tracks, use prefab to create many instances
 TEntity * Entity_CreateInstance( TEntity * source );
+// source must not be modified while prefab is used, changes made later aren't seen by prefab
+TPrefab * Prefab_Create( TEntity * source );
+TEntity * Prefab_Instantiate( TPrefab * prefab );
+// prefab is freed when it is released by owner and all instances
+void Prefab_Release( TPrefab * prefab );
 TVec3 Entity_GetLookVector( TEntity * ent );
 TVec3 Entity_GetRightVector( TEntity * ent );
 TVec3 Entity_GetUpVector( TEntity * ent );
 TVec3 Entity_GetGlobalPosition( TEntity * ent );
 void Entity_Free( TEntity * ent );
+TEntityHandle Entity_GetHandle( TEntity * ent );
+// returns NULL if entity was freed
+TEntity * Entity_FromHandle( TEntityHandle handle );
+bool Entity_IsAlive( TEntityHandle handle );
 struct TCamera * Entity_MakeCamera( TEntity * ent );
 struct TBillboard * Entity_MakeBillboard( TEntity * ent );
+// immediately recalculates transforms of the entity and all of its ancestors, use it only
+// when transform needed right after modification, cached global transform is enough otherwise
 void Entity_CalculateGlobalTransform( TEntity * ent );
+// detaches entity from current parent, passing NULL parent just detaches it
 void Entity_Attach( TEntity * ent, TEntity * parent );
 void Entity_AddSurface( TEntity * ent, TSurface * surf );
 void Entity_AddChild( TEntity * ent, TEntity * child );
@@ -85,15 +140,40 @@ void Entity_FreeAll( void );
 void Entity_SetBody( TEntity * ent, TBody * body );
 void Entity_SetLocalPosition( TEntity * ent, const TVec3 * pos );
 TEntity * Entity_LoadFromFile( const char * fileName );
+// searches direct childs first, then deeper descendants
 TEntity * Entity_GetChildByName( TEntity * parent, const char * name );
 void Entity_GetGlobalRotation( TEntity * ent, TQuaternion * globRot );
 void Entity_SetDepthHack( TEntity * ent, float depthHack );
 void Entity_ApplyProperties( TEntity * ent );
-void Entity_SetAnimation( TEntity * ent, TAnimation * anim );
+// immediately skins entity in its current pose
 void Entity_Animate( TEntity * ent );
 
-// also performs animation of each entity
-void World_Update( void );
+// skinning work of last World_Update, vertices are counted per surface of each entity
+typedef struct TAnimationStats {
+    int skinnedVertices;
+    int reducedVertices; // skinned with reduced count of bones
+    int skippedInvisibleVertices;
+    int skippedDecimatedVertices; // not skinned because of reduced update rate
+} TAnimationStats;
+
+// advances animations by dt seconds and poses each entity, skinning is done by job system in background
+void World_Update( float dt );
+// waits until skinning started by World_Update is done, must be called before skinned
+// vertices are used
+void World_WaitAnimation( void );
+const TAnimationStats * World_GetAnimationStats( void );
+// recalculates global transforms of changed entities and their descendants
+void World_UpdateTransforms( void );
+// remembers local state of entities, must be called before each simulation step
+void World_SaveState( void );
+// builds render transforms between state saved by World_SaveState ( alpha = 0 ) and current
+// one ( alpha = 1 ), must be called after World_UpdateTransforms
+void World_InterpolateTransforms( float alpha );
+
+// tests
+void Test_Prefab( void );
+// prints time of prefab instantiation against creation and attachment of each node
+void Benchmark_Prefab( void );
 
 OLDTECH_END_HEADER
 
@@ -16,6 +16,7 @@ unsigned long CeilPow2( unsigned long v ) {
 TFont * Font_LoadFromFile( const char * file, int size ) {   
     FT_Library ftLibrary;
     FT_Face face;     
+    Memory_PushTag( MEMORY_TAG_GUI );
     TFont * font = Memory_New( TFont );
     font->size = size;
 	if( FT_Init_FreeType( &ftLibrary ) ) {
@@ -96,5 +97,6 @@ TFont * Font_LoadFromFile( const char * file, int size ) {
     font->atlas = Texture2D_Create( textureSize, textureSize, 4, pixels );
     Log_Write( "Font '%s' successfully generated with glyph size %d!", file, size );
     Memory_Free( pixels );
+    Memory_PopTag();
     return font;
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "frameclock.h"
+
+void FrameClock_Create( TFrameClock * clock, double stepsPerSecond, int maxSteps ) {
+    Timer_Create( &clock->timer );
+    clock->stepTime = 1.0 / stepsPerSecond;
+    clock->lastTime = Timer_GetSeconds( &clock->timer );
+    clock->accumulator = 0.0;
+    clock->maxSteps = maxSteps;
+    clock->droppedSteps = 0;
+}
+
+int FrameClock_BeginFrame( TFrameClock * clock ) {
+    double time = Timer_GetSeconds( &clock->timer );
+    clock->accumulator += time - clock->lastTime;
+    clock->lastTime = time;
+    int steps = (int)( clock->accumulator / clock->stepTime );
+    if( steps > clock->maxSteps ) {
+        // simulation can't keep up, lost time is dropped so it doesn't pile up
+        clock->droppedSteps += steps - clock->maxSteps;
+        steps = clock->maxSteps;
+        clock->accumulator = fmod( clock->accumulator, clock->stepTime );
+    } else {
+        clock->accumulator -= steps * clock->stepTime;
+    }
+    return steps;
+}
+
+float FrameClock_GetAlpha( const TFrameClock * clock ) {
+    return (float)( clock->accumulator / clock->stepTime );
+}
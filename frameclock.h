@@ -0,0 +1,28 @@
+#ifndef _FRAME_CLOCK_
+#define _FRAME_CLOCK_
+
+#include "common.h"
+#include "timer.h"
+
+OLDTECH_BEGIN_HEADER
+
+// paces fixed simulation steps against real time. count of steps per frame is limited, so
+// after a hitch the game slows down instead of running more and more steps each frame
+typedef struct TFrameClock {
+    TTimer timer;
+    double stepTime;
+    double lastTime;
+    double accumulator; // real time not yet simulated
+    int maxSteps;
+    int droppedSteps; // steps skipped because of the limit since creation
+} TFrameClock;
+
+void FrameClock_Create( TFrameClock * clock, double stepsPerSecond, int maxSteps );
+// returns count of fixed steps to run this frame
+int FrameClock_BeginFrame( TFrameClock * clock );
+// fraction of step passed since last simulated state, used to interpolate rendering
+float FrameClock_GetAlpha( const TFrameClock * clock );
+
+OLDTECH_END_HEADER
+
+#endif
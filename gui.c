@@ -7,14 +7,17 @@
 TList gGUINodeList;
 
 TGUINode * GUI_CreateNode( void ) {
+    Memory_PushTag( MEMORY_TAG_GUI );
     TGUINode * node = Memory_New( TGUINode );
     node->visible = true;
     node->color = Vec3_Set( 1.0f, 1.0f, 1.0f );
     List_Add( &gGUINodeList, node );
+    Memory_PopTag();
     return node;
 }
 
 TGUINode * GUI_CreateRect( float x, float y, float w, float h, TTexture * tex ) { 
+    Memory_PushTag( MEMORY_TAG_GUI );
     TGUINode * node = GUI_CreateNode();
     node->rect = Memory_New( TGUIRect );
     node->rect->tex = tex; 
@@ -22,10 +25,12 @@ TGUINode * GUI_CreateRect( float x, float y, float w, float h, TTexture * tex )
     node->rect->y = y;
     node->rect->w = w;
     node->rect->h = h;    
+    Memory_PopTag();
     return node;
 }
 
 TGUINode * GUI_CreateText( float x, float y, float fieldWidth, float fieldHeight, const char * text, TFont * font ) {
+    Memory_PushTag( MEMORY_TAG_GUI );
     TGUINode * node = GUI_CreateNode();
     node->text = Memory_New( TGUIText );
     node->text->text = String_Duplicate( text );
@@ -40,10 +45,12 @@ TGUINode * GUI_CreateText( float x, float y, float fieldWidth, float fieldHeight
     for( int i = 0; i < length; i++ ) {
         node->text->width += font->charMetrics[(unsigned int)text[i]].advanceX;
     }
+    Memory_PopTag();
     return node;
 }
 
 TGUINode * GUI_CreateButton( float x, float y, float width, float height, TTexture * backgroundTex, TFont * font, const char * text ) {
+    Memory_PushTag( MEMORY_TAG_GUI );
     TGUINode * node = GUI_CreateNode();
     node->button = Memory_New( TGUIButton );
     node->button->background = GUI_CreateRect( x, y, width, height, backgroundTex );
@@ -53,10 +60,12 @@ TGUINode * GUI_CreateButton( float x, float y, float width, float height, TTextu
     node->button->pressedColor = Vec3_Set( 0.8f, 0.8f, 0.8f );
     node->button->pickedColor = Vec3_Set( 0.9f, 0.9f, 0.9f );
     node->color = node->button->normalColor;
+    Memory_PopTag();
     return node;
 }
 
 TGUINode * GUI_CreateSlider( float x, float y, float width, float height, TTexture * backgroundTex, TTexture * sliderTex, float minValue, float maxValue, TFont * font, const char * text ) {
+    Memory_PushTag( MEMORY_TAG_GUI );
     TGUINode * node = GUI_CreateNode();
     node->slider = Memory_New( TGUISlider );
     node->slider->minValue = minValue;
@@ -67,6 +76,7 @@ TGUINode * GUI_CreateSlider( float x, float y, float width, float height, TTextu
     GUI_Attach( node->slider->slider, node->slider->background );
     node->slider->text = GUI_CreateText( width + 10, 0, width, height, text, font );
     GUI_Attach( node->slider->text, node->slider->background );
+    Memory_PopTag();
     return node;
 }
 
@@ -88,7 +98,9 @@ void GUI_FreeNode( TGUINode * node ) {
 void GUI_SetNodeText( TGUINode * node, const char * text ) {
     if( node->text ) {
         Memory_Free( node->text->text );
+        Memory_PushTag( MEMORY_TAG_GUI );
         node->text->text = String_Duplicate( text );
+        Memory_PopTag();
         node->text->width = 0;
         int length = strlen( text );
         for( int i = 0; i < length; i++ ) {
@@ -0,0 +1,200 @@
+#include "hashmap.h"
+#include "timer.h"
+
+#define HASHMAP_MIN_CAPACITY (16)
+
+// marks removed entry, so probe sequences of other keys are not broken
+static const char gHashMapTombstone[1] = { 0 };
+
+unsigned int HashMap_HashString( const char * str ) {
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    while( *str ) {
+        hash ^= (unsigned char)(*str++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void HashMap_Create( THashMap * map ) {
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+    map->tombstones = 0;
+}
+
+void HashMap_Free( THashMap * map ) {
+    if( map->entries ) {
+        Memory_Free( map->entries );
+    }
+    HashMap_Create( map );
+}
+
+void HashMap_Clear( THashMap * map ) {
+    if( map->entries ) {
+        memset( map->entries, 0, map->capacity * sizeof( THashMapEntry ));
+    }
+    map->count = 0;
+    map->tombstones = 0;
+}
+
+void HashMap_Copy( THashMap * dest, const THashMap * source ) {
+    *dest = *source;
+    if( source->entries ) {
+        dest->entries = Memory_NewCount( source->capacity, THashMapEntry );
+        memcpy( dest->entries, source->entries, source->capacity * sizeof( THashMapEntry ));
+    }
+}
+
+static THashMapEntry * HashMap_Probe( const THashMap * map, const char * key, unsigned int hash ) {
+    int mask = map->capacity - 1;
+    int i = hash & mask;
+    THashMapEntry * firstTombstone = NULL;
+    while( true ) {
+        THashMapEntry * entry = map->entries + i;
+        if( !entry->key ) {
+            // key isn't in the map, reuse tombstone if passed one
+            return firstTombstone ? firstTombstone : entry;
+        }
+        if( entry->key == gHashMapTombstone ) {
+            if( !firstTombstone ) {
+                firstTombstone = entry;
+            }
+        } else if( entry->hash == hash && ( entry->key == key || !strcmp( entry->key, key ))) {
+            return entry;
+        }
+        i = ( i + 1 ) & mask;
+    }
+}
+
+static void HashMap_Rehash( THashMap * map, int newCapacity ) {
+    THashMapEntry * oldEntries = map->entries;
+    int oldCapacity = map->capacity;
+    map->entries = Memory_NewCount( newCapacity, THashMapEntry );
+    map->capacity = newCapacity;
+    map->tombstones = 0;
+    for( int i = 0; i < oldCapacity; i++ ) {
+        THashMapEntry * entry = oldEntries + i;
+        if( entry->key && entry->key != gHashMapTombstone ) {
+            *HashMap_Probe( map, entry->key, entry->hash ) = *entry;
+        }
+    }
+    if( oldEntries ) {
+        Memory_Free( oldEntries );
+    }
+}
+
+void HashMap_Insert( THashMap * map, const char * key, void * value ) {
+    // keep load factor (including tombstones) below 0.7
+    if( ( map->count + map->tombstones + 1 ) * 10 > map->capacity * 7 ) {
+        int newCapacity = map->capacity ? map->capacity : HASHMAP_MIN_CAPACITY;
+        // when map is mostly tombstones, rehashing in-place is enough
+        while( ( map->count + 1 ) * 10 > newCapacity * 5 ) {
+            newCapacity <<= 1;
+        }
+        HashMap_Rehash( map, newCapacity );
+    }
+    unsigned int hash = HashMap_HashString( key );
+    THashMapEntry * entry = HashMap_Probe( map, key, hash );
+    if( !entry->key ) {
+        map->count++;
+    } else if( entry->key == gHashMapTombstone ) {
+        map->count++;
+        map->tombstones--;
+    }
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
+}
+
+void * HashMap_Find( const THashMap * map, const char * key ) {
+    if( !map->count ) {
+        return NULL;
+    }
+    THashMapEntry * entry = HashMap_Probe( map, key, HashMap_HashString( key ));
+    if( entry->key && entry->key != gHashMapTombstone ) {
+        return entry->value;
+    }
+    return NULL;
+}
+
+bool HashMap_Remove( THashMap * map, const char * key ) {
+    if( !map->count ) {
+        return false;
+    }
+    THashMapEntry * entry = HashMap_Probe( map, key, HashMap_HashString( key ));
+    if( entry->key && entry->key != gHashMapTombstone ) {
+        entry->key = gHashMapTombstone;
+        entry->value = NULL;
+        map->count--;
+        map->tombstones++;
+        return true;
+    }
+    return false;
+}
+
+#define TEST_HASHMAP_KEY_COUNT (1000)
+#define BENCHMARK_HASHMAP_KEY_COUNT (10000)
+
+void Test_HashMap( void ) {
+    char ** keys = Memory_NewCount( TEST_HASHMAP_KEY_COUNT, char * );
+    THashMap map = HASHMAP_INITIALIZER;
+    for( int i = 0; i < TEST_HASHMAP_KEY_COUNT; i++ ) {
+        keys[i] = String_Format( "Node%d", i );
+        HashMap_Insert( &map, keys[i], keys[i] );
+    }
+    // removal must not break probe sequences of other keys
+    for( int i = 0; i < TEST_HASHMAP_KEY_COUNT; i += 2 ) {
+        HashMap_Remove( &map, keys[i] );
+    }
+    for( int i = 0; i < TEST_HASHMAP_KEY_COUNT; i++ ) {
+        void * value = HashMap_Find( &map, keys[i] );
+        if( ( i % 2 ) ? ( value != keys[i] ) : ( value != NULL )) {
+            Util_RaiseError( "Test_HashMap: lookup of '%s' failed!", keys[i] );
+        }
+    }
+    if( map.count != TEST_HASHMAP_KEY_COUNT / 2 ) {
+        Util_RaiseError( "Test_HashMap: invalid key count!" );
+    }
+    HashMap_Free( &map );
+    for( int i = 0; i < TEST_HASHMAP_KEY_COUNT; i++ ) {
+        String_Free( keys[i] );
+    }
+    Memory_Free( keys );
+}
+
+void Benchmark_HashMap( void ) {
+    char ** keys = Memory_NewCount( BENCHMARK_HASHMAP_KEY_COUNT, char * );
+    THashMap map = HASHMAP_INITIALIZER;
+    for( int i = 0; i < BENCHMARK_HASHMAP_KEY_COUNT; i++ ) {
+        keys[i] = String_Format( "Node%d", i );
+        HashMap_Insert( &map, keys[i], keys[i] );
+    }
+    // lookups of every tenth key, compared with linear search which was used before
+    TTimer timer;
+    Timer_Create( &timer );
+    int found = 0;
+    for( int i = 0; i < BENCHMARK_HASHMAP_KEY_COUNT; i += 10 ) {
+        for( int k = 0; k < BENCHMARK_HASHMAP_KEY_COUNT; k++ ) {
+            if( !strcmp( keys[k], keys[i] )) {
+                found++;
+                break;
+            }
+        }
+    }
+    double linearTime = Timer_GetElapsedMilliseconds( &timer );
+    Timer_Restart( &timer );
+    for( int i = 0; i < BENCHMARK_HASHMAP_KEY_COUNT; i += 10 ) {
+        if( HashMap_Find( &map, keys[i] ) == keys[i] ) {
+            found++;
+        }
+    }
+    double hashTime = Timer_GetElapsedMilliseconds( &timer );
+    printf( "HashMap: %d lookups (%d found) in %d keys: linear %.3f ms, hash %.3f ms\n", BENCHMARK_HASHMAP_KEY_COUNT / 10 * 2, found,
+        BENCHMARK_HASHMAP_KEY_COUNT, linearTime, hashTime );
+    HashMap_Free( &map );
+    for( int i = 0; i < BENCHMARK_HASHMAP_KEY_COUNT; i++ ) {
+        String_Free( keys[i] );
+    }
+    Memory_Free( keys );
+}
@@ -0,0 +1,45 @@
+#ifndef _HASHMAP_
+#define _HASHMAP_
+
+#include "common.h"
+
+OLDTECH_BEGIN_HEADER
+
+// string-keyed hash map with open addressing (linear probing)
+// keys are NOT copied, caller must keep key string alive while it is in the map
+typedef struct THashMapEntry {
+    const char * key; // NULL - empty slot
+    void * value;
+    unsigned int hash;
+} THashMapEntry;
+
+typedef struct THashMap {
+    THashMapEntry * entries;
+    int capacity; // always power of two or zero
+    int count;
+    int tombstones;
+} THashMap;
+
+#define HASHMAP_INITIALIZER { NULL, 0, 0, 0 }
+
+unsigned int HashMap_HashString( const char * str );
+
+void HashMap_Create( THashMap * map );
+void HashMap_Free( THashMap * map );
+void HashMap_Clear( THashMap * map );
+// 'dest' must be freed or not created yet, keys and values are copied as is
+void HashMap_Copy( THashMap * dest, const THashMap * source );
+// replaces value if key already in the map
+void HashMap_Insert( THashMap * map, const char * key, void * value );
+// returns NULL if nothing found
+void * HashMap_Find( const THashMap * map, const char * key );
+bool HashMap_Remove( THashMap * map, const char * key );
+
+// tests
+void Test_HashMap( void );
+// prints time of lookups in hash map against linear search
+void Benchmark_HashMap( void );
+
+OLDTECH_END_HEADER
+
+#endif
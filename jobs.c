@@ -0,0 +1,207 @@
+#include "jobs.h"
+#include "timer.h"
+
+#define JOBS_MAX_WORKERS (32)
+// spins with pause before giving time slice away in Jobs_Wait
+#define JOBS_SPIN_COUNT (64)
+
+TThread gJobWorkers[JOBS_MAX_WORKERS];
+int gJobWorkerCount = 0;
+TSemaphore gJobSemaphore = NULL;
+// batch which is executed now
+TJobBatch * volatile gJobCurrent = NULL;
+// count of workers which may access current batch
+volatile long gJobBusyWorkers = 0;
+volatile long gJobsQuit = 0;
+
+static void Jobs_Execute( TJobBatch * batch ) {
+    while( true ) {
+        int index = Atomic_Increment( &batch->next ) - 1;
+        if( index >= batch->count ) {
+            break;
+        }
+        batch->func( batch->data, index );
+        // last finished job signals the batch
+        if( Atomic_Increment( &batch->done ) == batch->count ) {
+            Event_Set( batch->finished );
+        }
+    }
+}
+
+static int __stdcall Jobs_Worker( void * param ) {
+    UNUSED_VARIABLE( param );
+    while( true ) {
+        Semaphore_Wait( gJobSemaphore );
+        if( gJobsQuit ) {
+            break;
+        }
+        Atomic_Increment( &gJobBusyWorkers );
+        TJobBatch * batch = gJobCurrent;
+        if( batch ) {
+            Jobs_Execute( batch );
+        }
+        Atomic_Add( &gJobBusyWorkers, -1 );
+    }
+    return 0;
+}
+
+void Jobs_Initialize( void ) {
+    gJobWorkerCount = Thread_GetProcessorCount() - 1;
+    if( gJobWorkerCount > JOBS_MAX_WORKERS ) {
+        gJobWorkerCount = JOBS_MAX_WORKERS;
+    }
+    gJobsQuit = 0;
+    gJobSemaphore = Semaphore_Create( 0x7FFFFFFF );
+    for( int i = 0; i < gJobWorkerCount; i++ ) {
+        gJobWorkers[i] = Thread_Start( Jobs_Worker, NULL );
+    }
+    Log_Write( "Job system started with %d worker(s)", gJobWorkerCount );
+}
+
+void Jobs_Shutdown( void ) {
+    if( gJobCurrent ) {
+        Jobs_Wait( gJobCurrent );
+    }
+    gJobsQuit = 1;
+    if( gJobWorkerCount ) {
+        Semaphore_Release( gJobSemaphore, gJobWorkerCount );
+    }
+    for( int i = 0; i < gJobWorkerCount; i++ ) {
+        Thread_Join( gJobWorkers[i] );
+    }
+    gJobWorkerCount = 0;
+    if( gJobSemaphore ) {
+        Semaphore_Destroy( gJobSemaphore );
+        gJobSemaphore = NULL;
+    }
+}
+
+int Jobs_GetWorkerCount( void ) {
+    return gJobWorkerCount;
+}
+
+void Jobs_Dispatch( TJobBatch * batch, TJobFunc func, void * data, int count ) {
+    // only one batch can be in flight
+    if( gJobCurrent ) {
+        Jobs_Wait( gJobCurrent );
+    }
+    if( !batch->finished ) {
+        batch->finished = Event_Create();
+    }
+    batch->func = func;
+    batch->data = data;
+    batch->count = count;
+    batch->next = 0;
+    batch->done = 0;
+    if( count <= 0 ) {
+        return;
+    }
+    gJobCurrent = batch;
+    if( gJobWorkerCount ) {
+        Semaphore_Release( gJobSemaphore, count < gJobWorkerCount ? count : gJobWorkerCount );
+    }
+}
+
+void Jobs_Wait( TJobBatch * batch ) {
+    if( gJobCurrent != batch ) {
+        return;
+    }
+    Jobs_Execute( batch );
+    // event is set exactly once per batch, even if last job was done by this thread
+    Event_WaitSingle( batch->finished );
+    gJobCurrent = NULL;
+    // worker can still hold pointer to the batch, while finding out that nothing is left
+    int spins = 0;
+    while( Atomic_Add( &gJobBusyWorkers, 0 ) > 0 ) {
+        if( ++spins < JOBS_SPIN_COUNT ) {
+            Thread_Pause();
+        } else {
+            Thread_Yield();
+        }
+    }
+}
+
+bool Jobs_IsPending( const TJobBatch * batch ) {
+    return gJobCurrent == batch;
+}
+
+void JobBatch_Free( TJobBatch * batch ) {
+    Jobs_Wait( batch );
+    if( batch->finished ) {
+        Event_Destroy( batch->finished );
+        batch->finished = NULL;
+    }
+}
+
+#define TEST_JOB_COUNT (1000)
+#define BENCHMARK_JOB_COUNT (20000)
+
+typedef struct TTestJobData {
+    float * in;
+    float * out;
+} TTestJobData;
+
+static float Test_JobWork( float x ) {
+    float sum = 0.0f;
+    for( int i = 1; i <= 100; i++ ) {
+        sum += sqrtf( x * i );
+    }
+    return sum;
+}
+
+static void Test_Job( void * data, int index ) {
+    TTestJobData * job = data;
+    job->out[index] = Test_JobWork( job->in[index] );
+}
+
+void Test_Jobs( void ) {
+    TTestJobData data;
+    data.in = Memory_NewCount( TEST_JOB_COUNT, float );
+    data.out = Memory_NewCount( TEST_JOB_COUNT, float );
+    for( int i = 0; i < TEST_JOB_COUNT; i++ ) {
+        data.in[i] = rand() % 1000;
+    }
+    TJobBatch batch = JOB_BATCH_INITIALIZER;
+    // batch is reused, as it would be every frame
+    for( int pass = 0; pass < 2; pass++ ) {
+        memset( data.out, 0, TEST_JOB_COUNT * sizeof( float ));
+        Jobs_Dispatch( &batch, Test_Job, &data, TEST_JOB_COUNT );
+        Jobs_Wait( &batch );
+        for( int i = 0; i < TEST_JOB_COUNT; i++ ) {
+            if( data.out[i] != Test_JobWork( data.in[i] )) {
+                Util_RaiseError( "Test_Jobs: result of job %d mismatch!", i );
+            }
+        }
+    }
+    JobBatch_Free( &batch );
+    Memory_Free( data.out );
+    Memory_Free( data.in );
+}
+
+void Benchmark_Jobs( void ) {
+    TTestJobData data;
+    data.in = Memory_NewCount( BENCHMARK_JOB_COUNT, float );
+    data.out = Memory_NewCount( BENCHMARK_JOB_COUNT, float );
+    for( int i = 0; i < BENCHMARK_JOB_COUNT; i++ ) {
+        data.in[i] = rand() % 1000;
+    }
+    TTimer timer;
+    Timer_Create( &timer );
+    for( int i = 0; i < BENCHMARK_JOB_COUNT; i++ ) {
+        Test_Job( &data, i );
+    }
+    double serialTime = Timer_GetElapsedMilliseconds( &timer );
+    // first pass wakes up workers, second one is measured
+    TJobBatch batch = JOB_BATCH_INITIALIZER;
+    double jobTime = 0.0;
+    for( int pass = 0; pass < 2; pass++ ) {
+        Timer_Restart( &timer );
+        Jobs_Dispatch( &batch, Test_Job, &data, BENCHMARK_JOB_COUNT );
+        Jobs_Wait( &batch );
+        jobTime = Timer_GetElapsedMilliseconds( &timer );
+    }
+    printf( "Jobs: %d jobs on %d worker(s) + main thread: serial %.3f ms, jobs %.3f ms\n", BENCHMARK_JOB_COUNT, gJobWorkerCount, serialTime, jobTime );
+    JobBatch_Free( &batch );
+    Memory_Free( data.out );
+    Memory_Free( data.in );
+}
@@ -0,0 +1,43 @@
+#ifndef _JOBS_
+#define _JOBS_
+
+#include "common.h"
+#include "thread.h"
+
+OLDTECH_BEGIN_HEADER
+
+// function of job, 'index' is number of job in its batch
+typedef void (*TJobFunc)( void * data, int index );
+
+// group of jobs executed by worker threads, only one batch can be in flight at a time
+typedef struct TJobBatch {
+    TJobFunc func;
+    void * data;
+    int count;
+    volatile long next; // next job to take
+    volatile long done; // count of finished jobs
+    TEvent finished;
+} TJobBatch;
+
+#define JOB_BATCH_INITIALIZER { NULL, NULL, 0, 0, 0, NULL }
+
+// starts one worker per processor except the one used by main thread
+void Jobs_Initialize( void );
+void Jobs_Shutdown( void );
+int Jobs_GetWorkerCount( void );
+// starts func( data, i ) for i in [0, count) on workers and returns immediately
+void Jobs_Dispatch( TJobBatch * batch, TJobFunc func, void * data, int count );
+// main thread helps to execute remaining jobs of batch and waits for the rest
+void Jobs_Wait( TJobBatch * batch );
+// true if batch was dispatched and not waited yet
+bool Jobs_IsPending( const TJobBatch * batch );
+void JobBatch_Free( TJobBatch * batch );
+
+// tests
+void Test_Jobs( void );
+// prints time of batch on workers against serial execution on main thread
+void Benchmark_Jobs( void );
+
+OLDTECH_END_HEADER
+
+#endif
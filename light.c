@@ -1,9 +1,24 @@
 #include "light.h"
 #include "lightmap.h"
+#include "entity.h"
 
 TList g_lights = { NULL, NULL, 0 };
 TVec3 gAmbientLight = { 0.075f, 0.075f, 0.075f };
 
+// attenuation of a light falls below 1/255 at this distance in radii
+#define LIGHT_INFLUENCE_RADIUS_SCALE (15.0f)
+// lights are rarely moved, so margin is small
+#define LIGHT_TREE_MARGIN (0.5f)
+
+static TSpatialTree gLightTree = { NULL, 0, SPATIAL_NULL, SPATIAL_NULL, 0, LIGHT_TREE_MARGIN };
+
+static void Light_GetBounds( TLight * light, TVec3 * min, TVec3 * max ) {
+    float influence = light->radius * LIGHT_INFLUENCE_RADIUS_SCALE;
+    TVec3 extent = Vec3_Set( influence, influence, influence );
+    *min = Vec3_Sub( light->owner->globalPosition, extent );
+    *max = Vec3_Add( light->owner->globalPosition, extent );
+}
+
 void Light_CreatePoint( TLight * light, struct TEntity * owner, TVec3 * color, float radius ) {
     light->owner = owner;
     light->type = LT_POINT;
@@ -13,9 +28,40 @@ void Light_CreatePoint( TLight * light, struct TEntity * owner, TVec3 * color, f
     light->outerAngle = 1.0f;
     light->color = *color;
     List_Create( &light->affectedAtlasList );
+    Light_Register( light );
+}
+
+void Light_Register( TLight * light ) {
+    TVec3 min, max;
+    Light_GetBounds( light, &min, &max );
+    light->spatialProxy = SpatialTree_Insert( &gLightTree, &min, &max, light );
     List_Add( &g_lights, light );
 }
 
+void Light_UpdateAll( void ) {
+    for_each( TLight, light, g_lights ) {
+        TVec3 min, max;
+        Light_GetBounds( light, &min, &max );
+        SpatialTree_Move( &gLightTree, light->spatialProxy, &min, &max );
+    }
+}
+
+static float Light_CenterDistance( void * data, const TVec3 * point, void * userData ) {
+    UNUSED_VARIABLE( userData );
+    return Vec3_Distance( ((TLight*)data)->owner->globalPosition, *point );
+}
+
+TLight * Light_FindNearest( const TVec3 * point ) {
+    void * nearest = NULL;
+    float distance;
+    SpatialTree_QueryNearest( &gLightTree, point, 1, Light_CenterDistance, NULL, &nearest, &distance );
+    return nearest;
+}
+
+void Light_ForEachAffecting( const TVec3 * point, TSpatialQueryFunc func, void * userData ) {
+    SpatialTree_QuerySphere( &gLightTree, point, 0.0f, func, userData );
+}
+
 void Light_SetEnabled( TLight * light, bool state ) {
     if( light->enabled != state ) {
         light->enabled = state;
@@ -3,6 +3,7 @@
 
 #include "vector3.h"
 #include "list.h"
+#include "spatial.h"
 
 typedef enum {
     LT_POINT,
@@ -19,10 +20,19 @@ typedef struct SLight {
     float innerAngle;
     float outerAngle;
     TList affectedAtlasList; // list of lightmap atlases
+    int spatialProxy; // proxy in light tree, SPATIAL_NULL if light isn't registered
 } TLight;
 
 void Light_CreatePoint( TLight * light, struct TEntity * owner, TVec3 * color, float radius );
 void Light_SetEnabled( TLight * light, bool state ); // use this to enable\disable light, do not use 'enabled' field of TLight
+// adds light to 'g_lights' and to the light tree
+void Light_Register( TLight * light );
+// moves proxies of lights whose owners have moved, call after transforms are updated
+void Light_UpdateAll( void );
+// returns light with nearest center or NULL
+TLight * Light_FindNearest( const TVec3 * point );
+// reports lights which can light the point, light is passed as 'data'
+void Light_ForEachAffecting( const TVec3 * point, TSpatialQueryFunc func, void * userData );
 
 extern TList g_lights;
 extern TVec3 gAmbientLight;
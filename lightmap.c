@@ -184,7 +184,7 @@ float Lightmap_CalculateAttenuation( const TVec3 * src, const TVec3 * dst, float
     return 1.0f / ( 1.0f + linearCoeff + quadCoeff );
 }
 
-void Lightmap_Build( const TVec3 * offset, TLightmap * lm, TVertex * a, TVertex * b, TVertex * c, int faceID, int threadNum ) {
+void Lightmap_Build( const TVec3 * offset, TLightmap * lm, TVertex * a, TVertex * b, TVertex * c, int faceID ) {
     lm->a = a;
     lm->b = b;
     lm->c = c;
@@ -294,8 +294,9 @@ void Lightmap_Build( const TVec3 * offset, TLightmap * lm, TVertex * a, TVertex
     
     List_Create( &lm->layers );
     
-    TLightmapLayer * tempLayer = (TLightmapLayer*)malloc( sizeof( TLightmapLayer ) );
-    tempLayer->pixels = (TRGBAPixel*)malloc( lm->width * lm->height * sizeof( TRGBAPixel ) );    
+    TScratchMark mark = Scratch_GetMark();
+    TLightmapLayer * tempLayer = Scratch_New( TLightmapLayer );
+    tempLayer->pixels = Scratch_Allocate( lm->width * lm->height * sizeof( TRGBAPixel ) );    
     
     // precalculate coefficients for barycentric method for speedup (~2% ffs!)
     TUVTriangle precalcBary;    
@@ -349,26 +350,23 @@ void Lightmap_Build( const TVec3 * offset, TLightmap * lm, TVertex * a, TVertex
                 
                 // if pixel is bright enough, do shadows. this optimization gives 30% boost
                 if( attenuation > blackThreshold ) {
-                    TRayTraceResult rtResult;
-                    TRay ray = Ray_SetDirection( light->owner->globalPosition, Vec3_Scale( direction, -99999.0f ));
+                    TRay ray = Ray_Set( light->owner->globalPosition, worldPosition );
                     // ray tracing using collision detection engine to detect intersections, so objects
                     // with collision body can cast shadows, otherwise no shadow will be generated
                     // also this raytracing could not able to detect alpha channel in texture
                     // so if you want to generate proper shadow, i.e. from a mesh, you need to create
                     // it with polygons, not texture with alpha channel, this bug must be fixed somehow
-                   
-                    if( threadNum >= 0 ) {
-                        Ray_TraceWorldStaticMultithreaded( &ray, &rtResult, threadNum ); 
-                    } else {
-                        Ray_TraceWorldStatic( &ray, &rtResult );  
-                    }       
+                    
+                    // segment ends a bit before the pixel, so its own surface doesn't shadow it.
+                    // bias is in squared distance, as it was with closest hit search
                     const float shadowBias = 0.75f;
-                    if( rtResult.body ) {
-                        if( fabsf( Vec3_SqrDistance( light->owner->globalPosition, rtResult.position ) - 
-                                   Vec3_SqrDistance( light->owner->globalPosition, worldPosition )) > shadowBias ){
+                    float sqrDistance = Vec3_SqrDistance( light->owner->globalPosition, worldPosition );
+                    if( sqrDistance > shadowBias ) {
+                        float tmax = sqrtf(( sqrDistance - shadowBias ) / sqrDistance );
+                        if( Ray_Occluded( &ray, 0.0f, tmax )) {
                             attenuation = 0.0f;
-                        } 
-                    }     
+                        }
+                    }
                 }
 
                 TVec3 diffuseColor = Vec3_Scale( light->color, attenuation * constantBrightnessMultiplier );
@@ -393,32 +391,32 @@ void Lightmap_Build( const TVec3 * offset, TLightmap * lm, TVertex * a, TVertex
         }      
     }
     
-    free( tempLayer->pixels );
-    free( tempLayer );
+    Scratch_Rewind( mark );
     
     // blur final lightmap 
     Lightmap_Blur( lm, borderSize );
 }
 
 void LightmapAtlas_Free( TLightmapAtlas * atlas ) {
+    Pool_Free( &atlas->nodePool );
     Memory_Free( atlas->texture.pixels );
     Memory_Free( atlas );
 }
 
-TPackerNode * LightmapPacker_CreateNode( TPackerNode * parent ) {
-    TPackerNode * node = Memory_New( TPackerNode );
+TPackerNode * LightmapPacker_CreateNode( TLightmapAtlas * atlas, TPackerNode * parent ) {
+    TPackerNode * node = Pool_New( &atlas->nodePool, TPackerNode );
     node->faceIndex = -1;
     node->parent = parent;
     return node;
 }
 
-TPackerNode * LightmapPacker_FindPlaceToInsert( TPackerNode * node, TLightmap * lm ) {
+TPackerNode * LightmapPacker_FindPlaceToInsert( TLightmapAtlas * atlas, TPackerNode * node, TLightmap * lm ) {
     if( node->split ) {
-        TPackerNode * newNode = LightmapPacker_FindPlaceToInsert( node->childs[0], lm );
+        TPackerNode * newNode = LightmapPacker_FindPlaceToInsert( atlas, node->childs[0], lm );
         if( newNode ) {
             return newNode;
         } else {
-            return LightmapPacker_FindPlaceToInsert( node->childs[1], lm );
+            return LightmapPacker_FindPlaceToInsert( atlas, node->childs[1], lm );
         }
     } else {
         if( node->lm ) {
@@ -436,8 +434,8 @@ TPackerNode * LightmapPacker_FindPlaceToInsert( TPackerNode * node, TLightmap *
             return node;
         }        
         
-        node->childs[0] = LightmapPacker_CreateNode( node );
-        node->childs[1] = LightmapPacker_CreateNode( node );
+        node->childs[0] = LightmapPacker_CreateNode( atlas, node );
+        node->childs[1] = LightmapPacker_CreateNode( atlas, node );
         
         float dw = node->rect.w - lm->width;
         float dh = node->rect.h - lm->height;
@@ -466,7 +464,7 @@ TPackerNode * LightmapPacker_FindPlaceToInsert( TPackerNode * node, TLightmap *
         
         node->split = true;
         
-        return LightmapPacker_FindPlaceToInsert( node->childs[0], lm );
+        return LightmapPacker_FindPlaceToInsert( atlas, node->childs[0], lm );
     }
     
     return NULL;
@@ -501,6 +499,7 @@ TTexture * LightmapPacker_PackLightmaps( TSurface * surface, TLightmap * lightma
     TLightmapAtlas * atlas = Memory_New( TLightmapAtlas );
     List_Add( &gLightmapAtlasList, atlas );
     List_Create( &atlas->nodes );
+    Pool_Create( &atlas->nodePool, sizeof( TPackerNode ), 256, false );
     // create atlas texture
     int fixedSize = LightmapPacker_ComputeAtlasSize( surface, lightmaps, faceOffset );
     if( fixedSize > 2048 ) { // works well even on GMA3150, but can fail on older hardware
@@ -563,7 +562,7 @@ TTexture * LightmapPacker_PackLightmaps( TSurface * surface, TLightmap * lightma
             }
         }
         
-        TPackerNode * node = LightmapPacker_FindPlaceToInsert( &atlas->root, lm );
+        TPackerNode * node = LightmapPacker_FindPlaceToInsert( atlas, &atlas->root, lm );
         // if enough space in atlas, add current face's lightmap to the atlas
         if( node ) {   
             surface->lightmapFaceCount[currentLightmapIndex]++;
@@ -662,24 +661,30 @@ void Lightmap_PrepareSurface( TSurface * surf ) {
 // common status var of all threads
 // this vars must be volatile, otherwise compiler (with -On) gonna "optimize" code with it, and ruins everything
 volatile int gThreadsStopped = false;
-volatile TMTGenInfo lmMTGenInfo[OCTREE_MAX_SIMULTANEOUS_THREADS] = { {0} };
-TEvent gDataReadyEvent[OCTREE_MAX_SIMULTANEOUS_THREADS] = {0};
-TEvent gGenerationDoneEvent[OCTREE_MAX_SIMULTANEOUS_THREADS] = {0};
+// WaitForMultipleObjects can't wait for more events
+#define LIGHTMAP_MAX_THREADS (64)
+
+volatile TMTGenInfo lmMTGenInfo[LIGHTMAP_MAX_THREADS] = { {0} };
+TEvent gDataReadyEvent[LIGHTMAP_MAX_THREADS] = {0};
+TEvent gGenerationDoneEvent[LIGHTMAP_MAX_THREADS] = {0};
 
 // main function to generate lightmaps in multithreaded mode
 // ptr points on the thread number
 int __stdcall Lightmap_Thread_BuildLightmap( void * ptr ) {
     int threadNum = *((int*)ptr);    
+    // tag stack is per-thread, so worker must tag its own allocations
+    Memory_PushTag( MEMORY_TAG_LIGHTMAP );
     while( !gThreadsStopped ) {
         Event_WaitSingle( gDataReadyEvent[threadNum] );        
         if( !gThreadsStopped ) {
             Event_Reset( gGenerationDoneEvent[threadNum] );
             Lightmap_Build( lmMTGenInfo[threadNum].offset, lmMTGenInfo[threadNum].lm, lmMTGenInfo[threadNum].a, 
-                            lmMTGenInfo[threadNum].b, lmMTGenInfo[threadNum].c, lmMTGenInfo[threadNum].faceNum, threadNum ); 
+                            lmMTGenInfo[threadNum].b, lmMTGenInfo[threadNum].c, lmMTGenInfo[threadNum].faceNum ); 
             Event_Reset( gDataReadyEvent[ threadNum ] );            
         }
         Event_Set( gGenerationDoneEvent[ threadNum ] );
     }
+    Memory_PopTag();
     Event_Set( gGenerationDoneEvent[ threadNum ] );
     return 0;
 }
@@ -689,10 +694,15 @@ void Lightmap_BuildForSurfaceMultithreaded( TSurface * surf, TVec3 * offset, int
 
     Log_Write( "Lightmapper: - Generating lightmap for surface %d of %d in multithreaded mode...", surfNum, totalSurfaces );
     
-    int threadNums[ OCTREE_MAX_SIMULTANEOUS_THREADS ] = { 0 };
+    // ray tracing keeps no per-thread data, so one thread per processor
+    int threadCount = Thread_GetProcessorCount();
+    if( threadCount > LIGHTMAP_MAX_THREADS ) {
+        threadCount = LIGHTMAP_MAX_THREADS;
+    }
+    int threadNums[ LIGHTMAP_MAX_THREADS ] = { 0 };
     // start threads
     gThreadsStopped = false;
-    for( int i = 0; i < OCTREE_MAX_SIMULTANEOUS_THREADS; i++ ) {
+    for( int i = 0; i < threadCount; i++ ) {
         // create events first
         gDataReadyEvent[i] = Event_Create();
         gGenerationDoneEvent[i] = Event_Create();
@@ -713,7 +723,7 @@ void Lightmap_BuildForSurfaceMultithreaded( TSurface * surf, TVec3 * offset, int
         TVertex * c = &surf->vertices[ face->index[ 2 ]];
         
         // wait until we get free thread for generation
-        int freeThreadNum = Event_WaitMultiple( OCTREE_MAX_SIMULTANEOUS_THREADS, gGenerationDoneEvent );  
+        int freeThreadNum = Event_WaitMultiple( threadCount, gGenerationDoneEvent );  
         
         // prepare data for the thread
         lmMTGenInfo[freeThreadNum].lm = &lightmaps[i];
@@ -728,21 +738,21 @@ void Lightmap_BuildForSurfaceMultithreaded( TSurface * surf, TVec3 * offset, int
     }
             
     // wait for gen done
-    for( int i = 0; i < OCTREE_MAX_SIMULTANEOUS_THREADS; i++ ) {
+    for( int i = 0; i < threadCount; i++ ) {
         Event_WaitSingle( gGenerationDoneEvent[i] );
     }    
     // stop threads 
     gThreadsStopped = true;
-    for( int i = 0; i < OCTREE_MAX_SIMULTANEOUS_THREADS; i++ ) {
+    for( int i = 0; i < threadCount; i++ ) {
         Event_Set( gDataReadyEvent[i] );
     } 
     // wait for exiting threads
-    for( int i = 0; i < OCTREE_MAX_SIMULTANEOUS_THREADS; i++ ) {
+    for( int i = 0; i < threadCount; i++ ) {
         Event_WaitSingle( gGenerationDoneEvent[i] );
         Log_Write( "Lightmapper: - Thread %d exited successfully!", i );
     }
     // destroy events
-    for( int i = 0; i < OCTREE_MAX_SIMULTANEOUS_THREADS; i++ ) {
+    for( int i = 0; i < threadCount; i++ ) {
         Event_Destroy( gDataReadyEvent[i] );
         Event_Destroy( gGenerationDoneEvent[i] );
     } 
@@ -905,6 +915,7 @@ bool LightmapAtlas_LoadSurfaceAtlases( TEntity * root, TSurface * surface, const
     for( int i = 0; i < surface->lightmapCount; i++ ) {        
         // create and load atlas 
         TLightmapAtlas * atlas = Memory_AllocateClean( sizeof( TLightmapAtlas ));
+        Pool_Create( &atlas->nodePool, sizeof( TPackerNode ), 256, false );
         
         atlas->texture.width = Buffer_ReadInteger( &input );
         atlas->texture.height = Buffer_ReadInteger( &input );
@@ -919,7 +930,7 @@ bool LightmapAtlas_LoadSurfaceAtlases( TEntity * root, TSurface * surface, const
         surface->lightmapFaceCount[i] = nodeCount;
         
         for( int i = 0; i < nodeCount; i++ ) {
-            TPackerNode * node = Memory_New( TPackerNode );
+            TPackerNode * node = Pool_New( &atlas->nodePool, TPackerNode );
             
             // read node metrics
             node->rect.x = Buffer_ReadInteger( &input );
@@ -975,4 +986,65 @@ bool LightmapAtlas_LoadSurfaceAtlases( TEntity * root, TSurface * surface, const
     Buffer_Free( &input );   
     
     return true;
-}
\ No newline at end of file
+}
+#define BENCHMARK_LIGHTMAP_BUILD_COUNT (200)
+
+void Benchmark_Lightmap( void ) {
+    // single light in place of lights of the level, so only allocations of bake are counted
+    TList savedLights = g_lights;
+    List_Create( &g_lights );
+    TEntity * owner = Memory_New( TEntity );
+    owner->globalPosition = Vec3_Set( 4.0f, 3.0f, 4.0f );
+    TLight light = { 0 };
+    light.owner = owner;
+    light.type = LT_POINT;
+    light.brightness = 1.0f;
+    light.radius = 10.0f;
+    light.color = Vec3_Set( 1.0f, 1.0f, 1.0f );
+    List_Add( &g_lights, &light );
+    // floor triangles of different size give lightmaps of different size
+    TVertex * vertices = Memory_NewCount( BENCHMARK_LIGHTMAP_BUILD_COUNT * 3, TVertex );
+    TLightmap * lightmaps = Memory_NewCount( BENCHMARK_LIGHTMAP_BUILD_COUNT, TLightmap );
+    for( int i = 0; i < BENCHMARK_LIGHTMAP_BUILD_COUNT; i++ ) {
+        float size = 1.0f + i % 16;
+        TVertex * v = vertices + i * 3;
+        v[1].p = Vec3_Set( size, 0.0f, 0.0f );
+        v[2].p = Vec3_Set( 0.0f, 0.0f, size );
+        for( int k = 0; k < 3; k++ ) {
+            v[k].n = Vec3_Set( 0.0f, 1.0f, 0.0f );
+        }
+    }
+    TVec3 offset = Vec3_Zero();
+    TMemorySnapshot before, after, diff;
+    Memory_TakeSnapshot( &before );
+    int scratchAllocations = Scratch_GetAllocationCount();
+    TTimer timer;
+    Timer_Create( &timer );
+    for( int i = 0; i < BENCHMARK_LIGHTMAP_BUILD_COUNT; i++ ) {
+        TVertex * v = vertices + i * 3;
+        Lightmap_Build( &offset, lightmaps + i, v, v + 1, v + 2, i );
+    }
+    double time = Timer_GetElapsedMilliseconds( &timer );
+    scratchAllocations = Scratch_GetAllocationCount() - scratchAllocations;
+    Memory_TakeSnapshot( &after );
+    Memory_DiffSnapshots( &before, &after, &diff );
+    int allocations = 0;
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        allocations += diff.tags[ tag ].totalAllocations;
+    }
+    // every allocation from arena was done by allocator before
+    printf( "Lightmap: %d builds in %.3f ms: %.2f allocator calls per build, %.2f before scratch arena\n", BENCHMARK_LIGHTMAP_BUILD_COUNT, time,
+        (float)allocations / BENCHMARK_LIGHTMAP_BUILD_COUNT, (float)( allocations + scratchAllocations ) / BENCHMARK_LIGHTMAP_BUILD_COUNT );
+    for( int i = 0; i < BENCHMARK_LIGHTMAP_BUILD_COUNT; i++ ) {
+        for_each( TLightmapLayer, layer, lightmaps[i].layers ) {
+            Memory_Free( layer->pixels );
+            Memory_Free( layer );
+        }
+        List_Free( &lightmaps[i].layers );
+    }
+    Memory_Free( lightmaps );
+    Memory_Free( vertices );
+    Memory_Free( owner );
+    List_Free( &g_lights );
+    g_lights = savedLights;
+}
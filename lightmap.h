@@ -5,6 +5,7 @@
 #include "Vertex.h"
 #include "Texture.h"
 #include "lightprobe.h"
+#include "pool.h"
 
 
 typedef enum {
@@ -54,6 +55,8 @@ typedef struct TLightmap {
 typedef struct TLightmapAtlas {
     TPackerNode root; // main atlas hierarchy
     TList nodes;
+    // all packer nodes of atlas
+    TPool nodePool;
     TTexture texture;
     struct TSurface * surface;
     bool modified;
@@ -93,8 +96,8 @@ void Lightmap_Map3DPointTo2DByPlane( int plane, const TVec3 * point, TVector2 *
 void Lightmap_Blur( TLightmap * lm, const int borderSize );
 float Lightmap_CalculateAttenuation( const TVec3 * src, const TVec3 * dst, float radius, TVec3 * outDir );
 
-// threadNum >= 0 - use MT version, other - use singlethreaded
-void Lightmap_Build( const TVec3 * offset, TLightmap * lm, TVertex * a, TVertex * b, TVertex * c, int faceID, int threadNum );
+// can be called from any thread
+void Lightmap_Build( const TVec3 * offset, TLightmap * lm, TVertex * a, TVertex * b, TVertex * c, int faceID );
 
 // basic function to generate lightmap for surface
 void Lightmap_BuildForSurfaceMultithreaded( struct TSurface * surf, TVec3 * offset, int surfNum, int totalSurfaces );
@@ -105,6 +108,9 @@ bool LightmapAtlas_LoadSurfaceAtlases( struct TEntity * root, struct TSurface *
 void LightmapAtlas_Update( TLightmapAtlas * atlas, TLight * light );
 void LightmapAtlas_Free( TLightmapAtlas * atlas );
 
+// prints allocator calls per Lightmap_Build with and without scratch arena
+void Benchmark_Lightmap( void );
+
 
 
 #endif
\ No newline at end of file
@@ -6,19 +6,16 @@
 void LightProbe_BuildRegularArray( TEntity * volumeEntity, float density ) {
     TVec3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
     TVec3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
-    for_each( TEntity, child, volumeEntity->childs ) {
-        if( child->surfaces.size ) {
-            for_each( TSurface, surface, child->surfaces ) {
-                for( int i = 0; i < surface->vertexCount; i++ ) {
-                    TVec3 * vp = &surface->vertices[i].p;
-                    if( vp->x < min.x ) min.x = vp->x;                
-                    if( vp->y < min.y ) min.y = vp->y;                
-                    if( vp->z < min.z ) min.z = vp->z;
-                    if( vp->x > max.x ) max.x = vp->x;                
-                    if( vp->y > max.y ) max.y = vp->y;
-                    if( vp->z > max.z ) max.z = vp->z;
-                }
-            }
+    // childs can be nested, so surfaces of the whole scene are taken
+    for_each( TSurface, surface, volumeEntity->allSurfaces ) {
+        for( int i = 0; i < surface->vertexCount; i++ ) {
+            TVec3 * vp = &surface->vertices[i].p;
+            if( vp->x < min.x ) min.x = vp->x;                
+            if( vp->y < min.y ) min.y = vp->y;                
+            if( vp->z < min.z ) min.z = vp->z;
+            if( vp->x > max.x ) max.x = vp->x;                
+            if( vp->y > max.y ) max.y = vp->y;
+            if( vp->z > max.z ) max.z = vp->z;
         }
     }
     TVec3 bounds = Vec3_Sub( max, min );
@@ -49,14 +46,31 @@ void Lightprobe_LightEntity( TEntity * entity ) {
 }
 
 
+typedef struct TLightProbeSum {
+    TVec3 point;
+    TVec3 color;
+} TLightProbeSum;
+
+static bool LightProbe_AddLight( void * data, void * userData ) {
+    TLight * light = data;
+    TLightProbeSum * sum = userData;
+    float attenuation = Lightmap_CalculateAttenuation( &light->owner->globalPosition, &sum->point, light->radius, NULL );
+    sum->color = Vec3_Add( sum->color, Vec3_Scale( light->color, attenuation ));
+    return true;
+}
+
+// sums attenuated color of lights which reach the point
+static TVec3 LightProbe_Gather( const TVec3 * point, TVec3 color ) {
+    TLightProbeSum sum;
+    sum.point = *point;
+    sum.color = color;
+    Light_ForEachAffecting( point, LightProbe_AddLight, &sum );
+    return sum.color;
+}
+
 void LightProbe_Calculate() {
     for_each( TLightProbe, lp, gLightProbeList ) {
-        for_each( TLight, light, g_lights ) {          
-            TVec3 direction;
-            float attenuation = Lightmap_CalculateAttenuation( &light->owner->globalPosition, &lp->position, light->radius, &direction );
-            lp->color = Vec3_Add( lp->color, Vec3_Scale( light->color, attenuation ) );            
-        }
-        lp->color = Vec3_Clamp( lp->color, 0.0f, 1.0f );
+        lp->color = Vec3_Clamp( LightProbe_Gather( &lp->position, lp->color ), 0.0f, 1.0f );
     }
 }
 
@@ -75,13 +89,7 @@ TLightProbe * LightProbe_Trace( const TVec3 * point ) {
     return nearest;
     */
     
-    probe.color = Vec3_Zero();
-    for_each( TLight, light, g_lights ) {
-        TVec3 dir;
-        float attenuation = Lightmap_CalculateAttenuation( point, &light->owner->globalPosition, light->radius, &dir );
-        probe.color = Vec3_Add( probe.color, Vec3_Scale( light->color, attenuation ));
-    }
-    probe.color = Vec3_Clamp( probe.color, 0.0, 1.0 );
+    probe.color = Vec3_Clamp( LightProbe_Gather( point, Vec3_Zero() ), 0.0, 1.0 );
     return &probe;
 }
 
@@ -77,10 +77,10 @@ void List_RemoveNth( TList * list, int n, char freeData ) {
                     list->tail = NULL;
                 }
             }
-            Memory_Free( current );
             if( freeData ) {
                 Memory_Free( current->data );
             }
+            Memory_Free( current );
             list->size--;
             break;
         }
@@ -101,6 +101,8 @@ void List_Clear( TList * list, char freeData ) {
         Memory_Free( current );
         current = next;
     }
+    list->head = NULL;
+    list->tail = NULL;
     list->size = 0;
 }
 
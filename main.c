@@ -14,10 +14,16 @@
 #include "map.h"
 #include "script.h"
 #include "array.h"
+#include "transform.h"
+#include "skin.h"
+#include "jobs.h"
 #include "gui.h"
 #include "font.h"
 #include "mainmenu.h"
 #include "monster.h"
+#include "spatial.h"
+#include "frameclock.h"
+#include "collision.h"
 TGUINode * testRect = 0;
 
 void TestHandler( void ) {
@@ -26,7 +32,31 @@ void TestHandler( void ) {
 
 
 int main( int argc, char * argv[] ) {
+    Scratch_Initialize();
+    Jobs_Initialize();
     Test_Array();
+    Test_HashMap();
+    Test_TransformBatch();
+    Test_Skinning();
+    Test_Jobs();
+    Test_AnimationTrack();
+    Test_Prefab();
+    Test_SpatialTree();
+    Test_Broadphase();
+    Test_Bvh();
+#ifdef _BENCHMARK_
+    // timings against previous implementations, too slow for every launch
+    Benchmark_HashMap();
+    Benchmark_TransformBatch();
+    Benchmark_Skinning();
+    Benchmark_Jobs();
+    Benchmark_AnimationTrack();
+    Benchmark_Prefab();
+    Benchmark_SpatialTree();
+    Benchmark_Broadphase();
+    Benchmark_Bvh();
+    Benchmark_Lightmap();
+#endif
     
     UNUSED_VARIABLE( argc );
     UNUSED_VARIABLE( argv );
@@ -55,13 +85,15 @@ int main( int argc, char * argv[] ) {
 
     float gameLogicTime = 0;
     int fps = 0, fpsCounter = 0;
-
-    TTimer gameTimer;
-    Timer_Create( &gameTimer );
+    // allocations of main thread from scratch arena, each one was an allocator call before it
+    int frameScratchAllocations = 0, lastScratchAllocations = 0;
 
     double fixedFPS = 60.0;
     double fixedTimeStep = 1.0 / fixedFPS;
-    double gameClock = Timer_GetSeconds( &gameTimer );
+    // after a hitch game slows down instead of running unbounded count of steps
+    const int maxStepsPerFrame = 5;
+    TFrameClock frameClock;
+    FrameClock_Create( &frameClock, fixedFPS, maxStepsPerFrame );
 
     Input_SetPointerVisible( true );    
     Script_ExecuteFile( "autoexec.lua" );        
@@ -76,28 +108,31 @@ int main( int argc, char * argv[] ) {
             break;
         }     
         
+        // nothing allocated from scratch arena lives longer than a frame
+        Scratch_Reset();
+        
         if( Input_IsKeyHit( KEY_Esc ) ) {
             MainMenu_SetVisible( !menu->visible );
         }
            
-        Renderer_BeginRender();
+        // world is drawn between two last simulated states
+        Renderer_BeginRender( FrameClock_GetAlpha( &frameClock ));
 		Renderer_RenderWorld( );
 		
-        double dt = Timer_GetSeconds( &gameTimer ) - gameClock;
+        int steps = FrameClock_BeginFrame( &frameClock );
         
         Timer_Restart( &perfTimer );
-        while( dt >= fixedTimeStep ) {
-            dt -= fixedTimeStep;
-            gameClock += fixedTimeStep;
-            
+        for( int step = 0; step < steps; step++ ) {
             Input_Flush(); 
             Renderer_PollWindowMessages( ); 
             
+            // saved even when paused, so paused world isn't interpolated
+            World_SaveState();
             if( !menu->visible ) {
                 Dynamics_StepSimulation();                                                 
                 Player_Update( fixedTimeStep );
                 Monster_ThinkAll();
-                World_Update();
+                World_Update( fixedTimeStep );
             }
             
             if( Input_IsKeyHit( KEY_1 )) {
@@ -107,15 +142,28 @@ int main( int argc, char * argv[] ) {
                 Renderer_SetTextureFiltration( TF_ANISOTROPIC );
             }
             Script_CallFunction( "Main_FixedTimeUpdate", "" );
-            
-            gameLogicTime += Timer_GetElapsedMilliseconds( &perfTimer );
         }
+        gameLogicTime += Timer_GetElapsedMilliseconds( &perfTimer );
         
         Renderer_EndRender( );
+        
+        Memory_UpdateFrameStats();
+        int scratchAllocations = Scratch_GetAllocationCount();
+        frameScratchAllocations = scratchAllocations - lastScratchAllocations;
+        lastScratchAllocations = scratchAllocations;
  
         if( Timer_GetElapsedSeconds( &fpsTimer ) >= 1.0 ) {
             fps = fpsCounter;
-            GUI_SetNodeText( fpsText, Std_Format( "FPS: %d\nPRT:%.2f ms", fps, gameLogicTime / fixedFPS ));
+            const TAnimationStats * animStats = World_GetAnimationStats();
+            TMemorySnapshot frameMemory;
+            Memory_TakeSnapshot( &frameMemory );
+            int frameAllocations = 0;
+            for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+                frameAllocations += frameMemory.tags[ tag ].frameAllocations;
+            }
+            GUI_SetNodeText( fpsText, Std_Format( "FPS: %d\nPRT:%.2f ms, dropped %d steps\nSkin: %d verts, skipped %d invisible, %d decimated\nAlloc: %d per frame, %d from scratch", fps, gameLogicTime / fixedFPS,
+                frameClock.droppedSteps, animStats->skinnedVertices, animStats->skippedInvisibleVertices, animStats->skippedDecimatedVertices,
+                frameAllocations, frameScratchAllocations ));
             Timer_Restart( &fpsTimer );
             gameLogicTime = 0;
             fpsCounter = 0;
@@ -123,13 +171,20 @@ int main( int argc, char * argv[] ) {
 
         fpsCounter++;
     };
+    TMemorySnapshot memorySnapshot;
+    Memory_TakeSnapshot( &memorySnapshot );
+    Memory_DumpSnapshot( &memorySnapshot, "Memory usage before shutdown" );
     ScriptSystem_Shutdown();
     Monster_FreeAll( );
     Player_Free( );
     Entity_FreeAll( );
+    Jobs_Shutdown();
     SoundSystem_Free( &soundSystem );
     Renderer_Shutdown();
+    Atom_FreeAll();
     Log_Write( "Dynamic memory still allocated: %d bytes... Collecting garbage...", Memory_GetAllocated() );
+    Memory_TakeSnapshot( &memorySnapshot );
+    Memory_DumpSnapshot( &memorySnapshot, "Memory leaked by subsystems" );
     // memory cleanup 
 	Log_Close( &g_log );
     Memory_CollectGarbage();	
@@ -20,16 +20,22 @@ TMap * Map_LoadFromFile( const char * fileName ) {
         Util_RaiseError( "Unable to find 'Polygon' entity in map '%s'. It must be in every map loaded in this engine!", fileName );
     }
     
+    Memory_PushTag( MEMORY_TAG_COLLISION );
     TCollisionShape * polygonShape = Memory_New( TCollisionShape );
     Shape_PolygonFromSurfaces( polygonShape, &map->body->surfaces );
+#ifdef _BENCHMARK_COLLISION_
+    Bvh_Benchmark( polygonShape->triangles, polygonShape->triangleCount );
+#endif
 
     TBody * polygonBody = Memory_New( TBody );
     Body_Create( polygonBody, polygonShape );
     Dynamics_AddBody( polygonBody );
+    Memory_PopTag();
     
     TTimer timer; 
     Timer_Create( &timer );
     
+    Memory_PushTag( MEMORY_TAG_LIGHTMAP );
     // try to load lightmap from cache    
     bool loadingFailed = false;   
     int surfaceNum = 0;   
@@ -54,6 +60,7 @@ TMap * Map_LoadFromFile( const char * fileName ) {
     } else {
         Log_Write( "Lightmap loading time: %.2f seconds", Timer_GetElapsedSeconds( &timer ));
     }
+    Memory_PopTag();
     
     //LightProbe_BuildRegularArray( map->root, 3.0f );
     //LightProbe_Calculate();
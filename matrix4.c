@@ -1,5 +1,9 @@
 #include "matrix4.h"
 
+#ifdef OLDTECH_SSE
+#   include <xmmintrin.h>
+#endif
+
 TMatrix4 Matrix4_Identity( void ) {
     return (TMatrix4) { .f[0] = 1.0f, .f[5] = 1.0f, .f[10] = 1.0f, .f[15] = 1.0f };
 }
@@ -35,15 +39,50 @@ TMatrix4 Matrix4_Scale( TVec3 v ) {
     return (TMatrix4) { .f[0] = v.x, .f[5] = v.y, .f[10] = v.z, .f[15] = 1.0f };
 }
 
-TMatrix4 Matrix4_Multiply( TMatrix4 a, TMatrix4 b ) {
+TMatrix4 Matrix4_ComposeTransform( TVec3 s, TQuaternion q, TVec3 v ) {
+    TMatrix4 out = Matrix4_SetRotationOrigin( q, v );
+    // scale on the left side affects only rows of rotation part
+    out.f[0] *= s.x; out.f[1] *= s.x; out.f[2] *= s.x;
+    out.f[4] *= s.y; out.f[5] *= s.y; out.f[6] *= s.y;
+    out.f[8] *= s.z; out.f[9] *= s.z; out.f[10] *= s.z;
+    return out;
+}
+
+void Matrix4_MultiplyTo( const TMatrix4 * a, const TMatrix4 * b, TMatrix4 * out ) {
+#ifdef OLDTECH_SSE
+    // each row of result is linear combination of rows of 'b'
+    __m128 b0 = _mm_loadu_ps( b->f + 0 );
+    __m128 b1 = _mm_loadu_ps( b->f + 4 );
+    __m128 b2 = _mm_loadu_ps( b->f + 8 );
+    __m128 b3 = _mm_loadu_ps( b->f + 12 );
+    __m128 rows[4];
+    for( int i = 0; i < 4; i++ ) {
+        const float * ar = a->f + i * 4;
+        __m128 r = _mm_mul_ps( _mm_set1_ps( ar[0] ), b0 );
+        r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( ar[1] ), b1 ));
+        r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( ar[2] ), b2 ));
+        r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( ar[3] ), b3 ));
+        rows[i] = r;
+    }
+    for( int i = 0; i < 4; i++ ) {
+        _mm_storeu_ps( out->f + i * 4, rows[i] );
+    }
+#else
     TMatrix4 temp = { {0.0f} };
     for( int i = 0; i < 4; i++ ) {
         for( int j = 0; j < 4; j++ ) {            
             for( int k = 0; k < 4; k++ ) {                
-                temp.f[i * 4 + j] += a.f[i * 4 + k] * b.f[k * 4 + j];
+                temp.f[i * 4 + j] += a->f[i * 4 + k] * b->f[k * 4 + j];
             }
         }
     }
+    *out = temp;
+#endif
+}
+
+TMatrix4 Matrix4_Multiply( TMatrix4 a, TMatrix4 b ) {
+    TMatrix4 temp;
+    Matrix4_MultiplyTo( &a, &b, &temp );
     return temp;
 }
 
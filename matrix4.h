@@ -13,7 +13,11 @@ TMatrix4 Matrix4_SetRotationOrigin( TQuaternion q, TVec3 v );
 TMatrix4 Matrix4_SetRotation( TQuaternion q );
 TMatrix4 Matrix4_Translation( TVec3 v );
 TMatrix4 Matrix4_Scale( TVec3 v );
+// same as Matrix4_Multiply( Matrix4_Scale( s ), Matrix4_SetRotationOrigin( q, v )), but much cheaper
+TMatrix4 Matrix4_ComposeTransform( TVec3 s, TQuaternion q, TVec3 v );
 TMatrix4 Matrix4_Multiply( TMatrix4 a, TMatrix4 b );
+// out = a * b, out can point to a or b
+void Matrix4_MultiplyTo( const TMatrix4 * a, const TMatrix4 * b, TMatrix4 * out );
 TMatrix4 Matrix4_PerspectiveFov( float fov, float aspect, float zNear, float zFar );
 TMatrix4 Matrix4_LookAt( TVec3 eye, TVec3 look, TVec3 up );
 TMatrix4 Matrix4_Frustum( float left, float right, float bottom, float top, float zNear, float zFar );
@@ -8,64 +8,316 @@
 #include "thread.h"
 #include "log.h"
 
-typedef struct SMemoryNode {
-    void * data;
+// Small blocks are served from per-thread caches split into power-of-two size
+// classes, so threads never wait for each other when allocating them. Blocks that
+// don't fit any class go to the shared heap, which is protected by critical section.
+
+// every block allocated with Memory_Allocate is prefixed with this header,
+// so freeing and reallocating never needs to search for the block
+typedef struct SMemoryHeader {
+    // large blocks: list of live blocks, small blocks: free list link
+    struct SMemoryHeader * next;
+    struct SMemoryHeader * prev;
     int size;
-    struct SMemoryNode * next;
-    struct SMemoryNode * prev;
-} TMemoryNode;
+    signed char sizeClass;
+    // EMemoryTag of subsystem that allocated block
+    unsigned char tag;
+    unsigned short magic;
+} TMemoryHeader;
+
+// header size rounded up to 16 bytes to keep user data aligned
+#define MEMORY_HEADER_SIZE ((sizeof( TMemoryHeader ) + 15) & ~15)
+#define MEMORY_MAGIC (0xA110)
+#define MEMORY_FREED_MAGIC (0xDEAD)
+
+// size classes are 16, 32, 64 ... 2048 bytes
+#define MEMORY_SIZE_CLASS_COUNT (8)
+#define MEMORY_MIN_CLASS_SIZE (16)
+#define MEMORY_LARGE_BLOCK (-1)
+// thread cache returns half of its free blocks to the shared heap when exceeds this
+#define MEMORY_CACHE_MAX_FREE_BLOCKS (256)
+// count of blocks moved between thread cache and shared heap at once
+#define MEMORY_BATCH_SIZE (32)
+#define MEMORY_CHUNK_SIZE (64 * 1024)
+#define MEMORY_TAG_STACK_SIZE (32)
+
+#define Memory_HeaderToData( header ) ((void*)((char*)(header) + MEMORY_HEADER_SIZE ))
+#define Memory_DataToHeader( data ) ((TMemoryHeader*)((char*)(data) - MEMORY_HEADER_SIZE ))
+#define Memory_ClassSize( sizeClass ) ( MEMORY_MIN_CLASS_SIZE << (sizeClass))
+
+// chunks are carved into small blocks, they are never returned to the system until garbage collection
+typedef struct SMemoryChunk {
+    struct SMemoryChunk * next;
+} TMemoryChunk;
+
+#define MEMORY_CHUNK_HEADER_SIZE ((sizeof( TMemoryChunk ) + 15) & ~15)
+
+// per-thread counters, bytes and count can be negative when thread frees blocks
+// allocated by another thread, only sum over all threads matters
+typedef struct SMemoryThreadStats {
+    volatile int bytes;
+    volatile int count;
+    volatile int totalAllocations;
+    volatile int totalBytes;
+} TMemoryThreadStats;
+
+typedef struct SMemoryThreadCache {
+    TMemoryHeader * freeBlocks[ MEMORY_SIZE_CLASS_COUNT ];
+    int freeCount[ MEMORY_SIZE_CLASS_COUNT ];
+    // current chunk to carve new blocks from
+    char * chunkCursor;
+    char * chunkEnd;
+    TMemoryThreadStats stats[ MEMORY_TAG_COUNT ];
+    unsigned char tagStack[ MEMORY_TAG_STACK_SIZE ];
+    int tagDepth;
+    // cache of finished thread can be adopted by new one
+    bool inUse;
+    struct SMemoryThreadCache * next;
+} TMemoryThreadCache;
 
+// shared heap, all of these protected by g_heapLock
+TCriticalSection g_heapLock = NULL;
+TMemoryHeader * g_rootAllocNode = NULL;
+TMemoryHeader * g_lastAllocNode = NULL;
+TMemoryHeader * g_sharedFreeBlocks[ MEMORY_SIZE_CLASS_COUNT ];
+volatile int g_sharedFreeCount[ MEMORY_SIZE_CLASS_COUNT ];
+TMemoryChunk * g_chunks = NULL;
+TMemoryThreadCache * g_threadCaches = NULL;
 
-TMemoryNode * g_rootAllocNode = NULL;
-TMemoryNode * g_lastAllocNode = NULL;
-int totalAllocatedMemory = 0;
+bool g_memoryInitialized = false;
+TThreadLocal g_threadCacheSlot;
 
+// merged statistics, updated by Memory_UpdateFrameStats and snapshots
+int g_tagPeakBytes[ MEMORY_TAG_COUNT ];
+int g_tagLastTotalAllocations[ MEMORY_TAG_COUNT ];
+int g_tagLastTotalBytes[ MEMORY_TAG_COUNT ];
+int g_tagFrameAllocations[ MEMORY_TAG_COUNT ];
+int g_tagFrameBytes[ MEMORY_TAG_COUNT ];
 
-// to make memory management thread-safe we must use critical section
-TCriticalSection criticalSection = NULL;
+static const char * g_tagNames[ MEMORY_TAG_COUNT ] = {
+    "General",
+    "Render",
+    "Collision",
+    "Lightmap",
+    "Entity",
+    "Audio",
+    "Script",
+    "GUI",
+};
 
-void Memory_EnterCriticalSection( void ) {
-    while( !CriticalSection_TryEnter( criticalSection )) {
-        // this message is mostly for debug purposes
-        Log_Write( "Memory: - Waiting critical section" );
+static void Memory_Initialize( void ) {
+    // first allocation is done by main thread before any other thread starts
+    g_heapLock = CriticalSection_Create();
+    g_threadCacheSlot = ThreadLocal_Create();
+    g_memoryInitialized = true;
+}
+
+static TMemoryThreadCache * Memory_GetThreadCache( void ) {
+    TMemoryThreadCache * cache = ThreadLocal_Get( g_threadCacheSlot );
+    if( !cache ) {
+        CriticalSection_Enter( g_heapLock );
+        // adopt cache of finished thread, it keeps statistics of that thread
+        for( cache = g_threadCaches; cache; cache = cache->next ) {
+            if( !cache->inUse ) {
+                break;
+            }
+        }
+        if( !cache ) {
+            cache = calloc( 1, sizeof( TMemoryThreadCache ));
+            if( !cache ) {
+                CriticalSection_Leave( g_heapLock );
+                Util_RaiseError( "Unable to allocate thread memory cache!" );
+            }
+            cache->next = g_threadCaches;
+            g_threadCaches = cache;
+        }
+        cache->inUse = true;
+        CriticalSection_Leave( g_heapLock );
+        ThreadLocal_Set( g_threadCacheSlot, cache );
     }
+    return cache;
 }
 
-void Memory_LeaveCriticalSection( void ) {
-    CriticalSection_Leave( criticalSection );
+static int Memory_GetSizeClass( int size ) {
+    for( int sizeClass = 0; sizeClass < MEMORY_SIZE_CLASS_COUNT; sizeClass++ ) {
+        if( size <= Memory_ClassSize( sizeClass )) {
+            return sizeClass;
+        }
+    }
+    return MEMORY_LARGE_BLOCK;
 }
 
-void * Memory_CommonAllocation( int size, bool clear ) {
-    if( !criticalSection ) {
-        criticalSection = CriticalSection_Create();
-    }
-    
-    Memory_EnterCriticalSection();
-    
-    void * block = malloc( size );
-    if( !block ) {
-        Util_RaiseError( "Unable to allocate %d bytes. Not enough memory! Allocation failed!", size );
+// moves 'count' blocks from thread cache free list to shared heap
+static void Memory_FlushBlocks( TMemoryThreadCache * cache, int sizeClass, int count ) {
+    if( count <= 0 ) {
+        return;
     }
-    if( clear ) {
-        memset( block, 0, size );
-    }
-    totalAllocatedMemory += size;
-    TMemoryNode * newAllocNode = malloc( sizeof( TMemoryNode ));
-    newAllocNode->data = block;
-    newAllocNode->next = NULL;
-    newAllocNode->size = size;
-    newAllocNode->prev = g_lastAllocNode;
+    TMemoryHeader * first = cache->freeBlocks[ sizeClass ];
+    TMemoryHeader * last = first;
+    for( int i = 1; i < count; i++ ) {
+        last = last->next;
+    }
+    cache->freeBlocks[ sizeClass ] = last->next;
+    cache->freeCount[ sizeClass ] -= count;
+    CriticalSection_Enter( g_heapLock );
+    last->next = g_sharedFreeBlocks[ sizeClass ];
+    g_sharedFreeBlocks[ sizeClass ] = first;
+    g_sharedFreeCount[ sizeClass ] += count;
+    CriticalSection_Leave( g_heapLock );
+}
+
+// takes batch of blocks from shared heap, returns false if shared heap has no blocks of this class
+static bool Memory_RefillFromSharedHeap( TMemoryThreadCache * cache, int sizeClass ) {
+    // unlocked read is just a hint, avoids locking when shared heap is empty
+    if( g_sharedFreeCount[ sizeClass ] <= 0 ) {
+        return false;
+    }
+    CriticalSection_Enter( g_heapLock );
+    int count = 0;
+    while( g_sharedFreeBlocks[ sizeClass ] && count < MEMORY_BATCH_SIZE ) {
+        TMemoryHeader * block = g_sharedFreeBlocks[ sizeClass ];
+        g_sharedFreeBlocks[ sizeClass ] = block->next;
+        block->next = cache->freeBlocks[ sizeClass ];
+        cache->freeBlocks[ sizeClass ] = block;
+        count++;
+    }
+    g_sharedFreeCount[ sizeClass ] -= count;
+    CriticalSection_Leave( g_heapLock );
+    cache->freeCount[ sizeClass ] += count;
+    return count > 0;
+}
+
+static TMemoryHeader * Memory_CarveBlock( TMemoryThreadCache * cache, int sizeClass ) {
+    int blockSize = MEMORY_HEADER_SIZE + Memory_ClassSize( sizeClass );
+    if( cache->chunkEnd - cache->chunkCursor < blockSize ) {
+        // rest of the current chunk is wasted, it is smaller than requested block anyway
+        TMemoryChunk * chunk = malloc( MEMORY_CHUNK_HEADER_SIZE + MEMORY_CHUNK_SIZE );
+        if( !chunk ) {
+            Util_RaiseError( "Unable to allocate memory chunk. Not enough memory! Allocation failed!" );
+        }
+        CriticalSection_Enter( g_heapLock );
+        chunk->next = g_chunks;
+        g_chunks = chunk;
+        CriticalSection_Leave( g_heapLock );
+        cache->chunkCursor = (char*)chunk + MEMORY_CHUNK_HEADER_SIZE;
+        cache->chunkEnd = cache->chunkCursor + MEMORY_CHUNK_SIZE;
+    }
+    TMemoryHeader * block = (TMemoryHeader*)cache->chunkCursor;
+    cache->chunkCursor += blockSize;
+    return block;
+}
+
+static void Memory_AccountAllocation( TMemoryThreadCache * cache, int tag, int size ) {
+    TMemoryThreadStats * stats = &cache->stats[ tag ];
+    stats->bytes += size;
+    stats->count++;
+    stats->totalAllocations++;
+    stats->totalBytes += size;
+}
+
+static void Memory_AccountFree( TMemoryThreadCache * cache, int tag, int size ) {
+    TMemoryThreadStats * stats = &cache->stats[ tag ];
+    stats->bytes -= size;
+    stats->count--;
+}
+
+static TMemoryHeader * Memory_AllocateSmall( TMemoryThreadCache * cache, int sizeClass ) {
+    TMemoryHeader * block;
+    if( cache->freeBlocks[ sizeClass ] || Memory_RefillFromSharedHeap( cache, sizeClass )) {
+        block = cache->freeBlocks[ sizeClass ];
+        cache->freeBlocks[ sizeClass ] = block->next;
+        cache->freeCount[ sizeClass ]--;
+    } else {
+        block = Memory_CarveBlock( cache, sizeClass );
+    }
+    block->next = NULL;
+    block->prev = NULL;
+    block->sizeClass = sizeClass;
+    return block;
+}
+
+static void Memory_FreeSmall( TMemoryHeader * block ) {
+    TMemoryThreadCache * cache = Memory_GetThreadCache();
+    int sizeClass = block->sizeClass;
+    Memory_AccountFree( cache, block->tag, block->size );
+    block->next = cache->freeBlocks[ sizeClass ];
+    cache->freeBlocks[ sizeClass ] = block;
+    cache->freeCount[ sizeClass ]++;
+    if( cache->freeCount[ sizeClass ] > MEMORY_CACHE_MAX_FREE_BLOCKS ) {
+        Memory_FlushBlocks( cache, sizeClass, MEMORY_CACHE_MAX_FREE_BLOCKS / 2 );
+    }
+}
+
+static void Memory_LinkLargeBlock( TMemoryHeader * header ) {
+    header->next = NULL;
+    header->prev = g_lastAllocNode;
     if( g_lastAllocNode ) {
-        g_lastAllocNode->next = newAllocNode;
+        g_lastAllocNode->next = header;
     }
     if( !g_rootAllocNode ) {
-        g_rootAllocNode = newAllocNode;
+        g_rootAllocNode = header;
     }
-    g_lastAllocNode = newAllocNode;
-    
-    Memory_LeaveCriticalSection();
-    
-    return block;
+    g_lastAllocNode = header;
+}
+
+static void Memory_UnlinkLargeBlock( TMemoryHeader * header ) {
+    if( header->next ) {
+        header->next->prev = header->prev;
+    } else {
+        g_lastAllocNode = header->prev;
+    }
+    if( header->prev ) {
+        header->prev->next = header->next;
+    } else {
+        g_rootAllocNode = header->next;
+    }
+}
+
+static TMemoryHeader * Memory_AllocateLarge( int size ) {
+    TMemoryHeader * header = malloc( MEMORY_HEADER_SIZE + size );
+    if( !header ) {
+        Util_RaiseError( "Unable to allocate %d bytes. Not enough memory! Allocation failed!", size );
+    }
+    header->size = size;
+    header->sizeClass = MEMORY_LARGE_BLOCK;
+    CriticalSection_Enter( g_heapLock );
+    Memory_LinkLargeBlock( header );
+    CriticalSection_Leave( g_heapLock );
+    return header;
+}
+
+static TMemoryHeader * Memory_GetHeader( void * data ) {
+    // header of NULL can't be read
+    if( !data ) {
+        Util_RaiseError( "Attempt to free memory %p allocated without Memory_Allocate[Clean]", data );
+    }
+    TMemoryHeader * header = Memory_DataToHeader( data );
+    if( header->magic != MEMORY_MAGIC ) {
+        Util_RaiseError( "Attempt to free memory %p allocated without Memory_Allocate[Clean]", data );
+    }
+    return header;
+}
+
+void * Memory_CommonAllocation( int size, bool clear ) {
+    if( !g_memoryInitialized ) {
+        Memory_Initialize();
+    }
+    TMemoryThreadCache * cache = Memory_GetThreadCache();
+    int sizeClass = Memory_GetSizeClass( size );
+    TMemoryHeader * header;
+    if( sizeClass != MEMORY_LARGE_BLOCK ) {
+        header = Memory_AllocateSmall( cache, sizeClass );
+    } else {
+        header = Memory_AllocateLarge( size );
+    }
+    header->size = size;
+    header->magic = MEMORY_MAGIC;
+    header->tag = cache->tagDepth > 0 ? cache->tagStack[ cache->tagDepth - 1 ] : MEMORY_TAG_GENERAL;
+    Memory_AccountAllocation( cache, header->tag, size );
+    if( clear ) {
+        memset( Memory_HeaderToData( header ), 0, size );
+    }
+    return Memory_HeaderToData( header );
 }
 
 void * Memory_Allocate( int size ) {
@@ -77,77 +329,233 @@ void * Memory_AllocateClean( int size ) {
 }
 
 int Memory_GetAllocated( void ) {
-    return totalAllocatedMemory;
+    TMemorySnapshot snapshot;
+    Memory_TakeSnapshot( &snapshot );
+    int allocated = 0;
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        allocated += snapshot.tags[ tag ].bytes;
+    }
+    return allocated;
+}
+
+void Memory_PushTag( EMemoryTag tag ) {
+    if( !g_memoryInitialized ) {
+        Memory_Initialize();
+    }
+    TMemoryThreadCache * cache = Memory_GetThreadCache();
+    if( cache->tagDepth >= MEMORY_TAG_STACK_SIZE ) {
+        Util_RaiseError( "Memory: - Tag stack overflow, probably Memory_PopTag is missing" );
+    }
+    cache->tagStack[ cache->tagDepth++ ] = tag;
+}
+
+void Memory_PopTag( void ) {
+    TMemoryThreadCache * cache = Memory_GetThreadCache();
+    if( cache->tagDepth <= 0 ) {
+        Util_RaiseError( "Memory: - Tag stack underflow, Memory_PopTag without Memory_PushTag" );
+    }
+    cache->tagDepth--;
+}
+
+const char * Memory_GetTagName( EMemoryTag tag ) {
+    return g_tagNames[ tag ];
+}
+
+// sums counters of all threads, must be called inside g_heapLock
+static void Memory_MergeStats( TMemoryThreadStats * merged ) {
+    memset( merged, 0, MEMORY_TAG_COUNT * sizeof( TMemoryThreadStats ));
+    for( TMemoryThreadCache * cache = g_threadCaches; cache; cache = cache->next ) {
+        for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+            merged[ tag ].bytes += cache->stats[ tag ].bytes;
+            merged[ tag ].count += cache->stats[ tag ].count;
+            merged[ tag ].totalAllocations += cache->stats[ tag ].totalAllocations;
+            merged[ tag ].totalBytes += cache->stats[ tag ].totalBytes;
+        }
+    }
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        if( merged[ tag ].bytes > g_tagPeakBytes[ tag ] ) {
+            g_tagPeakBytes[ tag ] = merged[ tag ].bytes;
+        }
+    }
+}
+
+void Memory_UpdateFrameStats( void ) {
+    if( !g_memoryInitialized ) {
+        return;
+    }
+    TMemoryThreadStats merged[ MEMORY_TAG_COUNT ];
+    CriticalSection_Enter( g_heapLock );
+    Memory_MergeStats( merged );
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        g_tagFrameAllocations[ tag ] = merged[ tag ].totalAllocations - g_tagLastTotalAllocations[ tag ];
+        g_tagFrameBytes[ tag ] = merged[ tag ].totalBytes - g_tagLastTotalBytes[ tag ];
+        g_tagLastTotalAllocations[ tag ] = merged[ tag ].totalAllocations;
+        g_tagLastTotalBytes[ tag ] = merged[ tag ].totalBytes;
+    }
+    CriticalSection_Leave( g_heapLock );
+}
+
+void Memory_TakeSnapshot( TMemorySnapshot * snapshot ) {
+    memset( snapshot, 0, sizeof( TMemorySnapshot ));
+    if( !g_memoryInitialized ) {
+        return;
+    }
+    TMemoryThreadStats merged[ MEMORY_TAG_COUNT ];
+    CriticalSection_Enter( g_heapLock );
+    Memory_MergeStats( merged );
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        TMemoryTagStats * stats = &snapshot->tags[ tag ];
+        stats->bytes = merged[ tag ].bytes;
+        stats->peakBytes = g_tagPeakBytes[ tag ];
+        stats->allocationCount = merged[ tag ].count;
+        stats->totalAllocations = merged[ tag ].totalAllocations;
+        stats->frameAllocations = g_tagFrameAllocations[ tag ];
+        stats->frameBytes = g_tagFrameBytes[ tag ];
+    }
+    CriticalSection_Leave( g_heapLock );
+}
+
+void Memory_GetTagStats( EMemoryTag tag, TMemoryTagStats * stats ) {
+    TMemorySnapshot snapshot;
+    Memory_TakeSnapshot( &snapshot );
+    *stats = snapshot.tags[ tag ];
+}
+
+void Memory_DiffSnapshots( const TMemorySnapshot * before, const TMemorySnapshot * after, TMemorySnapshot * diff ) {
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        const TMemoryTagStats * a = &before->tags[ tag ];
+        const TMemoryTagStats * b = &after->tags[ tag ];
+        TMemoryTagStats * d = &diff->tags[ tag ];
+        d->bytes = b->bytes - a->bytes;
+        d->peakBytes = b->peakBytes - a->peakBytes;
+        d->allocationCount = b->allocationCount - a->allocationCount;
+        d->totalAllocations = b->totalAllocations - a->totalAllocations;
+        d->frameAllocations = b->frameAllocations - a->frameAllocations;
+        d->frameBytes = b->frameBytes - a->frameBytes;
+    }
+}
+
+void Memory_DumpSnapshot( const TMemorySnapshot * snapshot, const char * title ) {
+    Log_Write( "Memory: - %s", title );
+    Log_Write( "Memory: - %-10s %12s %12s %10s %12s %10s %12s", "Tag", "Bytes", "Peak", "Live", "Total", "Frame", "FrameBytes" );
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        const TMemoryTagStats * stats = &snapshot->tags[ tag ];
+        Log_Write( "Memory: - %-10s %12d %12d %10d %12d %10d %12d", g_tagNames[ tag ], stats->bytes, stats->peakBytes,
+            stats->allocationCount, stats->totalAllocations, stats->frameAllocations, stats->frameBytes );
+    }
 }
 
 void * Memory_Reallocate( void * data, int newSize ) {
-    Memory_EnterCriticalSection();
-    // find existing memory block
-    TMemoryNode * current = g_rootAllocNode;
-    void * newData = 0;
-    while( current ) {
-        if( current->data == data ) {
-            newData = realloc( data, newSize );
-            if( !newData ) {
-                Util_RaiseError( "Memory reallocation failed!" );
-            }
-            // got pointer to another place, rewrite it in the memblock
-            if( newData != data ) {
-                current->data = newData;
-            }
+    if( !data ) {
+        return Memory_Allocate( newSize );
+    }
+    TMemoryHeader * header = Memory_GetHeader( data );
+    if( header->sizeClass != MEMORY_LARGE_BLOCK ) {
+        // small block still fits, so there is no need to move it
+        if( newSize <= Memory_ClassSize( header->sizeClass )) {
+            TMemoryThreadStats * stats = &Memory_GetThreadCache()->stats[ header->tag ];
+            stats->bytes += newSize - header->size;
+            stats->totalBytes += newSize > header->size ? newSize - header->size : 0;
+            header->size = newSize;
+            return data;
+        }
+    } else if( Memory_GetSizeClass( newSize ) == MEMORY_LARGE_BLOCK ) {
+        CriticalSection_Enter( g_heapLock );
+        // block can move, so it must be unlinked while realloc is in progress
+        Memory_UnlinkLargeBlock( header );
+        TMemoryHeader * newHeader = realloc( header, MEMORY_HEADER_SIZE + newSize );
+        if( !newHeader ) {
+            CriticalSection_Leave( g_heapLock );
+            Util_RaiseError( "Memory reallocation failed!" );
         }
-        current = current->next;
+        TMemoryThreadStats * stats = &Memory_GetThreadCache()->stats[ newHeader->tag ];
+        stats->bytes += newSize - newHeader->size;
+        stats->totalBytes += newSize > newHeader->size ? newSize - newHeader->size : 0;
+        newHeader->size = newSize;
+        Memory_LinkLargeBlock( newHeader );
+        CriticalSection_Leave( g_heapLock );
+        return Memory_HeaderToData( newHeader );
     }
-    Memory_LeaveCriticalSection();
+    // block moves between size classes or between thread cache and shared heap, it keeps its tag
+    Memory_PushTag( header->tag );
+    void * newData = Memory_Allocate( newSize );
+    Memory_PopTag();
+    memcpy( newData, data, header->size < newSize ? header->size : newSize );
+    Memory_Free( data );
     return newData;
 }
 
 void Memory_Free( void * data ) {
-    Memory_EnterCriticalSection();
-    TMemoryNode * current = g_rootAllocNode;
-    while( current ) {
-        if( current->data == data ) {
-            if( current->next ) {
-                current->next->prev = current->prev;
-            }
-            if( current->prev ) {
-                current->prev->next = current->next;
-            }
-            if( current == g_rootAllocNode ) {
-                if( current->next ) {
-                    g_rootAllocNode = current->next;
-                } else {
-                    g_rootAllocNode = NULL;
-                }
-            }
-            if( current == g_lastAllocNode ) {
-                if( current->prev ) {
-                    g_lastAllocNode = current->prev;
-                } else {
-                    g_lastAllocNode = NULL;
-                }
-            }
-            totalAllocatedMemory -= current->size;
-            free( current );
-            free( data );
-            CriticalSection_Leave( criticalSection );
-            return;
-        }
-        current = current->next;
+    TMemoryHeader * header = Memory_GetHeader( data );
+    // poison header to catch double free
+    header->magic = MEMORY_FREED_MAGIC;
+    if( header->sizeClass != MEMORY_LARGE_BLOCK ) {
+        Memory_FreeSmall( header );
+    } else {
+        Memory_AccountFree( Memory_GetThreadCache(), header->tag, header->size );
+        CriticalSection_Enter( g_heapLock );
+        Memory_UnlinkLargeBlock( header );
+        CriticalSection_Leave( g_heapLock );
+        free( header );
     }
-    Memory_LeaveCriticalSection();
-    Util_RaiseError( "Attempt to free memory %d allocated without Memory_Allocate[Clean]", (int)data );
 }
 
+void Memory_ReleaseThreadCache( void ) {
+    if( !g_memoryInitialized ) {
+        return;
+    }
+    TMemoryThreadCache * cache = ThreadLocal_Get( g_threadCacheSlot );
+    if( cache ) {
+        // give free blocks to other threads, statistics stay in cache
+        cache->tagDepth = 0;
+        for( int sizeClass = 0; sizeClass < MEMORY_SIZE_CLASS_COUNT; sizeClass++ ) {
+            Memory_FlushBlocks( cache, sizeClass, cache->freeCount[ sizeClass ] );
+        }
+        CriticalSection_Enter( g_heapLock );
+        cache->inUse = false;
+        CriticalSection_Leave( g_heapLock );
+        ThreadLocal_Set( g_threadCacheSlot, NULL );
+    }
+}
 
 void Memory_CollectGarbage( ) {
-    CriticalSection_Delete( criticalSection );
-    TMemoryNode *next, *current;
+    if( !g_memoryInitialized ) {
+        return;
+    }
+    CriticalSection_Delete( g_heapLock );
+    g_heapLock = NULL;
+    // small blocks are freed with chunks they were carved from
+    TMemoryChunk * nextChunk;
+    for( TMemoryChunk * chunk = g_chunks; chunk; chunk = nextChunk ) {
+        nextChunk = chunk->next;
+        free( chunk );
+    }
+    g_chunks = NULL;
+    TMemoryHeader *next, *current;
     for( current = g_rootAllocNode; current; current = next ) {
         next = current->next;
-        totalAllocatedMemory -= current->size;
-        free( current->data );
+        current->magic = MEMORY_FREED_MAGIC;
         free( current );
-        current = next;
     }
-}
\ No newline at end of file
+    g_rootAllocNode = NULL;
+    g_lastAllocNode = NULL;
+    TMemoryThreadCache * nextCache;
+    for( TMemoryThreadCache * cache = g_threadCaches; cache; cache = nextCache ) {
+        nextCache = cache->next;
+        free( cache );
+    }
+    g_threadCaches = NULL;
+    for( int sizeClass = 0; sizeClass < MEMORY_SIZE_CLASS_COUNT; sizeClass++ ) {
+        g_sharedFreeBlocks[ sizeClass ] = NULL;
+        g_sharedFreeCount[ sizeClass ] = 0;
+    }
+    for( int tag = 0; tag < MEMORY_TAG_COUNT; tag++ ) {
+        g_tagPeakBytes[ tag ] = 0;
+        g_tagLastTotalAllocations[ tag ] = 0;
+        g_tagLastTotalBytes[ tag ] = 0;
+        g_tagFrameAllocations[ tag ] = 0;
+        g_tagFrameBytes[ tag ] = 0;
+    }
+    ThreadLocal_Set( g_threadCacheSlot, NULL );
+    g_memoryInitialized = false;
+}
@@ -1,22 +1,72 @@
 #ifndef _MEMORY_
 #define _MEMORY_
 
+// every allocation is tagged with subsystem which made it, tag is taken from top of the
+// per-thread tag stack, so whole subsystem call can be tagged with Memory_PushTag/Memory_PopTag
+typedef enum EMemoryTag {
+    MEMORY_TAG_GENERAL = 0,
+    MEMORY_TAG_RENDER,
+    MEMORY_TAG_COLLISION,
+    MEMORY_TAG_LIGHTMAP,
+    MEMORY_TAG_ENTITY,
+    MEMORY_TAG_AUDIO,
+    MEMORY_TAG_SCRIPT,
+    MEMORY_TAG_GUI,
+    MEMORY_TAG_COUNT
+} EMemoryTag;
+
+typedef struct TMemoryTagStats {
+    // currently allocated bytes
+    int bytes;
+    // highest value of 'bytes' seen by Memory_UpdateFrameStats or snapshots
+    int peakBytes;
+    // count of live allocations
+    int allocationCount;
+    // count of allocations since start
+    int totalAllocations;
+    // allocations done during last frame
+    int frameAllocations;
+    int frameBytes;
+} TMemoryTagStats;
+
+typedef struct TMemorySnapshot {
+    TMemoryTagStats tags[ MEMORY_TAG_COUNT ];
+} TMemorySnapshot;
+
 // allocate memory without cleaning
 void * Memory_Allocate( int size );
 // allocate clean memory (filled with zeros)
 void * Memory_AllocateClean( int size );
+// reallocate block, data can be NULL, in this case it works like Memory_Allocate
 void * Memory_Reallocate( void * data, int newSize );
+// small blocks are taken from per-thread caches, so allocation and freeing can be done
+// from any thread without waiting for each other
 // safe memory freeing, attempt to free data not created with Memory_Allocate will cause error
-// this functions is not thread safe!
+// freeing takes constant time, bookkeeping is stored in header in front of each block
 void Memory_Free( void * data );
+// returns free blocks of calling thread to shared heap, called automatically when thread
+// started with Thread_Start is finished
+void Memory_ReleaseThreadCache( void );
 // call this function when your program ends for cleanup
 void Memory_CollectGarbage( void );
 // retrieve allocated memory size
 int Memory_GetAllocated( void );
+// makes all next allocations of calling thread tagged with 'tag' until Memory_PopTag
+void Memory_PushTag( EMemoryTag tag );
+void Memory_PopTag( void );
+const char * Memory_GetTagName( EMemoryTag tag );
+// merges statistics of all threads and computes per-frame allocation rate, call once per frame
+void Memory_UpdateFrameStats( void );
+void Memory_GetTagStats( EMemoryTag tag, TMemoryTagStats * stats );
+void Memory_TakeSnapshot( TMemorySnapshot * snapshot );
+// diff = after - before, useful to find leaks and allocation spikes
+void Memory_DiffSnapshots( const TMemorySnapshot * before, const TMemorySnapshot * after, TMemorySnapshot * diff );
+// writes snapshot to log
+void Memory_DumpSnapshot( const TMemorySnapshot * snapshot, const char * title );
 // some useful macros
 // allocate memory for type with clearing allocated memory with zeros
 #define Memory_New( typeName ) ((typeName*)Memory_AllocateClean( sizeof(typeName )))
 // allocate array of type with clearing allocated memory with zeros
-#define Memory_NewCount( count, typeName ) ((typeName*)Memory_AllocateClean( count * sizeof(typeName )))
+#define Memory_NewCount( count, typeName ) ((typeName*)Memory_AllocateClean( (count) * sizeof(typeName )))
 
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "monster.h"
 #include "player.h"
 
+#define MONSTER_ANIMATION_FADE_TIME (0.2f)
+
 TList gMonsterList;
 
 TMonster * Monster_Create( void ) {
@@ -13,13 +15,17 @@ TMonster * Monster_Create( void ) {
     monster->body.position = Vec3_Set( 0, 3, 0 );
     monster->runAnim = Animation_Create( 0, 20, 1.75 ); 
     monster->attackAnim = Animation_Create( 21, 26, 1 );    
-    Entity_SetAnimation( monster->model, monster->runAnim );
+    monster->animator = Animator_Create( monster->model );
+    Animator_Play( monster->animator, monster->runAnim );
+    monster->attacking = false;
     List_Add( &gMonsterList, monster );
     return monster;
 }
 
 void Monster_Free( TMonster * monster ) {
     List_Remove( &gMonsterList, monster );
+    Dynamics_RemoveBody( &monster->body );
+    Animator_Free( monster->animator );
     Memory_Free( monster );
 }
 
@@ -28,16 +34,16 @@ void Monster_Think( TMonster * monster ) {
     TVec3 dirNorm = Vec3_Normalize( dir );
     float angle = atan2f( dir.x, dir.z );    
     float distance = Vec3_Distance( player->body.position, Entity_GetGlobalPosition( monster->model ));
-    if( distance < 1.5f ) {
-        Entity_SetAnimation( monster->model, monster->attackAnim );
-        monster->attackAnim->enabled = true;
-        monster->runAnim->enabled = false;
+    bool attacking = distance < 1.5f;
+    // animator blends poses itself, so it is touched only when behaviour changes
+    if( attacking != monster->attacking ) {
+        Animator_CrossFade( monster->animator, attacking ? monster->attackAnim : monster->runAnim, MONSTER_ANIMATION_FADE_TIME );
+        monster->attacking = attacking;
+    }
+    if( attacking ) {
         monster->body.linearVelocity.x = 0;
         monster->body.linearVelocity.z = 0;
     } else {
-        Entity_SetAnimation( monster->model, monster->runAnim );
-        monster->runAnim->enabled = true;
-        monster->attackAnim->enabled = false;
         monster->body.linearVelocity.x = Vec3_Scale( dirNorm, 0.025 ).x;
         monster->body.linearVelocity.z = Vec3_Scale( dirNorm, 0.025 ).z;
     }
@@ -3,12 +3,15 @@
 
 #include "entity.h"
 #include "gui.h"
+#include "animator.h"
 
 typedef struct TMonster {
     TEntity * model;
     float life;
     TAnimation * runAnim;
     TAnimation * attackAnim;
+    TAnimator * animator;
+    bool attacking;
     //TCollisionShape shape;
     TBody body;
 } TMonster;
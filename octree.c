@@ -60,7 +60,29 @@ void Octree_Build( TOctree * octree, TTriangle * triangles, int triangleCount, i
         octree->containIndexCountMT[i] = 0;
     }
 
-    Octree_BuildRecursiveInternal( octree->root, triangles, triangleCount, indices, triangleCount, maxTrianglesPerNode );
+    Pool_Create( &octree->nodePool, 8 * sizeof( TOctreeNode ), 64, false );
+    Octree_BuildRecursiveInternal( octree, octree->root, triangles, triangleCount, indices, triangleCount, maxTrianglesPerNode );
+    Memory_Free( indices );
+}
+
+static void Octree_FreeRecursiveInternal( TOctreeNode * node ) {
+    if( node->split ) {
+        for( int i = 0; i < 8; i++ ) {
+            Octree_FreeRecursiveInternal( node->childs[i] );
+        }
+    } else if( node->indices ) {
+        Memory_Free( node->indices );
+    }
+}
+
+void Octree_Free( TOctree * octree ) {
+    Octree_FreeRecursiveInternal( octree->root );
+    Memory_Free( octree->root );
+    Pool_Free( &octree->nodePool );
+    Memory_Free( octree->containIndices );
+    for( int i = 0; i < OCTREE_MAX_SIMULTANEOUS_THREADS; i++ ) {
+        Memory_Free( octree->containIndicesMT[i] );
+    }
 }
 
 int IndexCmpFunc( const void * a, const void * b ) {
@@ -251,7 +273,7 @@ void Octree_GetContainIndex( TOctree * octree, TSphereShape * sphere ) {
     Octree_GetContainIndexListRecursiveInternal( octree, octree->root, sphere );
 }
 
-void Octree_BuildRecursiveInternal( TOctreeNode * node, TTriangle * triangles, int triangleCount, int * indices, int indexCount, int maxTrianglesPerNode ) {
+void Octree_BuildRecursiveInternal( TOctree * octree, TOctreeNode * node, TTriangle * triangles, int triangleCount, int * indices, int indexCount, int maxTrianglesPerNode ) {
     if( indexCount < maxTrianglesPerNode ) {
         int sizeBytes = sizeof( int ) * indexCount;
         node->indexCount = indexCount;
@@ -260,7 +282,7 @@ void Octree_BuildRecursiveInternal( TOctreeNode * node, TTriangle * triangles, i
         return;
     }
 
-    Octree_SplitNode( node );
+    Octree_SplitNode( octree, node );
 
     for( int childNum = 0; childNum < 8; childNum++ ) {
         TOctreeNode * child = node->childs[childNum];
@@ -289,7 +311,8 @@ void Octree_BuildRecursiveInternal( TOctreeNode * node, TTriangle * triangles, i
         }
 
         // allocate memory for temporary leaf and fill it with data 
-        int * leafIndices = Memory_NewCount( leafTriangleCount, int );
+        TScratchMark mark = Scratch_GetMark();
+        int * leafIndices = Scratch_NewCount( leafTriangleCount, int );
         int triangleNum = 0;
         for( int i = 0; i < triangleCount; i++ ) {
             TTriangle * triangle = triangles + i;
@@ -308,18 +331,20 @@ void Octree_BuildRecursiveInternal( TOctreeNode * node, TTriangle * triangles, i
         }
 
         // recursively process childs of this node 
-        Octree_BuildRecursiveInternal( child, triangles, triangleCount, leafIndices, triangleNum, maxTrianglesPerNode );
+        Octree_BuildRecursiveInternal( octree, child, triangles, triangleCount, leafIndices, triangleNum, maxTrianglesPerNode );
 
         // leafFaces data already copied to another node, so we can free temporary array 
-        Memory_Free( leafIndices );
+        Scratch_Rewind( mark );
     }
 }
 
-void Octree_SplitNode( TOctreeNode * node ) {
+void Octree_SplitNode( TOctree * octree, TOctreeNode * node ) {
     TVec3 center = Vec3_Middle( node->min, node->max );
 
+    // all childs are placed contiguously
+    TOctreeNode * childs = Pool_Allocate( &octree->nodePool );
     for(int i = 0; i < 8; i++) {
-        node->childs[i] = Memory_New( TOctreeNode );
+        node->childs[i] = childs + i;
         node->childs[i]->split = 0;
         node->childs[i]->indices = 0;
         node->childs[i]->indexCount = 0;
@@ -9,6 +9,7 @@
 #include "face.h"
 #include "vertex.h"
 #include "aabbTri.h"
+#include "pool.h"
 
 struct TTriangle;
 struct TSphereShape;
@@ -34,17 +35,20 @@ typedef struct SOctree {
     int containIndexCountMT[OCTREE_MAX_SIMULTANEOUS_THREADS];
     
     TOctreeNode * root;
+    // children of split node are allocated together, 8 nodes per pool element
+    TPool nodePool;
 } TOctree;
 
 char OctreeNodeIntersectSphere( TOctreeNode * node, struct TSphereShape * sphere );
 void Octree_Build( TOctree * octree, struct TTriangle * triangles, int triangleCount,int maxTrianglesPerNode );
+void Octree_Free( TOctree * octree );
 void Octree_TraceRay( TOctree * octree, const struct TRay * ray );
-void Octree_SplitNode( TOctreeNode * node );
+void Octree_SplitNode( TOctree * octree, TOctreeNode * node );
 void Octree_GetContainIndex( TOctree * octree, struct TSphereShape * sphere );
 void Octree_GetContainIndexListRecursiveInternal( TOctree * octree, TOctreeNode * node, struct TSphereShape * sphere );
 char Octree_IsPointInsideNode( TOctreeNode * node, TVec3 * point );
 char Octree_TraceRayRecursiveInternal( TOctree * octree, TOctreeNode * node, const struct TRay * ray );
-void Octree_BuildRecursiveInternal( TOctreeNode * node, struct TTriangle * triangles, int triangleCount, int * indices, int indexCount, int maxTrianglesPerNode );
+void Octree_BuildRecursiveInternal( TOctree * octree, TOctreeNode * node, struct TTriangle * triangles, int triangleCount, int * indices, int indexCount, int maxTrianglesPerNode );
 
 void Octree_TraceRayMultithreaded( TOctree * octree, const struct TRay * ray, int threadNum );
 char Octree_TraceRayRecursiveInternalMultithreaded( TOctree * octree, TOctreeNode * node, const struct TRay * ray, int threadNum );
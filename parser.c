@@ -9,13 +9,14 @@ void Parser_LoadFile( const char * fileName, TValueArray * array ) {
     fseek( file, 0, SEEK_END );
     int size = ftell( file );
     fseek( file, 0, SEEK_SET );
-    char * buffer = Memory_AllocateClean( size + 1 );
+    TScratchMark mark = Scratch_GetMark();
+    char * buffer = Scratch_Allocate( size + 1 );
     fread( buffer, 1, size, file );
     buffer[ size ] = '\0';
     fclose( file );
     Parser_LoadString( buffer, array );
     // free temporary buffer 
-    Memory_Free( buffer );
+    Scratch_Rewind( mark );
 }
 
 
@@ -27,7 +28,8 @@ void Parser_LoadString( const char * str, TValueArray * array ) {
 
     // copy string to temporary buffer 
     unsigned int bufferLength = strlen( str );
-    char * buffer = Memory_AllocateClean( bufferLength );
+    TScratchMark mark = Scratch_GetMark();
+    char * buffer = Scratch_Allocate( bufferLength );
     memcpy( buffer, str, bufferLength);
 
     char equalFound = 0;
@@ -129,5 +131,5 @@ void Parser_LoadString( const char * str, TValueArray * array ) {
     };
 
     // free temporary buffer 
-    Memory_Free( buffer );
+    Scratch_Rewind( mark );
 }
\ No newline at end of file
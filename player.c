@@ -71,6 +71,7 @@ void Player_Create( ) {
 
 void Player_Free( void ) {
     if( player ){
+        Dynamics_RemoveBody( &player->body );
         Entity_Free( player->cameraPivot );
         Entity_Free( player->pivot );
     }
@@ -93,10 +94,12 @@ void Player_SetSoundGroup( const char * baseName, EStepSoundType group, const ch
         TValueArray values;
         Parser_LoadFile( materialFile, &values );
         player->stepSounds[group].count = soundNum;
-        for( int i = 0; i < values.count; i++ ) {
-            player->stepSounds[group].material[i] = Texture2D_LoadFromFile( values.values[i].string );
+        int materialCount = values.count < GROUP_MAX_MATERIALS ? values.count : GROUP_MAX_MATERIALS;
+        for( int i = 0; i < materialCount; i++ ) {
+            player->stepSounds[group].material[i] = Atom_Intern( values.values[i].string );
         }
-        player->stepSounds[group].materialCount = values.count;
+        player->stepSounds[group].materialCount = materialCount;
+        ValueArray_Free( &values );
     }
 }
 
@@ -154,16 +157,11 @@ void Player_Update( float timeStep ) {
             char standUp = 1;
             // before stand up, we must trace ray up on player's head, to ensure, that
             // there enough space to stand up.
-            TVec3 end = Vec3_Set( player->body.position.x, player->body.position.y + 1.0f, player->body.position.z );
-            TRay headRay = Ray_Set( player->body.position, end );
-            TRayTraceResult out;
-            Ray_TraceWorldStatic( &headRay, &out );
-            if( out.body ) {
-                float maxRadius = player->shape.sphereRadius + 0.4f;
-                if( Vec3_SqrDistance( out.position, player->body.position ) < maxRadius * maxRadius ) {
-                    standUp = 0;
-                    player->crouch = true;
-                }
+            float maxRadius = player->shape.sphereRadius + 0.4f;
+            TRay headRay = Ray_SetDirection( player->body.position, Vec3_Set( 0.0f, maxRadius, 0.0f ));
+            if( Ray_Occluded( &headRay, 0.0f, 1.0f )) {
+                standUp = 0;
+                player->crouch = true;
             }
             if( standUp ) {
                 if( player->body.shape->sphereRadius < player->standRadius ) {
@@ -191,12 +189,13 @@ void Player_Update( float timeStep ) {
                 }
             }
             // select emittable sounds
-            if( lowestContact->triangle ) {
+            if( lowestContact->triangle && lowestContact->triangle->material ) {
+                TAtom materialName = lowestContact->triangle->material->name;
                 // iterate over all possible step sound groups
                 for( int i = 0; i < STEP_GROUP_COUNT; i++ ) {
                     // iterate over each material in group
                     for( int j = 0; j < player->stepSounds[i].materialCount; j++ ) {
-                        if( lowestContact->triangle->material == player->stepSounds[i].material[j] ) {
+                        if( materialName == player->stepSounds[i].material[j] ) {
                             player->stepSoundGroup = &player->stepSounds[i];
                         }
                     }
@@ -18,7 +18,7 @@ typedef struct {
     TSound sounds[GROUP_MAX_SOUNDS];
     int count;
     // material need to identify step sound
-    TTexture * material[GROUP_MAX_MATERIALS];
+    TAtom material[GROUP_MAX_MATERIALS]; // texture names
     int materialCount;
 } TSoundGroup;
 
@@ -0,0 +1,88 @@
+#include "pool.h"
+#include "memory.h"
+#include <string.h>
+
+#define POOL_PAGE_HEADER_SIZE ((sizeof( TPoolPage ) + 15) & ~15)
+
+void Pool_Create( TPool * pool, int elementSize, int elementsPerPage, bool threadSafe ) {
+    pool->elementSize = elementSize;
+    pool->elementsPerPage = elementsPerPage;
+    pool->pages = NULL;
+    pool->freeList = NULL;
+    pool->cursor = NULL;
+    pool->end = NULL;
+    pool->usedCount = 0;
+    pool->threadSafe = threadSafe;
+    pool->lock = NULL;
+}
+
+static int Pool_GetStride( TPool * pool ) {
+    // element must be able to hold free list link and keep pointer alignment
+    int stride = pool->elementSize < (int)sizeof( void * ) ? (int)sizeof( void * ) : pool->elementSize;
+    return ( stride + sizeof( void * ) - 1 ) & ~( sizeof( void * ) - 1 );
+}
+
+static void Pool_Lock( TPool * pool ) {
+    if( pool->threadSafe ) {
+        if( !pool->lock ) {
+            pool->lock = CriticalSection_Create();
+        }
+        CriticalSection_Enter( pool->lock );
+    }
+}
+
+static void Pool_Unlock( TPool * pool ) {
+    if( pool->threadSafe ) {
+        CriticalSection_Leave( pool->lock );
+    }
+}
+
+void * Pool_Allocate( TPool * pool ) {
+    int stride = Pool_GetStride( pool );
+    Pool_Lock( pool );
+    void * element;
+    if( pool->freeList ) {
+        element = pool->freeList;
+        pool->freeList = *(void**)element;
+    } else {
+        if( pool->cursor + stride > pool->end ) {
+            TPoolPage * page = Memory_Allocate( POOL_PAGE_HEADER_SIZE + stride * pool->elementsPerPage );
+            page->next = pool->pages;
+            pool->pages = page;
+            pool->cursor = (char*)page + POOL_PAGE_HEADER_SIZE;
+            pool->end = pool->cursor + stride * pool->elementsPerPage;
+        }
+        element = pool->cursor;
+        pool->cursor += stride;
+    }
+    pool->usedCount++;
+    Pool_Unlock( pool );
+    memset( element, 0, pool->elementSize );
+    return element;
+}
+
+void Pool_Release( TPool * pool, void * element ) {
+    if( !element ) {
+        return;
+    }
+    Pool_Lock( pool );
+    *(void**)element = pool->freeList;
+    pool->freeList = element;
+    pool->usedCount--;
+    Pool_Unlock( pool );
+}
+
+void Pool_Free( TPool * pool ) {
+    Pool_Lock( pool );
+    TPoolPage * next;
+    for( TPoolPage * page = pool->pages; page; page = next ) {
+        next = page->next;
+        Memory_Free( page );
+    }
+    pool->pages = NULL;
+    pool->freeList = NULL;
+    pool->cursor = NULL;
+    pool->end = NULL;
+    pool->usedCount = 0;
+    Pool_Unlock( pool );
+}
@@ -0,0 +1,42 @@
+#ifndef _POOL_
+#define _POOL_
+
+#include <stdbool.h>
+#include "thread.h"
+
+// Pool allocates objects of the same size from big pages, so objects are placed
+// contiguously in memory. Released objects go to free list and are reused by next
+// allocations. All objects can be released at once with Pool_Free.
+
+typedef struct TPoolPage {
+    struct TPoolPage * next;
+} TPoolPage;
+
+typedef struct TPool {
+    int elementSize;
+    int elementsPerPage;
+    TPoolPage * pages;
+    // released elements, linked through first bytes of element
+    void * freeList;
+    // unused part of last page
+    char * cursor;
+    char * end;
+    int usedCount;
+    // thread-safe pools are protected by critical section
+    bool threadSafe;
+    TCriticalSection lock;
+} TPool;
+
+// initializer for global pools, thread-safe pool must be used first by main thread
+#define POOL_INITIALIZER( typeName, elementsPerPage, threadSafe ) { sizeof( typeName ), (elementsPerPage), NULL, NULL, NULL, NULL, 0, (threadSafe), NULL }
+
+void Pool_Create( TPool * pool, int elementSize, int elementsPerPage, bool threadSafe );
+// returns element filled with zeros
+void * Pool_Allocate( TPool * pool );
+void Pool_Release( TPool * pool, void * element );
+// releases all elements and pages of pool
+void Pool_Free( TPool * pool );
+
+#define Pool_New( pool, typeName ) ((typeName*)Pool_Allocate( pool ))
+
+#endif
@@ -6,7 +6,9 @@
 typedef struct TProjectileSoundBase {
     bool initialized;
     TSoundBuffer bulletImpact[ IST_COUNT ];
-    TValueArray materials[ IST_COUNT ];
+    // texture names of each material
+    TAtom * materials[ IST_COUNT ];
+    int materialCount[ IST_COUNT ];
 } TProjectileSoundBase;
 
 TProjectileSoundBase gProjectileSndBase;
@@ -14,26 +16,37 @@ TProjectileSoundBase gProjectileSndBase;
 void Projectile_EmitHitSound( TProjectile * proj, TTexture * texture ) {    
     // select proper sound by texture
     for( int storageNum = 0; storageNum < IST_COUNT; storageNum++ ) {
-        for( int i = 0; i < gProjectileSndBase.materials[storageNum].count; i++ ) {
-            TValue * value = &gProjectileSndBase.materials[storageNum].values[i];
-            if( strcmp( value->string, texture->fileName ) == 0 ) {
+        for( int i = 0; i < gProjectileSndBase.materialCount[storageNum]; i++ ) {
+            if( gProjectileSndBase.materials[storageNum][i] == texture->name ) {
                 SoundSource_Create( &proj->hitSound, &gProjectileSndBase.bulletImpact[storageNum] );
                 SoundSource_Play( &proj->hitSound );
+                return;
             }
         }
     }
 }
 
+void Projectile_LoadMaterials( const char * fileName, int storageNum ) {
+    TValueArray values;
+    Parser_LoadFile( fileName, &values );
+    gProjectileSndBase.materials[storageNum] = Memory_NewCount( values.count, TAtom );
+    for( int i = 0; i < values.count; i++ ) {
+        gProjectileSndBase.materials[storageNum][i] = Atom_Intern( values.values[i].string );
+    }
+    gProjectileSndBase.materialCount[storageNum] = values.count;
+    ValueArray_Free( &values );
+}
+
 void Projectile_LoadSoundBufferBase( void ) {
     gProjectileSndBase.initialized = true;
     SoundBuffer_LoadFile( "data/sounds/bullet_metal_impact.ogg", &gProjectileSndBase.bulletImpact[ IST_METAL ], false );
     SoundBuffer_LoadFile( "data/sounds/bullet_concrete_impact.ogg", &gProjectileSndBase.bulletImpact[ IST_CONCRETE ], false );
     SoundBuffer_LoadFile( "data/sounds/bullet_wood_impact.ogg", &gProjectileSndBase.bulletImpact[ IST_WOOD ], false );
     SoundBuffer_LoadFile( "data/sounds/bullet_soil_impact.ogg", &gProjectileSndBase.bulletImpact[ IST_SOIL ], false );
-    Parser_LoadFile( "data/materials/metal.mtl", &gProjectileSndBase.materials[ IST_METAL ] );
-    Parser_LoadFile( "data/materials/stone.mtl", &gProjectileSndBase.materials[ IST_CONCRETE ] );
-    Parser_LoadFile( "data/materials/wood.mtl", &gProjectileSndBase.materials[ IST_WOOD ] );
-    Parser_LoadFile( "data/materials/soil.mtl", &gProjectileSndBase.materials[ IST_SOIL ] );
+    Projectile_LoadMaterials( "data/materials/metal.mtl", IST_METAL );
+    Projectile_LoadMaterials( "data/materials/stone.mtl", IST_CONCRETE );
+    Projectile_LoadMaterials( "data/materials/wood.mtl", IST_WOOD );
+    Projectile_LoadMaterials( "data/materials/soil.mtl", IST_SOIL );
 }
 
 void Projectile_Update( TProjectile * proj ) {
@@ -75,13 +88,13 @@ void Projectile_Free( TProjectile * proj ) {
     Memory_Free( proj );
 }
 
-TProjectile * Projectile_Create( TWeapon * owner, EProjectileType projType, TEntity * projectileModel ) {
+TProjectile * Projectile_Create( TWeapon * owner, EProjectileType projType, TPrefab * projectilePrefab ) {
     if( !gProjectileSndBase.initialized ) {
         Projectile_LoadSoundBufferBase();        
     }
     
     TProjectile * proj = Memory_New( TProjectile );
-    proj->model = Entity_CreateInstance( projectileModel );
+    proj->model = Prefab_Instantiate( projectilePrefab );
     proj->owner = owner;
     switch( projType ) {
         case PROJECTILE_PLASMA: {
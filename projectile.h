@@ -39,7 +39,7 @@ typedef enum EImpactSoundType {
 } EImpactSoundType;
 
 void Projectile_Update( TProjectile * proj );
-TProjectile * Projectile_Create( struct TWeapon * owner, EProjectileType projType, TEntity * projectileModel );
+TProjectile * Projectile_Create( struct TWeapon * owner, EProjectileType projType, TPrefab * projectilePrefab );
 void Projectile_DoPrecalculations( TProjectile * proj );
 void Projectile_Free( TProjectile * proj );
 
@@ -261,7 +261,8 @@ void Renderer_BuildSurfaceBuffers( TSurface * surf ) {
         Debug_CheckGLError( glBindBufferARB( GL_ARRAY_BUFFER_ARB, 0 ));
     }
     // index buffers 
-    TRawIndex * tempIndices = Memory_NewCount( surf->faceCount, TRawIndex );
+    TScratchMark mark = Scratch_GetMark();
+    TRawIndex * tempIndices = Scratch_NewCount( surf->faceCount, TRawIndex );
     if( surf->lightmapCount > 0 ) {
         int index = 0;
         while( true ) {
@@ -299,7 +300,7 @@ void Renderer_BuildSurfaceBuffers( TSurface * surf ) {
         Debug_CheckGLError( glBufferDataARB( GL_ELEMENT_ARRAY_BUFFER_ARB, surf->faceCount * sizeof( TRawIndex ), tempIndices, GL_STATIC_DRAW_ARB ));
         Debug_CheckGLError( glBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, 0 ));
     }
-    Memory_Free( tempIndices );        
+    Scratch_Rewind( mark );
     surf->buffersReady = true;
 }
 
@@ -338,18 +339,10 @@ void Renderer_RenderSurface( TSurface * surf, TMatrix4 mvp, TEntity * owner ) {
         Renderer_CheckCgError( cgGLBindProgram( gRenderer->lightProgram.vertex ));
 
         Renderer_CheckCgError( cgSetMatrixParameterfr( gRenderer->lightProgram.vMVP, mvp.f ));
-        Renderer_CheckCgError( cgSetMatrixParameterfr( gRenderer->lightProgram.vWorld, owner->globalTransform.f ));
+        Renderer_CheckCgError( cgSetMatrixParameterfr( gRenderer->lightProgram.vWorld, owner->renderTransform.f ));
         Renderer_CheckCgError( cgSetParameter3f( gRenderer->lightProgram.vAmbientColor, gAmbientLight.x, gAmbientLight.y, gAmbientLight.z ));
         
-        TLight * nearest = NULL;
-        float dist = 999999.0f;
-        for_each( TLight, light, g_lights ) {
-            float cdist = Vec3_Distance( light->owner->globalPosition, owner->globalPosition );
-            if( cdist < dist ) {
-                dist = cdist;
-                nearest = light;
-            }
-        }
+        TLight * nearest = Light_FindNearest( &owner->globalPosition );
         if( nearest ) {
             TVec3 pos = nearest->owner->globalPosition;
             Renderer_CheckCgError( cgSetParameter3f( gRenderer->lightProgram.vLightPosition, pos.x, pos.y, pos.z ));
@@ -403,19 +396,20 @@ void Renderer_RenderSurface( TSurface * surf, TMatrix4 mvp, TEntity * owner ) {
 }
 
 void Renderer_InitializeFull( const TRenderSettings * settings ) {
+    Memory_PushTag( MEMORY_TAG_RENDER );
     gRenderer = Memory_New( TRenderer );
     Log_Open( &g_log, "OldTech.log" );
     Variable_InitSubSystem();
     Renderer_CreateWindow( settings );
     Renderer_InitializeOpenGL();
     gRenderer->running = true;
+    Memory_PopTag();
 }
 
 void Renderer_RenderWorld() { 
     if( pActiveCamera ) {
-        for_each( TEntity, entity, g_entities ) {
-            Entity_CalculateGlobalTransform( entity );
-
+        for( int entityNum = 0; entityNum < g_entityCount; entityNum++ ) {
+            TEntity * entity = g_entities[ entityNum ];
             bool visible = entity->visible;            
             if( entity->parent ) {
                 visible &= entity->parent->visible;
@@ -435,7 +429,8 @@ void Renderer_RenderWorld() {
                     
                     TVec3 right = { pActiveCamera->viewMatrix.f[0] * halfWidth, pActiveCamera->viewMatrix.f[4] * halfWidth, pActiveCamera->viewMatrix.f[8] * halfWidth };
                     TVec3 up    = { pActiveCamera->viewMatrix.f[1] * halfHeight, pActiveCamera->viewMatrix.f[5] * halfHeight, pActiveCamera->viewMatrix.f[9] * halfHeight };
-                    TVec3 pos   = billboard->owner->globalPosition;
+                    const float * m = billboard->owner->renderTransform.f;
+                    TVec3 pos   = { m[12], m[13], m[14] };
                     
                     Renderer_BindTexture( billboard->texture, 0 );
                     Renderer_SetModelViewTransform( pActiveCamera->viewMatrix );
@@ -466,7 +461,7 @@ void Renderer_RenderWorld() {
                     if( entity->skinned ) {
                         modelViewProjection = pActiveCamera->viewMatrix;
                     } else {
-                        modelViewProjection = Matrix4_Multiply( entity->globalTransform, pActiveCamera->viewMatrix );
+                        modelViewProjection = Matrix4_Multiply( entity->renderTransform, pActiveCamera->viewMatrix );
                     };
                     
                     bool depthHack = fabsf( entity->depthHack ) > 0.0f ;
@@ -824,7 +819,14 @@ void Renderer_FreeOpenGL() {
     Log_Write( "FreeOpenGL: success" );
 }
 
-void Renderer_BeginRender() {
+void Renderer_BeginRender( float alpha ) {
+    // join skinning jobs, skinned vertices are uploaded during rendering
+    World_WaitAnimation();
+    // single transform update per frame, all following code uses cached global transforms
+    World_UpdateTransforms();
+    World_InterpolateTransforms( alpha );
+    Light_UpdateAll();
+    
     if( pActiveCamera ) {
         Debug_CheckGLError( glClearColor( pActiveCamera->clearColor.x, pActiveCamera->clearColor.y, pActiveCamera->clearColor.z, 1.0f ) );
 
@@ -46,7 +46,8 @@ void Renderer_PollWindowMessages( void );
 void Renderer_InitializeOpenGL( void );
 bool Renderer_IsRunning( void );
 void Renderer_FreeOpenGL( void );
-void Renderer_BeginRender( void );
+// alpha is fraction of simulation step passed since last step, see World_InterpolateTransforms
+void Renderer_BeginRender( float alpha );
 void Renderer_EndRender( void );
 void Renderer_BindTexture( TTexture * tex, int level );
 void Renderer_RenderWorld( void );
@@ -0,0 +1,122 @@
+#include "scratch.h"
+#include "memory.h"
+#include "thread.h"
+#include <string.h>
+
+// default size of arena block, bigger allocations get their own block
+#define SCRATCH_BLOCK_SIZE (256 * 1024)
+#define SCRATCH_ALIGNMENT (16)
+
+typedef struct TScratchBlock {
+    struct TScratchBlock * next;
+    int size;
+} TScratchBlock;
+
+#define SCRATCH_BLOCK_HEADER_SIZE ((sizeof( TScratchBlock ) + SCRATCH_ALIGNMENT - 1 ) & ~(SCRATCH_ALIGNMENT - 1))
+#define Scratch_BlockData( block ) ((char*)(block) + SCRATCH_BLOCK_HEADER_SIZE )
+
+typedef struct TScratchArena {
+    // blocks are never freed on rewind, they are reused by next allocations
+    TScratchBlock * first;
+    TScratchBlock * current;
+    int offset;
+    // each of these was a call of allocator before arena
+    int allocationCount;
+} TScratchArena;
+
+TThreadLocal g_scratchArenaSlot;
+
+void Scratch_Initialize( void ) {
+    g_scratchArenaSlot = ThreadLocal_Create();
+}
+
+static TScratchArena * Scratch_GetArena( void ) {
+    TScratchArena * arena = ThreadLocal_Get( g_scratchArenaSlot );
+    if( !arena ) {
+        arena = Memory_New( TScratchArena );
+        ThreadLocal_Set( g_scratchArenaSlot, arena );
+    }
+    return arena;
+}
+
+static TScratchBlock * Scratch_CreateBlock( int size ) {
+    TScratchBlock * block = Memory_Allocate( SCRATCH_BLOCK_HEADER_SIZE + size );
+    block->next = NULL;
+    block->size = size;
+    return block;
+}
+
+void * Scratch_Allocate( int size ) {
+    TScratchArena * arena = Scratch_GetArena();
+    arena->allocationCount++;
+    size = ( size + SCRATCH_ALIGNMENT - 1 ) & ~(SCRATCH_ALIGNMENT - 1);
+    if( !arena->current ) {
+        arena->first = Scratch_CreateBlock( size > SCRATCH_BLOCK_SIZE ? size : SCRATCH_BLOCK_SIZE );
+        arena->current = arena->first;
+        arena->offset = 0;
+    }
+    while( arena->offset + size > arena->current->size ) {
+        // move to next block, create new one if there is no spare block or it is too small
+        TScratchBlock * next = arena->current->next;
+        if( !next || next->size < size ) {
+            TScratchBlock * block = Scratch_CreateBlock( size > SCRATCH_BLOCK_SIZE ? size : SCRATCH_BLOCK_SIZE );
+            block->next = next;
+            arena->current->next = block;
+            next = block;
+        }
+        arena->current = next;
+        arena->offset = 0;
+    }
+    void * data = Scratch_BlockData( arena->current ) + arena->offset;
+    arena->offset += size;
+    return data;
+}
+
+void * Scratch_AllocateClean( int size ) {
+    void * data = Scratch_Allocate( size );
+    memset( data, 0, size );
+    return data;
+}
+
+TScratchMark Scratch_GetMark( void ) {
+    TScratchArena * arena = Scratch_GetArena();
+    TScratchMark mark;
+    mark.block = arena->current;
+    mark.offset = arena->offset;
+    return mark;
+}
+
+void Scratch_Rewind( TScratchMark mark ) {
+    TScratchArena * arena = Scratch_GetArena();
+    if( mark.block ) {
+        arena->current = mark.block;
+        arena->offset = mark.offset;
+    } else {
+        // mark was taken when arena had no blocks
+        arena->current = arena->first;
+        arena->offset = 0;
+    }
+}
+
+void Scratch_Reset( void ) {
+    TScratchArena * arena = Scratch_GetArena();
+    arena->current = arena->first;
+    arena->offset = 0;
+}
+
+int Scratch_GetAllocationCount( void ) {
+    return Scratch_GetArena()->allocationCount;
+}
+
+void Scratch_ReleaseThreadArena( void ) {
+    TScratchArena * arena = ThreadLocal_Get( g_scratchArenaSlot );
+    if( arena ) {
+        TScratchBlock * next;
+        for( TScratchBlock * block = arena->first; block; block = next ) {
+            next = block->next;
+            Memory_Free( block );
+        }
+        Memory_Free( arena );
+        ThreadLocal_Set( g_scratchArenaSlot, NULL );
+    }
+}
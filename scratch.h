@@ -0,0 +1,39 @@
+#ifndef _SCRATCH_
+#define _SCRATCH_
+
+// Scratch arena is a linear allocator for short-living temporary data. Each thread
+// has its own arena, so it can be used from worker threads without any locking.
+// Memory is returned by rewinding arena to the mark taken before allocation:
+//
+//      TScratchMark mark = Scratch_GetMark();
+//      int * indices = Scratch_NewCount( count, int );
+//      ...
+//      Scratch_Rewind( mark );
+//
+// Arena of the main thread is also reset at the beginning of each frame.
+
+typedef struct TScratchMark {
+    struct TScratchBlock * block;
+    int offset;
+} TScratchMark;
+
+// must be called once from the main thread before any other thread starts
+void Scratch_Initialize( void );
+// allocate memory from arena of calling thread without cleaning
+void * Scratch_Allocate( int size );
+// allocate memory from arena of calling thread filled with zeros
+void * Scratch_AllocateClean( int size );
+TScratchMark Scratch_GetMark( void );
+// releases everything allocated after mark was taken
+void Scratch_Rewind( TScratchMark mark );
+// releases everything allocated from arena of calling thread
+void Scratch_Reset( void );
+// count of allocations done from arena of calling thread since it was created
+int Scratch_GetAllocationCount( void );
+// frees arena of calling thread, called automatically when thread started with Thread_Start is finished
+void Scratch_ReleaseThreadArena( void );
+
+#define Scratch_New( typeName ) ((typeName*)Scratch_AllocateClean( sizeof( typeName )))
+#define Scratch_NewCount( count, typeName ) ((typeName*)Scratch_AllocateClean( (count) * sizeof( typeName )))
+
+#endif
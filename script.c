@@ -6,8 +6,33 @@
 
 lua_State * gLua = NULL;
 
+// routes all Lua allocations through engine allocator, so they are visible in memory statistics
+static void * Script_Allocate( void * ud, void * ptr, size_t osize, size_t nsize ) {
+    UNUSED_VARIABLE( ud );
+    UNUSED_VARIABLE( osize );
+    if( nsize == 0 ) {
+        if( ptr ) {
+            Memory_Free( ptr );
+        }
+        return NULL;
+    }
+    Memory_PushTag( MEMORY_TAG_SCRIPT );
+    void * block = Memory_Reallocate( ptr, nsize );
+    Memory_PopTag();
+    return block;
+}
+
+static int Script_Panic( lua_State * L ) {
+    Util_RaiseError( "Unprotected error in Lua: %s", lua_tostring( L, -1 ));
+    return 0;
+}
+
 void ScriptSystem_Initialize() {
-    gLua = luaL_newstate( );
+    gLua = lua_newstate( Script_Allocate, NULL );
+    if( !gLua ) {
+        Util_RaiseError( "Unable to create Lua state" );
+    }
+    lua_atpanic( gLua, Script_Panic );
     luaL_openlibs( gLua );
     ScriptSystem_InitializeAPI();
 }
@@ -0,0 +1,240 @@
+#include "skin.h"
+#include "timer.h"
+
+#ifdef OLDTECH_SSE
+#   include <xmmintrin.h>
+#endif
+
+void SkinData_Create( TSkinData * skin, const TVertex * vertices, int vertexCount, int boneCount ) {
+    if( boneCount > SKIN_MAX_BONES ) {
+        Util_RaiseError( "Skinned surface has %d bones, but only %d are supported!", boneCount, SKIN_MAX_BONES );
+    }
+    skin->vertexCount = vertexCount;
+    skin->positions = Memory_NewCount( vertexCount * 4, float );
+    skin->normals = Memory_NewCount( vertexCount * 4, float );
+    skin->tangents = Memory_NewCount( vertexCount * 4, float );
+    skin->boneIndices = Memory_NewCount( vertexCount * SKIN_BONES_PER_VERTEX, unsigned char );
+    skin->boneWeights = Memory_NewCount( vertexCount * SKIN_BONES_PER_VERTEX, float );
+    for( int i = 0; i < vertexCount; i++ ) {
+        const TVertex * v = vertices + i;
+        float * p = skin->positions + i * 4;
+        float * n = skin->normals + i * 4;
+        float * t = skin->tangents + i * 4;
+        p[0] = v->p.x; p[1] = v->p.y; p[2] = v->p.z; p[3] = 1.0f;
+        n[0] = v->n.x; n[1] = v->n.y; n[2] = v->n.z; n[3] = 0.0f;
+        t[0] = v->tg.x; t[1] = v->tg.y; t[2] = v->tg.z; t[3] = 0.0f;
+    }
+    skin->maxInfluences = SKIN_BONES_PER_VERTEX;
+    skin->queued = false;
+    skin->boneCount = boneCount;
+    skin->bones = Memory_NewCount( boneCount + 1, struct TEntity * );
+    skin->palette = Memory_NewCount( boneCount + 1, TMatrix4 );
+    for( int i = 0; i < boneCount; i++ ) {
+        skin->palette[i] = Matrix4_Identity();
+    }
+}
+
+void SkinData_Free( TSkinData * skin ) {
+    if( skin->positions ) {
+        Memory_Free( skin->positions );
+        Memory_Free( skin->normals );
+        Memory_Free( skin->tangents );
+        Memory_Free( skin->boneIndices );
+        Memory_Free( skin->boneWeights );
+        Memory_Free( skin->bones );
+        Memory_Free( skin->palette );
+    }
+    memset( skin, 0, sizeof( *skin ));
+}
+
+// keeps sum of used weights equal to one
+static inline float Skin_GetWeightScale( const TSkinData * skin, const float * weight ) {
+    if( skin->maxInfluences >= SKIN_BONES_PER_VERTEX ) {
+        return 1.0f;
+    }
+    float sum = 0.0f;
+    for( int k = 0; k < skin->maxInfluences; k++ ) {
+        sum += weight[k];
+    }
+    return sum > 0.0f ? 1.0f / sum : 0.0f;
+}
+
+#ifdef OLDTECH_SSE
+#define SKIN_SPLAT( v, i ) _mm_shuffle_ps( (v), (v), _MM_SHUFFLE( (i), (i), (i), (i) ))
+
+static void Skin_Store3( TVec3 * out, __m128 v ) {
+    float temp[4];
+    _mm_storeu_ps( temp, v );
+    out->x = temp[0];
+    out->y = temp[1];
+    out->z = temp[2];
+}
+
+void Skin_Apply( const TSkinData * skin, TVertex * out ) {
+    for( int i = 0; i < skin->vertexCount; i++ ) {
+        const unsigned char * index = skin->boneIndices + i * SKIN_BONES_PER_VERTEX;
+        const float * weight = skin->boneWeights + i * SKIN_BONES_PER_VERTEX;
+        float scale = Skin_GetWeightScale( skin, weight );
+        // blend bone matrices first, so each attribute is transformed only once. unused
+        // bones have zero weight, so there is no branches
+        __m128 r0 = _mm_setzero_ps(), r1 = _mm_setzero_ps(), r2 = _mm_setzero_ps(), r3 = _mm_setzero_ps();
+        for( int k = 0; k < skin->maxInfluences; k++ ) {
+            const float * m = skin->palette[ index[k] ].f;
+            __m128 w = _mm_set1_ps( weight[k] * scale );
+            r0 = _mm_add_ps( r0, _mm_mul_ps( w, _mm_loadu_ps( m + 0 )));
+            r1 = _mm_add_ps( r1, _mm_mul_ps( w, _mm_loadu_ps( m + 4 )));
+            r2 = _mm_add_ps( r2, _mm_mul_ps( w, _mm_loadu_ps( m + 8 )));
+            r3 = _mm_add_ps( r3, _mm_mul_ps( w, _mm_loadu_ps( m + 12 )));
+        }
+        __m128 p = _mm_loadu_ps( skin->positions + i * 4 );
+        __m128 n = _mm_loadu_ps( skin->normals + i * 4 );
+        __m128 t = _mm_loadu_ps( skin->tangents + i * 4 );
+        __m128 sp = _mm_add_ps( _mm_add_ps( _mm_mul_ps( SKIN_SPLAT( p, 0 ), r0 ), _mm_mul_ps( SKIN_SPLAT( p, 1 ), r1 )), _mm_add_ps( _mm_mul_ps( SKIN_SPLAT( p, 2 ), r2 ), r3 ));
+        __m128 sn = _mm_add_ps( _mm_add_ps( _mm_mul_ps( SKIN_SPLAT( n, 0 ), r0 ), _mm_mul_ps( SKIN_SPLAT( n, 1 ), r1 )), _mm_mul_ps( SKIN_SPLAT( n, 2 ), r2 ));
+        __m128 st = _mm_add_ps( _mm_add_ps( _mm_mul_ps( SKIN_SPLAT( t, 0 ), r0 ), _mm_mul_ps( SKIN_SPLAT( t, 1 ), r1 )), _mm_mul_ps( SKIN_SPLAT( t, 2 ), r2 ));
+        // vertex fields are packed, so 16-byte stores would overwrite neighbours
+        TVertex * v = out + i;
+        Skin_Store3( &v->p, sp );
+        Skin_Store3( &v->n, sn );
+        Skin_Store3( &v->tg, st );
+    }
+}
+#else
+void Skin_Apply( const TSkinData * skin, TVertex * out ) {
+    for( int i = 0; i < skin->vertexCount; i++ ) {
+        const unsigned char * index = skin->boneIndices + i * SKIN_BONES_PER_VERTEX;
+        const float * weight = skin->boneWeights + i * SKIN_BONES_PER_VERTEX;
+        float scale = Skin_GetWeightScale( skin, weight );
+        float m[16] = { 0.0f };
+        for( int k = 0; k < skin->maxInfluences; k++ ) {
+            const float * bm = skin->palette[ index[k] ].f;
+            for( int e = 0; e < 16; e++ ) {
+                m[e] += weight[k] * scale * bm[e];
+            }
+        }
+        const float * p = skin->positions + i * 4;
+        const float * n = skin->normals + i * 4;
+        const float * t = skin->tangents + i * 4;
+        TVertex * v = out + i;
+        v->p.x = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
+        v->p.y = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
+        v->p.z = p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14];
+        v->n.x = n[0] * m[0] + n[1] * m[4] + n[2] * m[8];
+        v->n.y = n[0] * m[1] + n[1] * m[5] + n[2] * m[9];
+        v->n.z = n[0] * m[2] + n[1] * m[6] + n[2] * m[10];
+        v->tg.x = t[0] * m[0] + t[1] * m[4] + t[2] * m[8];
+        v->tg.y = t[0] * m[1] + t[1] * m[5] + t[2] * m[9];
+        v->tg.z = t[0] * m[2] + t[1] * m[6] + t[2] * m[10];
+    }
+}
+#endif
+
+#define TEST_SKIN_VERTEX_COUNT (1000)
+#define BENCHMARK_SKIN_VERTEX_COUNT (20000)
+#define TEST_SKIN_BONE_COUNT (64)
+
+// previous path: bone group with own copy of bone matrix for each influence
+typedef struct TTestSkinBone {
+    float weight;
+    int boneId;
+    void * boneEnt;
+    TMatrix4 transform;
+} TTestSkinBone;
+
+typedef struct TTestSkinBoneGroup {
+    TTestSkinBone bones[SKIN_BONES_PER_VERTEX];
+    int boneCount;
+} TTestSkinBoneGroup;
+
+// random vertices with up to four influences, same weights in both layouts
+static void Test_FillSkin( TSkinData * skin, TTestSkinBoneGroup * groups, TVertex * vertices, int vertexCount ) {
+    TMatrix4 boneTransforms[TEST_SKIN_BONE_COUNT];
+    for( int i = 0; i < TEST_SKIN_BONE_COUNT; i++ ) {
+        TQuaternion rotation = Quaternion_SetEulerAngles( rand() % 360, rand() % 360, rand() % 360 );
+        boneTransforms[i] = Matrix4_SetRotationOrigin( rotation, Vec3_Set( rand() % 10, rand() % 10, rand() % 10 ));
+    }
+    for( int i = 0; i < vertexCount; i++ ) {
+        vertices[i].p = Vec3_Set( rand() % 100, rand() % 100, rand() % 100 );
+        vertices[i].n = Vec3_Normalize( Vec3_Set( 1 + rand() % 10, rand() % 10, rand() % 10 ));
+        vertices[i].tg = Vec3_Normalize( Vec3_Set( rand() % 10, 1 + rand() % 10, rand() % 10 ));
+    }
+    SkinData_Create( skin, vertices, vertexCount, TEST_SKIN_BONE_COUNT );
+    for( int i = 0; i < TEST_SKIN_BONE_COUNT; i++ ) {
+        skin->palette[i] = boneTransforms[i];
+    }
+    for( int i = 0; i < vertexCount; i++ ) {
+        TTestSkinBoneGroup * bg = groups + i;
+        bg->boneCount = 1 + rand() % SKIN_BONES_PER_VERTEX;
+        for( int k = 0; k < bg->boneCount; k++ ) {
+            bg->bones[k].boneId = rand() % TEST_SKIN_BONE_COUNT;
+            bg->bones[k].weight = 1.0f / bg->boneCount;
+            bg->bones[k].transform = boneTransforms[ bg->bones[k].boneId ];
+            skin->boneIndices[ i * SKIN_BONES_PER_VERTEX + k ] = bg->bones[k].boneId;
+            skin->boneWeights[ i * SKIN_BONES_PER_VERTEX + k ] = bg->bones[k].weight;
+        }
+    }
+}
+
+static void Test_SkinPerBone( const TTestSkinBoneGroup * groups, const TVertex * vertices, TVertex * result, int vertexCount ) {
+    for( int i = 0; i < vertexCount; i++ ) {
+        const TTestSkinBoneGroup * bg = groups + i;
+        result[i].p = Vec3_Zero();
+        for( int k = 0; k < bg->boneCount; k++ ) {
+            const TTestSkinBone * bone = &bg->bones[k];
+            TVec3 transformed = Matrix4_TransformVector( bone->transform, vertices[i].p );
+            result[i].p = Vec3_Add( result[i].p, Vec3_Scale( transformed, bone->weight ));
+        }
+    }
+}
+
+void Test_Skinning( void ) {
+    TVertex * vertices = Memory_NewCount( TEST_SKIN_VERTEX_COUNT, TVertex );
+    TVertex * oldResult = Memory_NewCount( TEST_SKIN_VERTEX_COUNT, TVertex );
+    TVertex * newResult = Memory_NewCount( TEST_SKIN_VERTEX_COUNT, TVertex );
+    TTestSkinBoneGroup * groups = Memory_NewCount( TEST_SKIN_VERTEX_COUNT, TTestSkinBoneGroup );
+    TSkinData skin;
+    Test_FillSkin( &skin, groups, vertices, TEST_SKIN_VERTEX_COUNT );
+    Test_SkinPerBone( groups, vertices, oldResult, TEST_SKIN_VERTEX_COUNT );
+    Skin_Apply( &skin, newResult );
+    for( int i = 0; i < TEST_SKIN_VERTEX_COUNT; i++ ) {
+        float a[3] = { oldResult[i].p.x, oldResult[i].p.y, oldResult[i].p.z };
+        float b[3] = { newResult[i].p.x, newResult[i].p.y, newResult[i].p.z };
+        for( int k = 0; k < 3; k++ ) {
+            if( fabs( a[k] - b[k] ) > 0.001f * ( 1.0f + fabs( a[k] ))) {
+                Util_RaiseError( "Test_Skinning: vertex %d mismatch!", i );
+            }
+        }
+        // rigid bones keep length of normals
+        if( groups[i].boneCount == 1 && fabs( Vec3_Length( newResult[i].n ) - 1.0f ) > 0.001f ) {
+            Util_RaiseError( "Test_Skinning: normal %d mismatch!", i );
+        }
+    }
+    SkinData_Free( &skin );
+    Memory_Free( groups );
+    Memory_Free( newResult );
+    Memory_Free( oldResult );
+    Memory_Free( vertices );
+}
+
+void Benchmark_Skinning( void ) {
+    TVertex * vertices = Memory_NewCount( BENCHMARK_SKIN_VERTEX_COUNT, TVertex );
+    TVertex * oldResult = Memory_NewCount( BENCHMARK_SKIN_VERTEX_COUNT, TVertex );
+    TVertex * newResult = Memory_NewCount( BENCHMARK_SKIN_VERTEX_COUNT, TVertex );
+    TTestSkinBoneGroup * groups = Memory_NewCount( BENCHMARK_SKIN_VERTEX_COUNT, TTestSkinBoneGroup );
+    TSkinData skin;
+    Test_FillSkin( &skin, groups, vertices, BENCHMARK_SKIN_VERTEX_COUNT );
+    TTimer timer;
+    Timer_Create( &timer );
+    Test_SkinPerBone( groups, vertices, oldResult, BENCHMARK_SKIN_VERTEX_COUNT );
+    double oldTime = Timer_GetElapsedMilliseconds( &timer );
+    Timer_Restart( &timer );
+    Skin_Apply( &skin, newResult );
+    double newTime = Timer_GetElapsedMilliseconds( &timer );
+    printf( "Skinning: %d vertices: per-bone loop (positions) %.3f ms, kernel (positions, normals, tangents) %.3f ms\n",
+        BENCHMARK_SKIN_VERTEX_COUNT, oldTime, newTime );
+    SkinData_Free( &skin );
+    Memory_Free( groups );
+    Memory_Free( newResult );
+    Memory_Free( oldResult );
+    Memory_Free( vertices );
+}
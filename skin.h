@@ -0,0 +1,45 @@
+#ifndef _SKIN_
+#define _SKIN_
+
+#include "common.h"
+#include "vertex.h"
+#include "matrix4.h"
+
+OLDTECH_BEGIN_HEADER
+
+#define SKIN_MAX_BONES (256)
+#define SKIN_BONES_PER_VERTEX (4)
+
+// vertex data of skinned surface laid out for batch skinning. each attribute is stored
+// in separate stream with four floats per vertex, so it can be loaded with one instruction
+typedef struct TSkinData {
+    int vertexCount;
+    float * positions; // x, y, z, 1
+    float * normals; // x, y, z, 0
+    float * tangents; // x, y, z, 0
+    unsigned char * boneIndices; // four palette indices per vertex
+    float * boneWeights; // four weights per vertex sorted by descending, unused weights are zero
+    int maxInfluences; // count of strongest bones used by skinning, reduced by animation LOD
+    // palette of bones affecting the surface
+    int boneCount;
+    struct TEntity ** bones;
+    TMatrix4 * palette; // final bone transforms, filled by owner before skinning
+    bool queued; // surface is already in skinning queue of current update
+} TSkinData;
+
+// copies bind pose from vertices, bone indices and weights are zeroed, palette is identity,
+// all four influences are used
+void SkinData_Create( TSkinData * skin, const TVertex * vertices, int vertexCount, int boneCount );
+void SkinData_Free( TSkinData * skin );
+// writes skinned positions, normals and tangents of all vertices to 'out', when not all
+// influences are used, weights of used ones are renormalized
+void Skin_Apply( const TSkinData * skin, TVertex * out );
+
+// tests
+void Test_Skinning( void );
+// prints time of skinning kernel against per-bone loop with matrix copy per influence
+void Benchmark_Skinning( void );
+
+OLDTECH_END_HEADER
+
+#endif
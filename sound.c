@@ -139,7 +139,9 @@ void SoundBuffer_LoadFile( const char * filename, TSoundBuffer * buffer, char st
         buffer->blockSize = buffer->totalBytes;
     };
 
+    Memory_PushTag( MEMORY_TAG_AUDIO );
     buffer->data = Memory_AllocateClean( buffer->blockSize );
+    Memory_PopTag();
 
     if( !streamed ) {
         /* read entire file from file */
@@ -0,0 +1,569 @@
+#include "spatial.h"
+#include "timer.h"
+
+#define SPATIAL_STACK_SIZE (256)
+
+static TVec3 SpatialTree_Min( const TVec3 * a, const TVec3 * b ) {
+    return Vec3_Set( a->x < b->x ? a->x : b->x, a->y < b->y ? a->y : b->y, a->z < b->z ? a->z : b->z );
+}
+
+static TVec3 SpatialTree_Max( const TVec3 * a, const TVec3 * b ) {
+    return Vec3_Set( a->x > b->x ? a->x : b->x, a->y > b->y ? a->y : b->y, a->z > b->z ? a->z : b->z );
+}
+
+static float SpatialTree_Area( const TVec3 * min, const TVec3 * max ) {
+    TVec3 d = Vec3_Sub( *max, *min );
+    return 2.0f * ( d.x * d.y + d.y * d.z + d.z * d.x );
+}
+
+// area of union of bounds of two nodes
+static float SpatialTree_UnionArea( const TSpatialNode * a, const TSpatialNode * b ) {
+    TVec3 min = SpatialTree_Min( &a->min, &b->min );
+    TVec3 max = SpatialTree_Max( &a->max, &b->max );
+    return SpatialTree_Area( &min, &max );
+}
+
+// recalculates bounds and height of inner node from its childs
+static void SpatialTree_Refit( TSpatialTree * tree, int index ) {
+    TSpatialNode * node = tree->nodes + index;
+    TSpatialNode * a = tree->nodes + node->child[0];
+    TSpatialNode * b = tree->nodes + node->child[1];
+    node->min = SpatialTree_Min( &a->min, &b->min );
+    node->max = SpatialTree_Max( &a->max, &b->max );
+    node->height = 1 + ( a->height > b->height ? a->height : b->height );
+}
+
+static int SpatialTree_AllocateNode( TSpatialTree * tree ) {
+    if( tree->freeList == SPATIAL_NULL ) {
+        int oldCapacity = tree->capacity;
+        tree->capacity = tree->capacity ? tree->capacity * 2 : 16;
+        tree->nodes = Memory_Reallocate( tree->nodes, tree->capacity * sizeof( TSpatialNode ));
+        for( int i = tree->capacity - 1; i >= oldCapacity; i-- ) {
+            tree->nodes[i].parent = tree->freeList;
+            tree->nodes[i].height = -1;
+            tree->freeList = i;
+        }
+    }
+    int index = tree->freeList;
+    TSpatialNode * node = tree->nodes + index;
+    tree->freeList = node->parent;
+    node->parent = SPATIAL_NULL;
+    node->child[0] = SPATIAL_NULL;
+    node->child[1] = SPATIAL_NULL;
+    node->height = 0;
+    node->data = NULL;
+    return index;
+}
+
+static void SpatialTree_FreeNode( TSpatialTree * tree, int index ) {
+    tree->nodes[index].parent = tree->freeList;
+    tree->nodes[index].height = -1;
+    tree->freeList = index;
+}
+
+// replaces child of parent of 'index' by 'replacement', or root if it has no parent
+static void SpatialTree_ReplaceChild( TSpatialTree * tree, int parent, int index, int replacement ) {
+    if( parent == SPATIAL_NULL ) {
+        tree->root = replacement;
+    } else if( tree->nodes[parent].child[0] == index ) {
+        tree->nodes[parent].child[0] = replacement;
+    } else {
+        tree->nodes[parent].child[1] = replacement;
+    }
+}
+
+// rotates higher grandchild up if subtree of 'a' is unbalanced, returns new root of the subtree
+static int SpatialTree_Balance( TSpatialTree * tree, int a ) {
+    TSpatialNode * nodes = tree->nodes;
+    if( nodes[a].height < 2 ) {
+        return a;
+    }
+    for( int side = 0; side < 2; side++ ) {
+        // 'up' is child which becomes parent of 'a', 'other' stays with 'a'
+        int up = nodes[a].child[side];
+        int other = nodes[a].child[1 - side];
+        if( nodes[up].height - nodes[other].height <= 1 ) {
+            continue;
+        }
+        int f = nodes[up].child[0];
+        int g = nodes[up].child[1];
+        nodes[up].child[0] = a;
+        nodes[up].parent = nodes[a].parent;
+        nodes[a].parent = up;
+        SpatialTree_ReplaceChild( tree, nodes[up].parent, a, up );
+        // higher grandchild stays with 'up', lower one goes to 'a'
+        int high = nodes[f].height > nodes[g].height ? f : g;
+        int low = high == f ? g : f;
+        nodes[up].child[1] = high;
+        nodes[a].child[side] = low;
+        nodes[low].parent = a;
+        SpatialTree_Refit( tree, a );
+        SpatialTree_Refit( tree, up );
+        return up;
+    }
+    return a;
+}
+
+static void SpatialTree_InsertLeaf( TSpatialTree * tree, int leaf ) {
+    if( tree->root == SPATIAL_NULL ) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = SPATIAL_NULL;
+        return;
+    }
+    // descend to the sibling with the least increase of surface area
+    TSpatialNode * leafNode = tree->nodes + leaf;
+    int index = tree->root;
+    while( tree->nodes[index].height > 0 ) {
+        TSpatialNode * node = tree->nodes + index;
+        float area = SpatialTree_Area( &node->min, &node->max );
+        float combinedArea = SpatialTree_UnionArea( node, leafNode );
+        // cost of making new parent for this node and the leaf
+        float cost = 2.0f * combinedArea;
+        // cost which is added to all ancestors when leaf goes deeper
+        float inheritance = 2.0f * ( combinedArea - area );
+        float childCost[2];
+        for( int i = 0; i < 2; i++ ) {
+            TSpatialNode * child = tree->nodes + node->child[i];
+            childCost[i] = SpatialTree_UnionArea( child, leafNode ) + inheritance;
+            if( child->height > 0 ) {
+                childCost[i] -= SpatialTree_Area( &child->min, &child->max );
+            }
+        }
+        if( cost < childCost[0] && cost < childCost[1] ) {
+            break;
+        }
+        index = childCost[0] < childCost[1] ? node->child[0] : node->child[1];
+    }
+    int sibling = index;
+    int oldParent = tree->nodes[sibling].parent;
+    int newParent = SpatialTree_AllocateNode( tree );
+    TSpatialNode * nodes = tree->nodes;
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].child[0] = sibling;
+    nodes[newParent].child[1] = leaf;
+    SpatialTree_ReplaceChild( tree, oldParent, sibling, newParent );
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    // fix bounds and heights of ancestors
+    for( index = newParent; index != SPATIAL_NULL; index = tree->nodes[index].parent ) {
+        SpatialTree_Refit( tree, index );
+        index = SpatialTree_Balance( tree, index );
+    }
+}
+
+static void SpatialTree_RemoveLeaf( TSpatialTree * tree, int leaf ) {
+    if( leaf == tree->root ) {
+        tree->root = SPATIAL_NULL;
+        return;
+    }
+    TSpatialNode * nodes = tree->nodes;
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child[0] == leaf ? nodes[parent].child[1] : nodes[parent].child[0];
+    SpatialTree_ReplaceChild( tree, grandParent, parent, sibling );
+    nodes[sibling].parent = grandParent;
+    SpatialTree_FreeNode( tree, parent );
+    for( int index = grandParent; index != SPATIAL_NULL; index = tree->nodes[index].parent ) {
+        SpatialTree_Refit( tree, index );
+        index = SpatialTree_Balance( tree, index );
+    }
+}
+
+void SpatialTree_Create( TSpatialTree * tree, float margin ) {
+    tree->nodes = NULL;
+    tree->capacity = 0;
+    tree->root = SPATIAL_NULL;
+    tree->freeList = SPATIAL_NULL;
+    tree->leafCount = 0;
+    tree->margin = margin;
+}
+
+void SpatialTree_Free( TSpatialTree * tree ) {
+    if( tree->nodes ) {
+        Memory_Free( tree->nodes );
+    }
+    SpatialTree_Create( tree, tree->margin );
+}
+
+int SpatialTree_Insert( TSpatialTree * tree, const TVec3 * min, const TVec3 * max, void * data ) {
+    int leaf = SpatialTree_AllocateNode( tree );
+    TSpatialNode * node = tree->nodes + leaf;
+    TVec3 margin = Vec3_Set( tree->margin, tree->margin, tree->margin );
+    node->min = Vec3_Sub( *min, margin );
+    node->max = Vec3_Add( *max, margin );
+    node->data = data;
+    SpatialTree_InsertLeaf( tree, leaf );
+    tree->leafCount++;
+    return leaf;
+}
+
+void SpatialTree_Remove( TSpatialTree * tree, int proxy ) {
+    SpatialTree_RemoveLeaf( tree, proxy );
+    SpatialTree_FreeNode( tree, proxy );
+    tree->leafCount--;
+}
+
+bool SpatialTree_Move( TSpatialTree * tree, int proxy, const TVec3 * min, const TVec3 * max ) {
+    TSpatialNode * node = tree->nodes + proxy;
+    if( min->x >= node->min.x && min->y >= node->min.y && min->z >= node->min.z &&
+        max->x <= node->max.x && max->y <= node->max.y && max->z <= node->max.z ) {
+        return false;
+    }
+    SpatialTree_RemoveLeaf( tree, proxy );
+    TVec3 margin = Vec3_Set( tree->margin, tree->margin, tree->margin );
+    node = tree->nodes + proxy;
+    node->min = Vec3_Sub( *min, margin );
+    node->max = Vec3_Add( *max, margin );
+    SpatialTree_InsertLeaf( tree, proxy );
+    return true;
+}
+
+void * SpatialTree_GetData( const TSpatialTree * tree, int proxy ) {
+    return tree->nodes[proxy].data;
+}
+
+static float SpatialTree_SqrDistanceToNode( const TSpatialNode * node, const TVec3 * point ) {
+    float p[3] = { point->x, point->y, point->z };
+    float min[3] = { node->min.x, node->min.y, node->min.z };
+    float max[3] = { node->max.x, node->max.y, node->max.z };
+    float sqrDistance = 0.0f;
+    for( int i = 0; i < 3; i++ ) {
+        float d = p[i] < min[i] ? min[i] - p[i] : ( p[i] > max[i] ? p[i] - max[i] : 0.0f );
+        sqrDistance += d * d;
+    }
+    return sqrDistance;
+}
+
+static bool SpatialTree_RayOverlap( const TSpatialNode * node, const float * begin, const float * dir ) {
+    float min[3] = { node->min.x, node->min.y, node->min.z };
+    float max[3] = { node->max.x, node->max.y, node->max.z };
+    float tMin = 0.0f, tMax = 1.0f;
+    for( int i = 0; i < 3; i++ ) {
+        if( fabsf( dir[i] ) < 1e-12f ) {
+            if( begin[i] < min[i] || begin[i] > max[i] ) {
+                return false;
+            }
+        } else {
+            float inv = 1.0f / dir[i];
+            float t1 = ( min[i] - begin[i] ) * inv;
+            float t2 = ( max[i] - begin[i] ) * inv;
+            if( t1 > t2 ) {
+                float t = t1;
+                t1 = t2;
+                t2 = t;
+            }
+            tMin = t1 > tMin ? t1 : tMin;
+            tMax = t2 < tMax ? t2 : tMax;
+            if( tMin > tMax ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+typedef enum ESpatialQuery {
+    SPATIAL_QUERY_AABB,
+    SPATIAL_QUERY_SPHERE,
+    SPATIAL_QUERY_RAY,
+} ESpatialQuery;
+
+typedef struct TSpatialQuery {
+    ESpatialQuery type;
+    TVec3 min;
+    TVec3 max;
+    TVec3 center;
+    float sqrRadius;
+    float begin[3];
+    float dir[3];
+} TSpatialQuery;
+
+static bool SpatialTree_Overlap( const TSpatialNode * node, const TSpatialQuery * query ) {
+    switch( query->type ) {
+    case SPATIAL_QUERY_AABB:
+        return node->min.x <= query->max.x && node->max.x >= query->min.x &&
+               node->min.y <= query->max.y && node->max.y >= query->min.y &&
+               node->min.z <= query->max.z && node->max.z >= query->min.z;
+    case SPATIAL_QUERY_SPHERE:
+        return SpatialTree_SqrDistanceToNode( node, &query->center ) <= query->sqrRadius;
+    case SPATIAL_QUERY_RAY:
+        return SpatialTree_RayOverlap( node, query->begin, query->dir );
+    }
+    return false;
+}
+
+static void SpatialTree_Query( const TSpatialTree * tree, const TSpatialQuery * query, TSpatialQueryFunc func, void * userData ) {
+    if( tree->root == SPATIAL_NULL ) {
+        return;
+    }
+    int stack[SPATIAL_STACK_SIZE];
+    int top = 0;
+    stack[ top++ ] = tree->root;
+    while( top > 0 ) {
+        const TSpatialNode * node = tree->nodes + stack[ --top ];
+        if( !SpatialTree_Overlap( node, query )) {
+            continue;
+        }
+        if( node->height == 0 ) {
+            if( !func( node->data, userData )) {
+                return;
+            }
+        } else {
+            if( top + 2 > SPATIAL_STACK_SIZE ) {
+                Util_RaiseError( "Spatial tree is too deep!" );
+            }
+            stack[ top++ ] = node->child[0];
+            stack[ top++ ] = node->child[1];
+        }
+    }
+}
+
+void SpatialTree_QueryAABB( const TSpatialTree * tree, const TVec3 * min, const TVec3 * max, TSpatialQueryFunc func, void * userData ) {
+    TSpatialQuery query;
+    query.type = SPATIAL_QUERY_AABB;
+    query.min = *min;
+    query.max = *max;
+    SpatialTree_Query( tree, &query, func, userData );
+}
+
+void SpatialTree_QuerySphere( const TSpatialTree * tree, const TVec3 * center, float radius, TSpatialQueryFunc func, void * userData ) {
+    TSpatialQuery query;
+    query.type = SPATIAL_QUERY_SPHERE;
+    query.center = *center;
+    query.sqrRadius = radius * radius;
+    SpatialTree_Query( tree, &query, func, userData );
+}
+
+void SpatialTree_QueryRay( const TSpatialTree * tree, const TVec3 * begin, const TVec3 * end, TSpatialQueryFunc func, void * userData ) {
+    TSpatialQuery query;
+    query.type = SPATIAL_QUERY_RAY;
+    query.begin[0] = begin->x;
+    query.begin[1] = begin->y;
+    query.begin[2] = begin->z;
+    query.dir[0] = end->x - begin->x;
+    query.dir[1] = end->y - begin->y;
+    query.dir[2] = end->z - begin->z;
+    SpatialTree_Query( tree, &query, func, userData );
+}
+
+typedef struct TSpatialCandidate {
+    float distance;
+    int node;
+} TSpatialCandidate;
+
+int SpatialTree_QueryNearest( const TSpatialTree * tree, const TVec3 * point, int k, TSpatialDistanceFunc distanceFunc, void * userData, void ** outData, float * outDistance ) {
+    if( tree->root == SPATIAL_NULL || k <= 0 ) {
+        return 0;
+    }
+    // best-first search, nodes are taken from min-heap by distance to their bounds
+    TScratchMark mark = Scratch_GetMark();
+    TSpatialCandidate * heap = Scratch_NewCount( tree->capacity, TSpatialCandidate );
+    int heapSize = 0;
+    int found = 0;
+    heap[ heapSize++ ] = (TSpatialCandidate) { sqrtf( SpatialTree_SqrDistanceToNode( tree->nodes + tree->root, point )), tree->root };
+    while( heapSize > 0 ) {
+        TSpatialCandidate best = heap[0];
+        // nothing closer than already found ones
+        if( found == k && best.distance >= outDistance[ k - 1 ] ) {
+            break;
+        }
+        // pop
+        TSpatialCandidate last = heap[ --heapSize ];
+        int i = 0;
+        while( true ) {
+            int c = i * 2 + 1;
+            if( c >= heapSize ) {
+                break;
+            }
+            if( c + 1 < heapSize && heap[ c + 1 ].distance < heap[c].distance ) {
+                c++;
+            }
+            if( last.distance <= heap[c].distance ) {
+                break;
+            }
+            heap[i] = heap[c];
+            i = c;
+        }
+        heap[i] = last;
+        const TSpatialNode * node = tree->nodes + best.node;
+        if( node->height == 0 ) {
+            float distance = distanceFunc ? distanceFunc( node->data, point, userData ) : best.distance;
+            if( found < k || distance < outDistance[ found - 1 ] ) {
+                // insert into sorted result, farthest one is dropped when result is full
+                int n = found < k ? found++ : k - 1;
+                while( n > 0 && outDistance[ n - 1 ] > distance ) {
+                    outDistance[n] = outDistance[ n - 1 ];
+                    outData[n] = outData[ n - 1 ];
+                    n--;
+                }
+                outDistance[n] = distance;
+                outData[n] = node->data;
+            }
+        } else {
+            for( int side = 0; side < 2; side++ ) {
+                TSpatialCandidate candidate = { sqrtf( SpatialTree_SqrDistanceToNode( tree->nodes + node->child[side], point )), node->child[side] };
+                // push
+                int n = heapSize++;
+                while( n > 0 && heap[ ( n - 1 ) / 2 ].distance > candidate.distance ) {
+                    heap[n] = heap[ ( n - 1 ) / 2 ];
+                    n = ( n - 1 ) / 2;
+                }
+                heap[n] = candidate;
+            }
+        }
+    }
+    Scratch_Rewind( mark );
+    return found;
+}
+
+#define TEST_SPATIAL_OBJECT_COUNT (1000)
+#define TEST_SPATIAL_QUERY_COUNT (200)
+#define BENCHMARK_SPATIAL_OBJECT_COUNT (5000)
+#define BENCHMARK_SPATIAL_QUERY_COUNT (2000)
+#define TEST_SPATIAL_NEAREST_COUNT (4)
+
+typedef struct TTestSpatialObject {
+    TVec3 min;
+    TVec3 max;
+    int proxy;
+    bool alive;
+    bool found;
+} TTestSpatialObject;
+
+static bool Test_SpatialCollect( void * data, void * userData ) {
+    ((TTestSpatialObject*)data)->found = true;
+    (*(int*)userData)++;
+    return true;
+}
+
+static float Test_SpatialRandom( float range ) {
+    return range * ( rand() % 10000 ) / 10000.0f;
+}
+
+static void Test_SpatialPlace( TTestSpatialObject * obj ) {
+    obj->min = Vec3_Set( Test_SpatialRandom( 1000.0f ), Test_SpatialRandom( 100.0f ), Test_SpatialRandom( 1000.0f ));
+    obj->max = Vec3_Add( obj->min, Vec3_Set( 0.1f + Test_SpatialRandom( 3.0f ), 0.1f + Test_SpatialRandom( 3.0f ), 0.1f + Test_SpatialRandom( 3.0f )));
+}
+
+static float Test_SpatialSqrDistance( const TTestSpatialObject * obj, const TVec3 * p ) {
+    TSpatialNode node;
+    node.min = obj->min;
+    node.max = obj->max;
+    return SpatialTree_SqrDistanceToNode( &node, p );
+}
+
+static float Test_SpatialDistance( void * data, const TVec3 * point, void * userData ) {
+    UNUSED_VARIABLE( userData );
+    return sqrtf( Test_SpatialSqrDistance( data, point ));
+}
+
+// inserts objects, then moves some of them and removes some
+static void Test_FillSpatialTree( TSpatialTree * tree, TTestSpatialObject * objects, int objectCount ) {
+    SpatialTree_Create( tree, 0.5f );
+    for( int i = 0; i < objectCount; i++ ) {
+        Test_SpatialPlace( objects + i );
+        objects[i].proxy = SpatialTree_Insert( tree, &objects[i].min, &objects[i].max, objects + i );
+        objects[i].alive = true;
+    }
+    for( int i = 0; i < objectCount; i += 3 ) {
+        Test_SpatialPlace( objects + i );
+        SpatialTree_Move( tree, objects[i].proxy, &objects[i].min, &objects[i].max );
+    }
+    for( int i = 1; i < objectCount; i += 7 ) {
+        SpatialTree_Remove( tree, objects[i].proxy );
+        objects[i].alive = false;
+    }
+}
+
+static TVec3 Test_SpatialRandomPoint( void ) {
+    return Vec3_Set( Test_SpatialRandom( 1000.0f ), Test_SpatialRandom( 100.0f ), Test_SpatialRandom( 1000.0f ));
+}
+
+void Test_SpatialTree( void ) {
+    TTestSpatialObject objects[TEST_SPATIAL_OBJECT_COUNT];
+    TSpatialTree tree;
+    Test_FillSpatialTree( &tree, objects, TEST_SPATIAL_OBJECT_COUNT );
+    // every object found by exact test must be reported by tree
+    for( int q = 0; q < TEST_SPATIAL_QUERY_COUNT; q++ ) {
+        TVec3 center = Test_SpatialRandomPoint();
+        float radius = 1.0f + Test_SpatialRandom( 20.0f );
+        TVec3 end = Vec3_Add( center, Vec3_Set( Test_SpatialRandom( 100.0f ) - 50.0f, Test_SpatialRandom( 10.0f ) - 5.0f, Test_SpatialRandom( 100.0f ) - 50.0f ));
+        for( int i = 0; i < TEST_SPATIAL_OBJECT_COUNT; i++ ) {
+            objects[i].found = false;
+        }
+        int count = 0;
+        SpatialTree_QuerySphere( &tree, &center, radius, Test_SpatialCollect, &count );
+        int exactCount = 0;
+        for( int i = 0; i < TEST_SPATIAL_OBJECT_COUNT; i++ ) {
+            if( objects[i].alive && Test_SpatialSqrDistance( objects + i, &center ) <= radius * radius ) {
+                exactCount++;
+                if( !objects[i].found ) {
+                    Util_RaiseError( "Test_SpatialTree: object %d isn't found by sphere query!", i );
+                }
+            }
+        }
+        if( count < exactCount ) {
+            Util_RaiseError( "Test_SpatialTree: sphere query is incomplete!" );
+        }
+        // ray
+        for( int i = 0; i < TEST_SPATIAL_OBJECT_COUNT; i++ ) {
+            objects[i].found = false;
+        }
+        SpatialTree_QueryRay( &tree, &center, &end, Test_SpatialCollect, &count );
+        for( int i = 0; i < TEST_SPATIAL_OBJECT_COUNT; i++ ) {
+            TSpatialNode node;
+            node.min = objects[i].min;
+            node.max = objects[i].max;
+            float begin[3] = { center.x, center.y, center.z };
+            float dir[3] = { end.x - center.x, end.y - center.y, end.z - center.z };
+            if( objects[i].alive && SpatialTree_RayOverlap( &node, begin, dir ) && !objects[i].found ) {
+                Util_RaiseError( "Test_SpatialTree: object %d isn't found by ray query!", i );
+            }
+        }
+        // nearest
+        void * nearest[TEST_SPATIAL_NEAREST_COUNT];
+        float distance[TEST_SPATIAL_NEAREST_COUNT];
+        int nearestCount = SpatialTree_QueryNearest( &tree, &center, TEST_SPATIAL_NEAREST_COUNT, Test_SpatialDistance, NULL, nearest, distance );
+        if( nearestCount != TEST_SPATIAL_NEAREST_COUNT ) {
+            Util_RaiseError( "Test_SpatialTree: nearest query is incomplete!" );
+        }
+        int closer = 0;
+        for( int i = 0; i < TEST_SPATIAL_OBJECT_COUNT; i++ ) {
+            if( objects[i].alive && sqrtf( Test_SpatialSqrDistance( objects + i, &center )) < distance[ nearestCount - 1 ] ) {
+                closer++;
+            }
+        }
+        if( closer >= TEST_SPATIAL_NEAREST_COUNT ) {
+            Util_RaiseError( "Test_SpatialTree: nearest query missed an object!" );
+        }
+    }
+    SpatialTree_Free( &tree );
+}
+
+void Benchmark_SpatialTree( void ) {
+    TTestSpatialObject * objects = Memory_NewCount( BENCHMARK_SPATIAL_OBJECT_COUNT, TTestSpatialObject );
+    TSpatialTree tree;
+    Test_FillSpatialTree( &tree, objects, BENCHMARK_SPATIAL_OBJECT_COUNT );
+    double bruteTime = 0.0, treeTime = 0.0;
+    int bruteFound = 0, treeFound = 0;
+    TTimer timer;
+    Timer_Create( &timer );
+    for( int q = 0; q < BENCHMARK_SPATIAL_QUERY_COUNT; q++ ) {
+        TVec3 center = Test_SpatialRandomPoint();
+        float radius = 1.0f + Test_SpatialRandom( 20.0f );
+        Timer_Restart( &timer );
+        SpatialTree_QuerySphere( &tree, &center, radius, Test_SpatialCollect, &treeFound );
+        treeTime += Timer_GetElapsedMilliseconds( &timer );
+        Timer_Restart( &timer );
+        for( int i = 0; i < BENCHMARK_SPATIAL_OBJECT_COUNT; i++ ) {
+            if( objects[i].alive && Test_SpatialSqrDistance( objects + i, &center ) <= radius * radius ) {
+                bruteFound++;
+            }
+        }
+        bruteTime += Timer_GetElapsedMilliseconds( &timer );
+    }
+    printf( "SpatialTree: %d sphere queries over %d objects (%d/%d found): brute force %.3f ms, tree %.3f ms, tree height %d\n",
+        BENCHMARK_SPATIAL_QUERY_COUNT, tree.leafCount, bruteFound, treeFound, bruteTime, treeTime, tree.nodes[ tree.root ].height );
+    SpatialTree_Free( &tree );
+    Memory_Free( objects );
+}
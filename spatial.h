@@ -0,0 +1,62 @@
+#ifndef _SPATIAL_
+#define _SPATIAL_
+
+#include "common.h"
+#include "vector3.h"
+
+OLDTECH_BEGIN_HEADER
+
+// Dynamic AABB tree. Each object is a leaf with bounds enlarged by margin, so object can
+// move a bit without touching the tree. Tree is kept balanced by rotations on insertion,
+// so queries are O(log(n)) plus count of found objects.
+
+#define SPATIAL_NULL (-1)
+
+typedef struct TSpatialNode {
+    TVec3 min;
+    TVec3 max;
+    void * data;
+    int parent; // next free node when node is free
+    int child[2]; // SPATIAL_NULL for leaves
+    int height; // 0 for leaves, -1 for free nodes
+} TSpatialNode;
+
+typedef struct TSpatialTree {
+    TSpatialNode * nodes;
+    int capacity;
+    int root;
+    int freeList;
+    int leafCount;
+    float margin;
+} TSpatialTree;
+
+// returns false to stop query
+typedef bool (*TSpatialQueryFunc)( void * data, void * userData );
+// exact distance from object to point, must not be less than distance to its bounds
+typedef float (*TSpatialDistanceFunc)( void * data, const TVec3 * point, void * userData );
+
+void SpatialTree_Create( TSpatialTree * tree, float margin );
+void SpatialTree_Free( TSpatialTree * tree );
+// returns proxy of object, it stays valid until removal
+int SpatialTree_Insert( TSpatialTree * tree, const TVec3 * min, const TVec3 * max, void * data );
+void SpatialTree_Remove( TSpatialTree * tree, int proxy );
+// returns true if object left its enlarged bounds and was reinserted
+bool SpatialTree_Move( TSpatialTree * tree, int proxy, const TVec3 * min, const TVec3 * max );
+void * SpatialTree_GetData( const TSpatialTree * tree, int proxy );
+// queries report objects whose enlarged bounds pass the test, caller does exact test
+void SpatialTree_QueryAABB( const TSpatialTree * tree, const TVec3 * min, const TVec3 * max, TSpatialQueryFunc func, void * userData );
+void SpatialTree_QuerySphere( const TSpatialTree * tree, const TVec3 * center, float radius, TSpatialQueryFunc func, void * userData );
+// segment from 'begin' to 'end'
+void SpatialTree_QueryRay( const TSpatialTree * tree, const TVec3 * begin, const TVec3 * end, TSpatialQueryFunc func, void * userData );
+// finds up to 'k' nearest objects sorted by distance, NULL distance function means
+// distance to bounds. returns count of found objects
+int SpatialTree_QueryNearest( const TSpatialTree * tree, const TVec3 * point, int k, TSpatialDistanceFunc distanceFunc, void * userData, void ** outData, float * outDistance );
+
+// tests
+void Test_SpatialTree( void );
+// prints time of sphere queries in tree against brute force over all objects
+void Benchmark_SpatialTree( void );
+
+OLDTECH_END_HEADER
+
+#endif
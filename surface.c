@@ -11,7 +11,10 @@ void Surface_Free( TSurface * surf ) {
     Memory_Free( surf->vertices );
     if( surf->skinned ) {
         Memory_Free( surf->skinVertices );
-        Memory_Free( surf->vertexBones );
+        if( surf->vertexBones ) {
+            Memory_Free( surf->vertexBones );
+        }
+        SkinData_Free( &surf->skin );
     }
     Memory_Free( surf );
 }
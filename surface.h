@@ -6,6 +6,7 @@
 #include "face.h"
 #include "texture.h"
 #include "matrix4.h"
+#include "skin.h"
 
 typedef struct {
     TVec3 min;
@@ -14,15 +15,12 @@ typedef struct {
     float radius;
 } TAABB;
 
+// influence of bone on a vertex as it stored in scene file
 typedef struct {
     // skeletal anim bone weight 
     float weight;
-    // bone number in a scene 
+    // bone number in a scene, resolved to palette index when skin is built
     int boneId;
-    // bone entity ptr 
-    struct TEntity * boneEnt;
-    // transformation of this bone
-    TMatrix4 transform;
 } TBone;
 
 // allow you to define four bones per vertex, this is usually enough 
@@ -45,17 +43,14 @@ typedef struct TSurface {
     // =====================
     // underlying members are used for animation    
     TVertex * skinVertices; // array to store transformed vertices    
-    TBoneGroup * vertexBones;
+    TBoneGroup * vertexBones; // used only while loading, freed when skin is built
+    TSkinData skin;
     bool skinned;
     
     // =====================
     // used for instancing
     int shareCount;    
     
-    // =====================
-    // list of bones affecting this surface
-    TList bones; 
-     
     // =====================
     // underlying members are used to manage lightmaps
     struct TEntity * onLoadOwner;  // entity, that owns this surface in the scene file    
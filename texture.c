@@ -1,9 +1,12 @@
 #include "texture.h"
 #include "renderer.h"
+#include "hashmap.h"
 
 void LoadTextureFromTGA( TTexture * tex, const char * file );
     
 TList g_textures = { 0 };
+// file name -> texture, to avoid loading same texture twice
+THashMap gTextureIndex = HASHMAP_INITIALIZER;
 
 void LoadTextureFromTGA( TTexture * tex, const char * file ) {
     unsigned char tgaHeader[12], tgaInfo[6];
@@ -29,6 +32,7 @@ void LoadTextureFromTGA( TTexture * tex, const char * file ) {
 
     tex->pixels = Memory_Allocate( tex->bytesCount );
     strcpy( tex->fileName, file );
+    tex->name = Atom_Intern( file );
     if( fread( tex->pixels, 1, tex->bytesCount, tgaFile ) != tex->bytesCount ) {
         Util_RaiseError( "Unable to load %s. Corrupted data!", file );
     }
@@ -49,28 +53,32 @@ void LoadTextureFromTGA( TTexture * tex, const char * file ) {
     
     Log_Write( "Texture '%s' loaded successfully!", file );
     List_Add( &g_textures, tex );
+    HashMap_Insert( &gTextureIndex, tex->fileName, tex );
 }
 
 
 
 TTexture * Texture2D_LoadFromFile( const char * file ) {
     // find existing 
-    for( TListNode * current = g_textures.head; current; current = current->next ) {
-        TTexture * tex = (TTexture*)current->data;
-        if( strcmp( file, tex->fileName ) == 0 ) {
-            return tex;
-        }
+    TTexture * tex = HashMap_Find( &gTextureIndex, file );
+    if( tex ) {
+        return tex;
     }
     // no existing texture, so load new one 
+    Memory_PushTag( MEMORY_TAG_RENDER );
     TTexture * newTex = Memory_New( TTexture );
     LoadTextureFromTGA( newTex, file );
+    Memory_PopTag();
     return newTex;
 }
 
 TTexture * Texture2D_Create( int width, int height, int bytePerPixel, void * data ) {
+    Memory_PushTag( MEMORY_TAG_RENDER );
     TTexture * texture = Memory_New( TTexture );
     Renderer_LoadTextureFromMemory( texture, width, height, bytePerPixel, data, false );
     strcpy( texture->fileName, "[Procedure texture]" );    
+    texture->name = Atom_Intern( texture->fileName );
+    Memory_PopTag();
     return texture;
 }
 
@@ -88,4 +96,5 @@ void Texture2D_FreeAll() {
         Texture2D_Free( texture );
         Memory_Free( texture );
     }
+    HashMap_Free( &gTextureIndex );
 }
\ No newline at end of file
@@ -28,6 +28,7 @@ typedef struct {
     int bytesPerPixel;
     unsigned int bytesCount;
     char fileName[256];
+    TAtom name; // interned file name, NULL for textures created not by Texture2D_* functions
 } TTexture;
 
 // global storage of all textures
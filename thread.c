@@ -1,14 +1,35 @@
 #include "thread.h"
 #include "utils.h"
 #include "memory.h"
+#include "scratch.h"
+#include <stdlib.h>
 
 #ifdef _WIN32
 #   include <windows.h>
 #endif
 
+typedef struct TThreadStartInfo {
+    int (__stdcall *func)(void*);
+    void * ptr;
+} TThreadStartInfo;
+
+// wrapper around thread function, releases thread's scratch arena and allocation cache when function is done
+static int __stdcall Thread_Entry( void * param ) {
+    TThreadStartInfo info = *(TThreadStartInfo*)param;
+    free( param );
+    int result = info.func( info.ptr );
+    Scratch_ReleaseThreadArena();
+    Memory_ReleaseThreadCache();
+    return result;
+}
+
 TThread Thread_Start( int (__stdcall *func)(void*), void * ptr ) {
 #ifdef _WIN32
-    TThread thread = CreateThread( 0, 0, (LPTHREAD_START_ROUTINE)func, ptr, 0, 0 );
+    // allocated with malloc, because it's released from another thread before allocator cache exists there
+    TThreadStartInfo * info = malloc( sizeof( TThreadStartInfo ));
+    info->func = func;
+    info->ptr = ptr;
+    TThread thread = CreateThread( 0, 0, (LPTHREAD_START_ROUTINE)Thread_Entry, info, 0, 0 );
     if( !thread ) {
         Util_RaiseError( "Unable to start thread!" );
     }   
@@ -16,6 +37,73 @@ TThread Thread_Start( int (__stdcall *func)(void*), void * ptr ) {
 #endif
 }
 
+void Thread_Join( TThread thread ) {
+#ifdef _WIN32
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+#endif
+}
+
+int Thread_GetProcessorCount( void ) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#endif
+}
+
+void Thread_Pause( void ) {
+#ifdef _WIN32
+    YieldProcessor();
+#endif
+}
+
+void Thread_Yield( void ) {
+#ifdef _WIN32
+    Sleep( 0 );
+#endif
+}
+
+TSemaphore Semaphore_Create( int maxCount ) {
+#ifdef _WIN32
+    TSemaphore semaphore = CreateSemaphore( 0, 0, maxCount, 0 );
+    if( !semaphore ) {
+        Util_RaiseError( "Unable to create semaphore!" );
+    }
+    return semaphore;
+#endif
+}
+
+void Semaphore_Release( TSemaphore semaphore, int count ) {
+#ifdef _WIN32
+    ReleaseSemaphore( semaphore, count, 0 );
+#endif
+}
+
+void Semaphore_Wait( TSemaphore semaphore ) {
+#ifdef _WIN32
+    WaitForSingleObject( semaphore, INFINITE );
+#endif
+}
+
+void Semaphore_Destroy( TSemaphore semaphore ) {
+#ifdef _WIN32
+    CloseHandle( semaphore );
+#endif
+}
+
+long Atomic_Increment( volatile long * value ) {
+#ifdef _WIN32
+    return InterlockedIncrement( value );
+#endif
+}
+
+long Atomic_Add( volatile long * value, long add ) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd( value, add ) + add;
+#endif
+}
+
 TEvent Event_Create() {
 #ifdef _WIN32
     return CreateEvent( 0, 0, 0, 0 );
@@ -99,4 +187,26 @@ int Event_WaitSingle( TEvent * event ) {
 #ifdef _WIN32
     return WaitForSingleObject( event, INFINITE );
 #endif
-}
\ No newline at end of file
+}
+
+TThreadLocal ThreadLocal_Create( void ) {
+#ifdef _WIN32
+    DWORD tls = TlsAlloc();
+    if( tls == TLS_OUT_OF_INDEXES ) {
+        Util_RaiseError( "Unable to allocate thread local storage slot!" );
+    }
+    return tls;
+#endif
+}
+
+void * ThreadLocal_Get( TThreadLocal tls ) {
+#ifdef _WIN32
+    return TlsGetValue( tls );
+#endif
+}
+
+void ThreadLocal_Set( TThreadLocal tls, void * value ) {
+#ifdef _WIN32
+    TlsSetValue( tls, value );
+#endif
+}
@@ -6,8 +6,18 @@
 typedef void * TEvent;
 typedef void * TCriticalSection;
 typedef void * TThread;
+typedef void * TSemaphore;
+typedef unsigned long TThreadLocal;
 
 TThread Thread_Start( int (__stdcall *func)(void*), void * ptr );
+// waits until thread is finished and releases its handle
+void Thread_Join( TThread thread );
+// count of logical processors, at least one
+int Thread_GetProcessorCount( void );
+// hint for processor inside of spin-wait loop
+void Thread_Pause( void );
+// gives rest of time slice to other ready thread
+void Thread_Yield( void );
 
 TEvent Event_Create( void );
 void Event_Set( TEvent event );
@@ -16,10 +26,25 @@ int Event_WaitMultiple( int count, TEvent * event );
 int Event_WaitSingle( TEvent * event );
 void Event_Destroy( TEvent * event );
 
+TSemaphore Semaphore_Create( int maxCount );
+// increases counter of semaphore by 'count', wakes up to 'count' waiting threads
+void Semaphore_Release( TSemaphore semaphore, int count );
+void Semaphore_Wait( TSemaphore semaphore );
+void Semaphore_Destroy( TSemaphore semaphore );
+
+// atomic operations, both are full memory barriers, return new value
+long Atomic_Increment( volatile long * value );
+long Atomic_Add( volatile long * value, long add );
+
 TCriticalSection * CriticalSection_Create( void );
 void CriticalSection_Enter( TCriticalSection * cs );
 bool CriticalSection_TryEnter( TCriticalSection * cs );
 void CriticalSection_Leave( TCriticalSection * cs );
 void CriticalSection_Delete( TCriticalSection * cs );
 
+// thread local storage slot, each thread sees its own value, initially NULL
+TThreadLocal ThreadLocal_Create( void );
+void * ThreadLocal_Get( TThreadLocal tls );
+void ThreadLocal_Set( TThreadLocal tls, void * value );
+
 #endif
\ No newline at end of file
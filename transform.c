@@ -0,0 +1,242 @@
+#include "transform.h"
+#include "timer.h"
+
+#ifdef OLDTECH_SSE
+#   include <xmmintrin.h>
+#endif
+
+void TransformArray_Create( TTransformArray * ta ) {
+    memset( ta, 0, sizeof( *ta ));
+}
+
+void TransformArray_Resize( TTransformArray * ta, int count ) {
+    if( count > ta->capacity ) {
+        int capacity = ta->capacity ? ta->capacity : 64;
+        while( capacity < count ) {
+            capacity *= 2;
+        }
+        float ** components[] = { &ta->px, &ta->py, &ta->pz, &ta->rx, &ta->ry, &ta->rz, &ta->rw, &ta->sx, &ta->sy, &ta->sz };
+        for( int i = 0; i < (int)( sizeof( components ) / sizeof( components[0] )); i++ ) {
+            *components[i] = Memory_Reallocate( *components[i], capacity * sizeof( float ));
+        }
+        ta->parent = Memory_Reallocate( ta->parent, capacity * sizeof( int ));
+        ta->local = Memory_Reallocate( ta->local, capacity * sizeof( TMatrix4 ));
+        ta->global = Memory_Reallocate( ta->global, capacity * sizeof( TMatrix4 ));
+        ta->capacity = capacity;
+    }
+    ta->count = count;
+}
+
+void TransformArray_Free( TTransformArray * ta ) {
+    if( ta->capacity ) {
+        float * components[] = { ta->px, ta->py, ta->pz, ta->rx, ta->ry, ta->rz, ta->rw, ta->sx, ta->sy, ta->sz };
+        for( int i = 0; i < (int)( sizeof( components ) / sizeof( components[0] )); i++ ) {
+            Memory_Free( components[i] );
+        }
+        Memory_Free( ta->parent );
+        Memory_Free( ta->local );
+        Memory_Free( ta->global );
+    }
+    TransformArray_Create( ta );
+}
+
+void TransformArray_Set( TTransformArray * ta, int n, TVec3 position, TQuaternion rotation, TVec3 scale ) {
+    ta->px[n] = position.x;
+    ta->py[n] = position.y;
+    ta->pz[n] = position.z;
+    ta->rx[n] = rotation.x;
+    ta->ry[n] = rotation.y;
+    ta->rz[n] = rotation.z;
+    ta->rw[n] = rotation.w;
+    ta->sx[n] = scale.x;
+    ta->sy[n] = scale.y;
+    ta->sz[n] = scale.z;
+}
+
+bool TransformArray_Equals( const TTransformArray * ta, int n, TVec3 position, TQuaternion rotation, TVec3 scale ) {
+    return ta->px[n] == position.x && ta->py[n] == position.y && ta->pz[n] == position.z &&
+           ta->rx[n] == rotation.x && ta->ry[n] == rotation.y && ta->rz[n] == rotation.z && ta->rw[n] == rotation.w &&
+           ta->sx[n] == scale.x && ta->sy[n] == scale.y && ta->sz[n] == scale.z;
+}
+
+static void Transform_ComposeSingle( TTransformArray * ta, int n ) {
+    TVec3 position = { ta->px[n], ta->py[n], ta->pz[n] };
+    TQuaternion rotation = { ta->rx[n], ta->ry[n], ta->rz[n], ta->rw[n] };
+    TVec3 scale = { ta->sx[n], ta->sy[n], ta->sz[n] };
+    ta->local[n] = Matrix4_ComposeTransform( scale, rotation, position );
+}
+
+#ifdef OLDTECH_SSE
+#define TRANSFORM_GATHER( array, i ) _mm_setr_ps( (array)[(i)[0]], (array)[(i)[1]], (array)[(i)[2]], (array)[(i)[3]] )
+
+// composes four transforms at once, each SSE lane holds one transform
+static void Transform_ComposeFour( TTransformArray * ta, const int * i ) {
+    __m128 x = TRANSFORM_GATHER( ta->rx, i );
+    __m128 y = TRANSFORM_GATHER( ta->ry, i );
+    __m128 z = TRANSFORM_GATHER( ta->rz, i );
+    __m128 w = TRANSFORM_GATHER( ta->rw, i );
+    __m128 sqrLength = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y )), _mm_add_ps( _mm_mul_ps( z, z ), _mm_mul_ps( w, w )));
+    __m128 s = _mm_div_ps( _mm_set1_ps( 2.0f ), sqrLength );
+    __m128 xs = _mm_mul_ps( x, s ), ys = _mm_mul_ps( y, s ), zs = _mm_mul_ps( z, s );
+    __m128 wx = _mm_mul_ps( w, xs ), wy = _mm_mul_ps( w, ys ), wz = _mm_mul_ps( w, zs );
+    __m128 xx = _mm_mul_ps( x, xs ), xy = _mm_mul_ps( x, ys ), xz = _mm_mul_ps( x, zs );
+    __m128 yy = _mm_mul_ps( y, ys ), yz = _mm_mul_ps( y, zs ), zz = _mm_mul_ps( z, zs );
+    __m128 one = _mm_set1_ps( 1.0f );
+    __m128 zero = _mm_setzero_ps();
+    __m128 sx = TRANSFORM_GATHER( ta->sx, i );
+    __m128 sy = TRANSFORM_GATHER( ta->sy, i );
+    __m128 sz = TRANSFORM_GATHER( ta->sz, i );
+    // rows of rotation part scaled by local scale, see Matrix4_ComposeTransform
+    __m128 m0 = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( yy, zz )), sx );
+    __m128 m1 = _mm_mul_ps( _mm_add_ps( xy, wz ), sx );
+    __m128 m2 = _mm_mul_ps( _mm_sub_ps( xz, wy ), sx );
+    __m128 m3 = zero;
+    __m128 m4 = _mm_mul_ps( _mm_sub_ps( xy, wz ), sy );
+    __m128 m5 = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( xx, zz )), sy );
+    __m128 m6 = _mm_mul_ps( _mm_add_ps( yz, wx ), sy );
+    __m128 m7 = zero;
+    __m128 m8 = _mm_mul_ps( _mm_add_ps( xz, wy ), sz );
+    __m128 m9 = _mm_mul_ps( _mm_sub_ps( yz, wx ), sz );
+    __m128 m10 = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( xx, yy )), sz );
+    __m128 m11 = zero;
+    __m128 m12 = TRANSFORM_GATHER( ta->px, i );
+    __m128 m13 = TRANSFORM_GATHER( ta->py, i );
+    __m128 m14 = TRANSFORM_GATHER( ta->pz, i );
+    __m128 m15 = one;
+    // after transposition k-th vector holds row of k-th matrix
+    _MM_TRANSPOSE4_PS( m0, m1, m2, m3 );
+    _MM_TRANSPOSE4_PS( m4, m5, m6, m7 );
+    _MM_TRANSPOSE4_PS( m8, m9, m10, m11 );
+    _MM_TRANSPOSE4_PS( m12, m13, m14, m15 );
+    __m128 rows[4][4] = { { m0, m4, m8, m12 }, { m1, m5, m9, m13 }, { m2, m6, m10, m14 }, { m3, m7, m11, m15 } };
+    for( int k = 0; k < 4; k++ ) {
+        float * f = ta->local[ i[k] ].f;
+        _mm_storeu_ps( f + 0, rows[k][0] );
+        _mm_storeu_ps( f + 4, rows[k][1] );
+        _mm_storeu_ps( f + 8, rows[k][2] );
+        _mm_storeu_ps( f + 12, rows[k][3] );
+    }
+}
+#endif
+
+void Transform_ComposeBatch( TTransformArray * ta, const int * indices, int count ) {
+    int n = 0;
+#ifdef OLDTECH_SSE
+    for( ; n + 4 <= count; n += 4 ) {
+        Transform_ComposeFour( ta, indices + n );
+    }
+#endif
+    for( ; n < count; n++ ) {
+        Transform_ComposeSingle( ta, indices[n] );
+    }
+}
+
+void Transform_PropagateBatch( TTransformArray * ta, const int * indices, int count ) {
+    for( int n = 0; n < count; n++ ) {
+        int i = indices[n];
+        int parent = ta->parent[i];
+        if( parent >= 0 ) {
+            Matrix4_MultiplyTo( ta->local + i, ta->global + parent, ta->global + i );
+        } else {
+            ta->global[i] = ta->local[i];
+        }
+    }
+}
+
+#define TEST_TRANSFORM_COUNT (1000)
+#define BENCHMARK_TRANSFORM_COUNT (50000)
+
+typedef struct TTestTransformNode {
+    int parent;
+    TVec3 position;
+    TQuaternion rotation;
+    TVec3 scale;
+    TMatrix4 local;
+    TMatrix4 global;
+} TTestTransformNode;
+
+// previous path: scalar multiply and recalculation of whole chain of ancestors for each node
+static TMatrix4 Test_ScalarMultiply( TMatrix4 a, TMatrix4 b ) {
+    TMatrix4 temp = { {0.0f} };
+    for( int i = 0; i < 4; i++ ) {
+        for( int j = 0; j < 4; j++ ) {
+            for( int k = 0; k < 4; k++ ) {
+                temp.f[i * 4 + j] += a.f[i * 4 + k] * b.f[k * 4 + j];
+            }
+        }
+    }
+    return temp;
+}
+
+static void Test_CalculateNodeTransform( TTestTransformNode * nodes, int n ) {
+    TTestTransformNode * node = nodes + n;
+    node->local = Test_ScalarMultiply( Matrix4_Scale( node->scale ), Matrix4_SetRotationOrigin( node->rotation, node->position ));
+    if( node->parent >= 0 ) {
+        Test_CalculateNodeTransform( nodes, node->parent );
+        node->global = Test_ScalarMultiply( node->local, nodes[ node->parent ].global );
+    } else {
+        node->global = node->local;
+    }
+}
+
+// groups of 64 nodes with random hierarchy inside, like a lot of small skeletons
+static void Test_FillTransforms( TTestTransformNode * nodes, TTransformArray * ta, int * indices, int count ) {
+    TransformArray_Resize( ta, count );
+    for( int i = 0; i < count; i++ ) {
+        TTestTransformNode * node = nodes + i;
+        node->parent = ( i % 64 ) ? i - 1 - ( rand() % ( i % 64 )) : -1;
+        node->position = Vec3_Set( rand() % 100, rand() % 100, rand() % 100 );
+        node->rotation = Quaternion_SetEulerAngles( rand() % 360, rand() % 360, rand() % 360 );
+        node->scale = Vec3_Set( 1.0f, 1.0f + ( rand() % 3 ), 1.0f );
+        TransformArray_Set( ta, i, node->position, node->rotation, node->scale );
+        ta->parent[i] = node->parent;
+        indices[i] = i;
+    }
+}
+
+void Test_TransformBatch( void ) {
+    TTestTransformNode * nodes = Memory_NewCount( TEST_TRANSFORM_COUNT, TTestTransformNode );
+    int * indices = Memory_NewCount( TEST_TRANSFORM_COUNT, int );
+    TTransformArray ta;
+    TransformArray_Create( &ta );
+    Test_FillTransforms( nodes, &ta, indices, TEST_TRANSFORM_COUNT );
+    for( int i = 0; i < TEST_TRANSFORM_COUNT; i++ ) {
+        Test_CalculateNodeTransform( nodes, i );
+    }
+    Transform_ComposeBatch( &ta, indices, TEST_TRANSFORM_COUNT );
+    Transform_PropagateBatch( &ta, indices, TEST_TRANSFORM_COUNT );
+    for( int i = 0; i < TEST_TRANSFORM_COUNT; i++ ) {
+        for( int k = 0; k < 16; k++ ) {
+            float a = nodes[i].global.f[k];
+            float b = ta.global[i].f[k];
+            if( fabs( a - b ) > 0.001f * ( 1.0f + fabs( a ))) {
+                Util_RaiseError( "Test_TransformBatch: transform %d mismatch!", i );
+            }
+        }
+    }
+    TransformArray_Free( &ta );
+    Memory_Free( indices );
+    Memory_Free( nodes );
+}
+
+void Benchmark_TransformBatch( void ) {
+    TTestTransformNode * nodes = Memory_NewCount( BENCHMARK_TRANSFORM_COUNT, TTestTransformNode );
+    int * indices = Memory_NewCount( BENCHMARK_TRANSFORM_COUNT, int );
+    TTransformArray ta;
+    TransformArray_Create( &ta );
+    Test_FillTransforms( nodes, &ta, indices, BENCHMARK_TRANSFORM_COUNT );
+    TTimer timer;
+    Timer_Create( &timer );
+    for( int i = 0; i < BENCHMARK_TRANSFORM_COUNT; i++ ) {
+        Test_CalculateNodeTransform( nodes, i );
+    }
+    double scalarTime = Timer_GetElapsedMilliseconds( &timer );
+    Timer_Restart( &timer );
+    Transform_ComposeBatch( &ta, indices, BENCHMARK_TRANSFORM_COUNT );
+    Transform_PropagateBatch( &ta, indices, BENCHMARK_TRANSFORM_COUNT );
+    double batchTime = Timer_GetElapsedMilliseconds( &timer );
+    printf( "Transforms: %d nodes: per-node %.3f ms, batch %.3f ms\n", BENCHMARK_TRANSFORM_COUNT, scalarTime, batchTime );
+    TransformArray_Free( &ta );
+    Memory_Free( indices );
+    Memory_Free( nodes );
+}
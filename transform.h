@@ -0,0 +1,53 @@
+#ifndef _TRANSFORM_
+#define _TRANSFORM_
+
+#include "common.h"
+#include "matrix4.h"
+
+OLDTECH_BEGIN_HEADER
+
+// structure-of-arrays storage of transforms, used by batch kernels. transforms must be
+// ordered so that parent always has lower index than its childs
+typedef struct TTransformArray {
+    int count;
+    int capacity;
+    // local position
+    float * px;
+    float * py;
+    float * pz;
+    // local rotation
+    float * rx;
+    float * ry;
+    float * rz;
+    float * rw;
+    // local scale
+    float * sx;
+    float * sy;
+    float * sz;
+    // index of parent transform, -1 if transform has no parent
+    int * parent;
+    TMatrix4 * local;
+    TMatrix4 * global;
+} TTransformArray;
+
+void TransformArray_Create( TTransformArray * ta );
+// keeps content of first 'count' transforms
+void TransformArray_Resize( TTransformArray * ta, int count );
+void TransformArray_Free( TTransformArray * ta );
+void TransformArray_Set( TTransformArray * ta, int n, TVec3 position, TQuaternion rotation, TVec3 scale );
+// true if local components of n-th transform are equal to passed
+bool TransformArray_Equals( const TTransformArray * ta, int n, TVec3 position, TQuaternion rotation, TVec3 scale );
+
+// builds local matrices of listed transforms
+void Transform_ComposeBatch( TTransformArray * ta, const int * indices, int count );
+// global = local * parent global of listed transforms, indices must be in ascending order
+void Transform_PropagateBatch( TTransformArray * ta, const int * indices, int count );
+
+// tests
+void Test_TransformBatch( void );
+// prints time of batch composition against per-node recalculation of ancestor chain
+void Benchmark_TransformBatch( void );
+
+OLDTECH_END_HEADER
+
+#endif
@@ -1,8 +1,10 @@
 #include "variable.h"
 #include "list.h"
 #include "common.h"
+#include "hashmap.h"
 
 TList gVariables;
+THashMap gVariableIndex = HASHMAP_INITIALIZER;
 
 TVariable v_countVariables = { .name = "v_countVariables", .num = 0, .str = NULL, .help = "Count of all registered variables" };
 
@@ -21,13 +23,16 @@ void Variable_Register( TVariable * var ) {
     }
     Log_Write( "Variable %s registered. Defaults: %f, '%s' - %s", var->name, var->num, var->str, var->help );
     List_Add( &gVariables, var );
+    // first registered variable with the name wins, as it was with linear search
+    if( !HashMap_Find( &gVariableIndex, var->name )) {
+        HashMap_Insert( &gVariableIndex, var->name, var );
+    }
 }
 
 TVariable * Variable_Find( const char * name ) {
-    for_each( TVariable, v, gVariables ) {
-        if( !strcmp( v->name, name )) {
-            return v;
-        }
+    TVariable * v = HashMap_Find( &gVariableIndex, name );
+    if( v ) {
+        return v;
     }
     Log_Write( "%s variable not found!", name );
     return NULL;
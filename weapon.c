@@ -46,6 +46,7 @@ TWeapon * Weapon_Create( EWeaponType type ) {
         SoundSource_Create( &wpn->sndShot, &gWeaponBase.sndBufWeaponShoot );
         break;		
     }
+    wpn->projectilePrefab = Prefab_Create( wpn->projectileModel );
     List_Create( &wpn->projectiles );
     //Entity_SetDepthHack( wpn->model, 0.175f );
 	return wpn;
@@ -53,7 +54,7 @@ TWeapon * Weapon_Create( EWeaponType type ) {
 
 void Weapon_Shoot( TWeapon * wpn ) {
     if( wpn->wait <= 0 ) {
-		TProjectile * proj = Projectile_Create( wpn, PROJECTILE_PLASMA, wpn->projectileModel );
+		TProjectile * proj = Projectile_Create( wpn, PROJECTILE_PLASMA, wpn->projectilePrefab );
 		proj->model->localPosition = Entity_GetGlobalPosition( wpn->shootPoint );
 		proj->model->localRotation = Quaternion_SetMatrix( wpn->shootPoint->globalTransform );
         Entity_CalculateGlobalTransform( proj->model );
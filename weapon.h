@@ -13,6 +13,7 @@ typedef enum {
 typedef struct TWeapon {
     TEntity * model;
     TEntity * projectileModel;
+    TPrefab * projectilePrefab; // each shot instantiates it
 	TEntity * shootPoint;
     TList projectiles;
     TSound sndShot;